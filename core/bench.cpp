@@ -0,0 +1,558 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Headless benchmark driver: runs one of the emulated machines without a
+// libretro frontend, as fast as possible, and prints the results as JSON.
+//
+// usage: ep128emu_core_bench [-m MACHINE] [-s SECONDS] [-r SYSTEMDIR]
+//                            [-d REPEATS] [CONTENT]
+//   MACHINE is a machine type name from VM_config (default: EP128_TAPE),
+//   or one of the aliases ep, ep64, tvc, cpc, cpc464, zx, zx48, zx128.
+//   CONTENT is attached as floppy A for *_DISK types, and as tape image
+//   for *_TAPE types.
+//   With -d, the last frame displayed is also decoded and drawn REPEATS
+//   times with the original line decoder (8-bit color indices, then a
+//   palette lookup for each pixel of the viewport) and with the current
+//   one (pixels decoded directly, visible span copied with memcpy), and
+//   the time taken by each is printed.
+
+#include "core.hpp"
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cstring>
+
+#ifndef WIN32
+#  include <sys/resource.h>
+#endif
+
+static const char *benchMachineAliases[][2] = {
+  { "ep",     "EP128_TAPE"   },
+  { "ep64",   "EP64_TAPE"    },
+  { "tvc",    "TVC64_TAPE"   },
+  { "cpc",    "CPC_DISK"     },
+  { "cpc464", "CPC_464_TAPE" },
+  { "zx",     "ZX48_TAPE"    },
+  { "zx48",   "ZX48_TAPE"    },
+  { "zx128",  "ZX128_TAPE"   },
+  { (char *) 0, (char *) 0 }
+};
+
+static void benchLogCallback(enum retro_log_level level, const char *fmt, ...)
+{
+  if (level < RETRO_LOG_WARN)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  std::vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+static bool benchEnvironmentCallback(unsigned cmd, void *data)
+{
+  (void) cmd;
+  (void) data;
+  return false;
+}
+
+static int16_t benchInputStateCallback(unsigned port, unsigned device,
+                                       unsigned index, unsigned id)
+{
+  (void) port;
+  (void) device;
+  (void) index;
+  (void) id;
+  return 0;
+}
+
+static void benchVideoCallback(const void *data, unsigned width,
+                               unsigned height, size_t pitch)
+{
+  (void) data;
+  (void) width;
+  (void) height;
+  (void) pitch;
+}
+
+typedef Ep128Emu::LibretroDisplay::pixel_t  BenchPixel;
+
+// the line decoder used before the pixels were decoded directly, for
+// comparison: 768 8-bit color indices are written to 'outBuf'
+static void decodeLineIndexed(unsigned char *outBuf,
+                              const unsigned char *inBuf, size_t nBytes)
+{
+  const unsigned char *bufp = inBuf;
+  unsigned char *endp = outBuf + 768;
+  do
+  {
+    switch (bufp[0])
+    {
+    case 0x00:                        // blank
+      do
+      {
+        outBuf[15] = outBuf[14] =
+        outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] =
+        outBuf[ 9] = outBuf[ 8] =
+        outBuf[ 7] = outBuf[ 6] =
+        outBuf[ 5] = outBuf[ 4] =
+        outBuf[ 3] = outBuf[ 2] =
+        outBuf[ 1] = outBuf[ 0] = 0x00;
+        outBuf = outBuf + 16;
+        bufp = bufp + 1;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x00);
+      break;
+    case 0x01:                        // 1 pixel, 256 colors
+      do
+      {
+        outBuf[15] = outBuf[14] =
+        outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] =
+        outBuf[ 9] = outBuf[ 8] =
+        outBuf[ 7] = outBuf[ 6] =
+        outBuf[ 5] = outBuf[ 4] =
+        outBuf[ 3] = outBuf[ 2] =
+        outBuf[ 1] = outBuf[ 0] = bufp[1];
+        outBuf = outBuf + 16;
+        bufp = bufp + 2;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x01);
+      break;
+    case 0x02:                        // 2 pixels, 256 colors
+      do
+      {
+        outBuf[ 7] = outBuf[ 6] =
+        outBuf[ 5] = outBuf[ 4] =
+        outBuf[ 3] = outBuf[ 2] =
+        outBuf[ 1] = outBuf[ 0] = bufp[1];
+        outBuf[15] = outBuf[14] =
+        outBuf[13] = outBuf[12] =
+        outBuf[11] = outBuf[10] =
+        outBuf[ 9] = outBuf[ 8] = bufp[2];
+        outBuf = outBuf + 16;
+        bufp = bufp + 3;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x02);
+      break;
+    case 0x03:                        // 8 pixels, 2 colors
+      do
+      {
+        unsigned char c0 = bufp[1];
+        unsigned char c1 = bufp[2];
+        unsigned char b = bufp[3];
+        outBuf[ 1] = outBuf[ 0] = ((b & 128) ? c1 : c0);
+        outBuf[ 3] = outBuf[ 2] = ((b &  64) ? c1 : c0);
+        outBuf[ 5] = outBuf[ 4] = ((b &  32) ? c1 : c0);
+        outBuf[ 7] = outBuf[ 6] = ((b &  16) ? c1 : c0);
+        outBuf[ 9] = outBuf[ 8] = ((b &   8) ? c1 : c0);
+        outBuf[11] = outBuf[10] = ((b &   4) ? c1 : c0);
+        outBuf[13] = outBuf[12] = ((b &   2) ? c1 : c0);
+        outBuf[15] = outBuf[14] = ((b &   1) ? c1 : c0);
+        outBuf = outBuf + 16;
+        bufp = bufp + 4;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x03);
+      break;
+    case 0x04:                        // 4 pixels, 256 colors
+      do
+      {
+        outBuf[ 3] = outBuf[ 2] =
+        outBuf[ 1] = outBuf[ 0] = bufp[1];
+        outBuf[ 7] = outBuf[ 6] =
+        outBuf[ 5] = outBuf[ 4] = bufp[2];
+        outBuf[11] = outBuf[10] =
+        outBuf[ 9] = outBuf[ 8] = bufp[3];
+        outBuf[15] = outBuf[14] =
+        outBuf[13] = outBuf[12] = bufp[4];
+        outBuf = outBuf + 16;
+        bufp = bufp + 5;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x04);
+      break;
+    case 0x06:                        // 16 (2*8) pixels, 2*2 colors
+      do
+      {
+        unsigned char c0 = bufp[1];
+        unsigned char c1 = bufp[2];
+        unsigned char b = bufp[3];
+        outBuf[ 0] = ((b & 128) ? c1 : c0);
+        outBuf[ 1] = ((b &  64) ? c1 : c0);
+        outBuf[ 2] = ((b &  32) ? c1 : c0);
+        outBuf[ 3] = ((b &  16) ? c1 : c0);
+        outBuf[ 4] = ((b &   8) ? c1 : c0);
+        outBuf[ 5] = ((b &   4) ? c1 : c0);
+        outBuf[ 6] = ((b &   2) ? c1 : c0);
+        outBuf[ 7] = ((b &   1) ? c1 : c0);
+        c0 = bufp[4];
+        c1 = bufp[5];
+        b = bufp[6];
+        outBuf[ 8] = ((b & 128) ? c1 : c0);
+        outBuf[ 9] = ((b &  64) ? c1 : c0);
+        outBuf[10] = ((b &  32) ? c1 : c0);
+        outBuf[11] = ((b &  16) ? c1 : c0);
+        outBuf[12] = ((b &   8) ? c1 : c0);
+        outBuf[13] = ((b &   4) ? c1 : c0);
+        outBuf[14] = ((b &   2) ? c1 : c0);
+        outBuf[15] = ((b &   1) ? c1 : c0);
+        outBuf = outBuf + 16;
+        bufp = bufp + 7;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x06);
+      break;
+    case 0x08:                        // 8 pixels, 256 colors
+      do
+      {
+        outBuf[ 1] = outBuf[ 0] = bufp[1];
+        outBuf[ 3] = outBuf[ 2] = bufp[2];
+        outBuf[ 5] = outBuf[ 4] = bufp[3];
+        outBuf[ 7] = outBuf[ 6] = bufp[4];
+        outBuf[ 9] = outBuf[ 8] = bufp[5];
+        outBuf[11] = outBuf[10] = bufp[6];
+        outBuf[13] = outBuf[12] = bufp[7];
+        outBuf[15] = outBuf[14] = bufp[8];
+        outBuf = outBuf + 16;
+        bufp = bufp + 9;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x08);
+      break;
+    default:                          // invalid flag byte
+      do
+      {
+        *(outBuf++) = 0x00;
+      }
+      while (outBuf < endp);
+      break;
+    }
+  }
+  while (outBuf < endp);
+
+  (void) nBytes;
+}
+
+struct DisplayBenchResult {
+  int     lines;
+  double  oldTime;
+  double  newTime;
+  size_t  mismatchedPixels;
+};
+
+// decode and draw the lines currently displayed 'nRepeats' times with both
+// line decoders, to a double scanned frame buffer limited to the viewport
+static void runDisplayBenchmark(Ep128Emu::LibretroDisplay& w, int nRepeats,
+                                DisplayBenchResult& r)
+{
+  const int   screenWidth = EP128EMU_LIBRETRO_SCREEN_WIDTH;
+  int     x1 = w.viewPortX1;
+  int     y1 = w.viewPortY1;
+  int     x2 = w.viewPortX2;
+  int     y2 = w.viewPortY2;
+  int     currWidth = x2 - x1 + 1;
+  size_t  frameSize = size_t(currWidth) * size_t(y2 - y1 + 2);
+  std::vector< BenchPixel >     oldFrame(frameSize, BenchPixel(0));
+  std::vector< BenchPixel >     newFrame(frameSize, BenchPixel(0));
+  std::vector< unsigned char >  indexBuf(screenWidth);
+  std::vector< BenchPixel >     lineBuf(screenWidth);
+  // the palette is read back through the current decoder, from lines of
+  // 16 pixel wide groups of a single color
+  BenchPixel  palette[256];
+  {
+    unsigned char tmp[96];
+    for (int c = 0; c < 256; c++) {
+      for (int i = 0; i < 48; i++) {
+        tmp[i * 2] = 0x01;
+        tmp[i * 2 + 1] = (unsigned char) c;
+      }
+      w.decodeLine(&(lineBuf.front()), &(tmp[0]), sizeof(tmp));
+      palette[c] = lineBuf[0];
+    }
+  }
+  // only the even lines are drawn if interlace is not used
+  int     firstLine = (y1 + 1) & (~1);
+  r.lines = 0;
+  for (int yc = firstLine; yc <= y2; yc += 2) {
+    const unsigned char *bufp = (unsigned char *) 0;
+    size_t  nBytes = 0;
+    w.getLineData(yc, bufp, nBytes);
+    if (nBytes > 0)
+      r.lines++;
+  }
+  Ep128Emu::Timer t;
+  for (int n = 0; n < nRepeats; n++) {
+    for (int yc = firstLine; yc <= y2; yc += 2) {
+      const unsigned char *bufp = (unsigned char *) 0;
+      size_t  nBytes = 0;
+      w.getLineData(yc, bufp, nBytes);
+      if (nBytes < 1)
+        continue;
+      decodeLineIndexed(&(indexBuf.front()), bufp, nBytes);
+      int     currLine = yc - y1;
+      for (int i = 0; i < screenWidth; i++) {
+        if (i < x1 || i > x2)
+          continue;
+        BenchPixel  c = palette[indexBuf[i]];
+        oldFrame[currLine * currWidth + (i - x1)] = c;
+        oldFrame[(currLine + 1) * currWidth + (i - x1)] = c;
+      }
+    }
+  }
+  r.oldTime = t.getRealTime();
+  t.reset();
+  for (int n = 0; n < nRepeats; n++) {
+    for (int yc = firstLine; yc <= y2; yc += 2) {
+      const unsigned char *bufp = (unsigned char *) 0;
+      size_t  nBytes = 0;
+      w.getLineData(yc, bufp, nBytes);
+      if (nBytes < 1)
+        continue;
+      w.decodeLine(&(lineBuf.front()), bufp, nBytes);
+      int     currLine = yc - y1;
+      size_t  rowBytes = size_t(currWidth) * sizeof(BenchPixel);
+      std::memcpy(&(newFrame[currLine * currWidth]), &(lineBuf[x1]),
+                  rowBytes);
+      std::memcpy(&(newFrame[(currLine + 1) * currWidth]), &(lineBuf[x1]),
+                  rowBytes);
+    }
+  }
+  r.newTime = t.getRealTime();
+  r.mismatchedPixels = 0;
+  for (size_t i = 0; i < frameSize; i++) {
+    if (oldFrame[i] != newFrame[i])
+      r.mismatchedPixels++;
+  }
+}
+
+static long getPeakRSS()
+{
+#ifndef WIN32
+  struct rusage r;
+  if (getrusage(RUSAGE_SELF, &r) == 0)
+    return long(r.ru_maxrss);           // in kilobytes on Linux
+#endif
+  return 0L;
+}
+
+static void printUsage(const char *prgName)
+{
+  std::fprintf(stderr,
+               "usage: %s [-m MACHINE] [-s SECONDS] [-r SYSTEMDIR] "
+               "[-d REPEATS] [CONTENT]\n", prgName);
+}
+
+int main(int argc, char **argv)
+{
+  std::string machineName("EP128_TAPE");
+  std::string contentFile("");
+  std::string systemDirectory(".");
+  double      emulatedSeconds = 60.0;
+  int         displayRepeats = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-m") == 0 && (i + 1) < argc) {
+      machineName = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "-s") == 0 && (i + 1) < argc) {
+      emulatedSeconds = std::atof(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "-r") == 0 && (i + 1) < argc) {
+      systemDirectory = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "-d") == 0 && (i + 1) < argc) {
+      displayRepeats = std::atoi(argv[++i]);
+    }
+    else if (argv[i][0] != '-' && contentFile.empty()) {
+      contentFile = argv[i];
+    }
+    else {
+      printUsage(argv[0]);
+      return -1;
+    }
+  }
+  for (int i = 0; benchMachineAliases[i][0]; i++) {
+    if (machineName == benchMachineAliases[i][0]) {
+      machineName = benchMachineAliases[i][1];
+      break;
+    }
+  }
+  std::map< std::string, int >::const_iterator  iter =
+      Ep128Emu::VM_config.find(machineName);
+  if (iter == Ep128Emu::VM_config.end() ||
+      iter->second == Ep128Emu::VM_config.at("VM_CONFIG_AUTO") ||
+      iter->second == Ep128Emu::VM_config.at("VM_CONFIG_UNKNOWN")) {
+    std::fprintf(stderr, "invalid machine type: %s\n", machineName.c_str());
+    return -1;
+  }
+  bool    isDiskType = (machineName.find("_DISK") != std::string::npos);
+  bool    isTapeType = (machineName.find("_TAPE") != std::string::npos);
+  if (!contentFile.empty() && !(isDiskType || isTapeType)) {
+    std::fprintf(stderr, "content is only supported for disk and tape "
+                         "machine types\n");
+    return -1;
+  }
+  if (!(emulatedSeconds > 0.0))
+    emulatedSeconds = 60.0;
+
+  Ep128Emu::LibretroCore  *core = (Ep128Emu::LibretroCore *) 0;
+  try {
+    core = new Ep128Emu::LibretroCore(&benchLogCallback, iter->second,
+                                      Ep128Emu::LOCALE_UK, false,
+                                      systemDirectory.c_str(),
+                                      systemDirectory.c_str(), "", "",
+                                      false, false, true);
+    if (!contentFile.empty()) {
+      if (isDiskType) {
+        core->config->floppy.a.imageFile = contentFile;
+        core->config->floppyAChanged = true;
+      }
+      else {
+        core->config->tape.imageFile = contentFile;
+        core->config->tapeFileChanged = true;
+      }
+      core->config->applySettings();
+    }
+    core->start();
+    if (!contentFile.empty() && isTapeType)
+      core->vm->tapePlay();
+  }
+  catch (std::exception& e) {
+    std::fprintf(stderr, "error: %s\n", e.what());
+    if (core)
+      delete core;
+    return -1;
+  }
+
+  const retro_usec_t  frameTime = 20000;
+  size_t  nSlices = size_t(emulatedSeconds * 50.0 + 0.5);
+  int     expectedFrames =
+      int(float(frameTime * EP128EMU_SAMPLE_RATE) / 1000000.0f + 0.5f);
+  std::vector< int16_t >  audioBuffer(size_t(EP128EMU_SAMPLE_RATE) * 4);
+  double  emulationTime = 0.0;
+  double  displayTime = 0.0;
+  double  audioTime = 0.0;
+  uint64_t  audioFrames = 0;
+  uint32_t  firstFrame = core->w->frameCount;
+#ifdef EP128EMU_ENABLE_PROFILING
+  Ep128Emu::ProfilerStatus  startProfile;
+#endif
+  Ep128Emu::Timer totalTimer;
+  Ep128Emu::Timer t;
+  for (size_t i = 0; i < nSlices; i++) {
+    core->update_input(&benchInputStateCallback, &benchEnvironmentCallback,
+                       1U);
+    t.reset();
+    core->run_for(frameTime, (void *) 0);
+    emulationTime += t.getRealTime();
+    t.reset();
+    size_t  nFrames = 0;
+    core->audioOutput->forwardAudioData(&(audioBuffer.front()), &nFrames,
+                                        expectedFrames);
+    audioFrames += nFrames;
+    audioTime += t.getRealTime();
+    t.reset();
+    core->sync_display();
+    core->render(&benchVideoCallback, &benchEnvironmentCallback);
+    displayTime += t.getRealTime();
+  }
+  double  wallTime = totalTimer.getRealTime();
+  uint32_t  nFrames = core->w->frameCount - firstFrame;
+  double  cpuFrequency = double(core->config->vm.cpuClockFrequency);
+  double  actualSeconds = double(nSlices) * double(frameTime) / 1000000.0;
+  if (!(wallTime > 0.0))
+    wallTime = 1.0e-9;
+
+  std::printf("{\n");
+  std::printf("  \"machine\": \"%s\",\n", machineName.c_str());
+  std::printf("  \"content\": \"");
+  for (size_t i = 0; i < contentFile.length(); i++) {
+    char    c = contentFile[i];
+    if (c == '"' || c == '\\')
+      std::printf("\\%c", c);
+    else if ((unsigned char) c >= 0x20)
+      std::printf("%c", c);
+  }
+  std::printf("\",\n");
+  std::printf("  \"emulated_seconds\": %.3f,\n", actualSeconds);
+  std::printf("  \"wall_seconds\": %.6f,\n", wallTime);
+  std::printf("  \"speed\": %.3f,\n", actualSeconds / wallTime);
+  std::printf("  \"cpu_clock_mhz\": %.6f,\n", cpuFrequency / 1000000.0);
+  std::printf("  \"emulated_mhz\": %.3f,\n",
+              cpuFrequency * actualSeconds / wallTime / 1000000.0);
+  std::printf("  \"frames\": %lu,\n", (unsigned long) nFrames);
+  std::printf("  \"frames_per_second\": %.3f,\n", double(nFrames) / wallTime);
+  std::printf("  \"audio_frames\": %lu,\n", (unsigned long) audioFrames);
+  std::printf("  \"time\": {\n");
+  std::printf("    \"emulation\": %.6f,\n", emulationTime);
+  std::printf("    \"display\": %.6f,\n", displayTime);
+  std::printf("    \"audio\": %.6f\n", audioTime);
+  std::printf("  },\n");
+  if (displayRepeats > 0) {
+    DisplayBenchResult  r;
+    runDisplayBenchmark(*(core->w), displayRepeats, r);
+    double  nLines = double(r.lines) * double(displayRepeats);
+    if (!(nLines > 0.0))
+      nLines = 1.0;
+    std::printf("  \"display_decode\": {\n");
+    std::printf("    \"lines\": %d,\n", r.lines);
+    std::printf("    \"repeats\": %d,\n", displayRepeats);
+    std::printf("    \"old_seconds\": %.6f,\n", r.oldTime);
+    std::printf("    \"new_seconds\": %.6f,\n", r.newTime);
+    std::printf("    \"old_ns_per_line\": %.1f,\n",
+                r.oldTime * 1.0e9 / nLines);
+    std::printf("    \"new_ns_per_line\": %.1f,\n",
+                r.newTime * 1.0e9 / nLines);
+    std::printf("    \"speedup\": %.3f,\n",
+                r.oldTime / (r.newTime > 0.0 ? r.newTime : 1.0e-9));
+    std::printf("    \"mismatched_pixels\": %lu\n",
+                (unsigned long) r.mismatchedPixels);
+    std::printf("  },\n");
+  }
+#ifdef EP128EMU_ENABLE_PROFILING
+  {
+    Ep128Emu::ProfilerStatus  endProfile;
+    std::printf("  \"profile\": {\n");
+    for (int i = 0; i < int(Ep128Emu::PROFILER_COUNTER_CNT); i++) {
+      std::printf("    \"%s\": { \"seconds\": %.6f, \"calls\": %lu }%s\n",
+                  Ep128Emu::ProfilerStatus::getCounterName(i),
+                  endProfile.seconds[i] - startProfile.seconds[i],
+                  (unsigned long) (endProfile.calls[i] - startProfile.calls[i]),
+                  (i + 1) < int(Ep128Emu::PROFILER_COUNTER_CNT) ? "," : "");
+    }
+    std::printf("  },\n");
+  }
+#endif
+  std::printf("  \"peak_rss_kb\": %ld\n", getPeakRSS());
+  std::printf("}\n");
+
+  delete core;
+  return 0;
+}
@@ -22,18 +22,30 @@
 namespace Ep128Emu {
 
 LibretroCore::LibretroCore(retro_log_printf_t log_cb_, int machineDetailedType_, int contentLocale, bool canSkipFrames_, const char* romDirectory_, const char* saveDirectory_,
-                           const char* startSequence_, const char* cfgFile, bool useHalfFrame_, bool enhancedRom)
+                           const char* startSequence_, const char* cfgFile, bool useHalfFrame_, bool enhancedRom, bool singleThreaded_)
   : log_cb(log_cb_),
     autofireFrame(0),
     autofireButtonId(256),
     autofireFrameCycle(1),
+    warpLastActiveFrame(0),
+    tapeWarpMessageCounter(0),
     useHalfFrame(useHalfFrame_),
     isHalfFrame(useHalfFrame_),
     canSkipFrames(canSkipFrames_),
+    canDupeFrames(false),
+    singleThreaded(singleThreaded_),
+    videoEnabled(true),
+    audioEnabled(true),
+    warpActive(false),
+    tapeWarpEnabled(false),
+    tapeWarpActive(false),
     joypadConfigChanged(false),
     prevFrameCount(0),
+    prevChangedFrameCount(0),
     startSequenceIndex(0),
     currWidth(EP128EMU_LIBRETRO_SCREEN_WIDTH),
+    currViewWidth(EP128EMU_LIBRETRO_SCREEN_WIDTH),
+    widthShift(0),
     fullHeight(EP128EMU_LIBRETRO_SCREEN_HEIGHT),
     halfHeight(EP128EMU_LIBRETRO_SCREEN_HEIGHT/2),
     defaultHalfHeight(EP128EMU_LIBRETRO_SCREEN_HEIGHT/2),
@@ -89,7 +101,7 @@ LibretroCore::LibretroCore(retro_log_printf_t log_cb_, int machineDetailedType_,
 
   audioOutput = new Ep128Emu::AudioOutput_libretro();
   //audioOutput->setOutputFile("/tmp/core_sound.wav");
-  w = new Ep128Emu::LibretroDisplay(32, 32, EP128EMU_LIBRETRO_SCREEN_WIDTH, EP128EMU_LIBRETRO_SCREEN_HEIGHT, "", useHalfFrame);
+  w = new Ep128Emu::LibretroDisplay(32, 32, EP128EMU_LIBRETRO_SCREEN_WIDTH, EP128EMU_LIBRETRO_SCREEN_HEIGHT, "", useHalfFrame, singleThreaded);
   if(machineType == MACHINE_TVC)
   {
     vm = new TVC64::TVC64VM(*(dynamic_cast<Ep128Emu::VideoDisplay *>(w)),
@@ -973,6 +985,8 @@ void LibretroCore::update_input(retro_input_state_t input_state_cb, retro_enviro
           if(i<128)
           {
             vmThread->setKeyboardState(i,true);
+            // user input means the loaded program is in use
+            stop_warp();
           }
           // All other codes are interpreted by the libretro core itself.
           else
@@ -1022,6 +1036,11 @@ void LibretroCore::update_input(retro_input_state_t input_state_cb, retro_enviro
       }
     }
   }
+  update_start_sequence();
+}
+
+void LibretroCore::update_start_sequence(void)
+{
   // startSequence handling.
   // Send keyboard input at specific frames (down presses)
   if (startSequenceIndex < startSequence.length())
@@ -1081,6 +1100,8 @@ void LibretroCore::update_input(retro_input_state_t input_state_cb, retro_enviro
 
 void LibretroCore::render(retro_video_refresh_t video_cb, retro_environment_t environ_cb)
 {
+  int prevWidth = currWidth;
+  int prevHeight = currHeight;
   // Transition from half frame (normal video mode) to interlaced
   if (useHalfFrame && isHalfFrame && w->interlacedFrameCount > 0)
   {
@@ -1134,6 +1155,12 @@ void LibretroCore::render(retro_video_refresh_t video_cb, retro_environment_t en
       }
     }
   }
+  // Transition between full and native horizontal resolution
+  if (w->frameWidthShift != widthShift)
+  {
+    widthShift = w->frameWidthShift;
+    change_resolution(currViewWidth, currHeight, environ_cb);
+  }
   unsigned stride  = currWidth;
 
   if (canSkipFrames && prevFrameCount == w->frameCount)
@@ -1141,9 +1168,17 @@ void LibretroCore::render(retro_video_refresh_t video_cb, retro_environment_t en
     log_cb(RETRO_LOG_DEBUG, "frame dupe %d \n",prevFrameCount);
     video_cb(NULL, 0, 0, 0);
   }
+  // Nothing was redrawn by the display since the last frame was sent
+  else if (canDupeFrames && prevChangedFrameCount == w->changedFrameCount &&
+           currWidth == prevWidth && currHeight == prevHeight)
+  {
+    prevFrameCount = w->frameCount;
+    video_cb(NULL, currWidth, currHeight, 0);
+  }
   else
   {
     prevFrameCount = w->frameCount;
+    prevChangedFrameCount = w->changedFrameCount;
     {
       // Video callback, stride depends on pixel format (4 byte / 2 byte)
 #ifdef EP128EMU_USE_XRGB8888
@@ -1166,6 +1201,8 @@ void LibretroCore::change_resolution(int width, int height, retro_environment_t
                    (float) (isHalfFrame ? EP128EMU_LIBRETRO_SCREEN_HEIGHT/2/(float)height : EP128EMU_LIBRETRO_SCREEN_HEIGHT/(float)height) *
                    (float) (EP128EMU_LIBRETRO_SCREEN_WIDTH/(float)width)
                   );
+  currViewWidth = width;
+  width = width >> widthShift;
   retro_game_geometry g =
   {
     .base_width   = (unsigned int) width,
@@ -1184,12 +1221,15 @@ void LibretroCore::start(void)
 {
   vmThread->setSpeedPercentage(0);
   vmThread->lock(0x7FFFFFFF);
-  vmThread->unlock();
+  // In single-threaded mode the emulation thread is kept locked,
+  // and run_for() calls VMThread::process() directly.
+  if (!singleThreaded)
+    vmThread->unlock();
   vmThread->pause(false);
-  log_cb(RETRO_LOG_DEBUG, "Core started\n");
+  log_cb(RETRO_LOG_DEBUG, "Core started%s\n", singleThreaded ? " (single-threaded)" : "");
 }
 
-void LibretroCore::run_for(retro_usec_t frameTime, float waitPeriod, void * fb)
+void LibretroCore::run_for(retro_usec_t frameTime, void * fb)
 {
   //Ep128Emu::VMThread::VMThreadStatus  vmThreadStatus(*vmThread);
   //log_cb(RETRO_LOG_DEBUG, "Running core for %d ms\n",frameTime);
@@ -1214,14 +1254,20 @@ void LibretroCore::run_for(retro_usec_t frameTime, float waitPeriod, void * fb)
   }
 
   vmThread->allowRunFor(frameTime);
-  do
+  if (singleThreaded)
   {
-    w->wakeDisplay(false);
-    if (vmThread->isReady()) break;
-    if (waitPeriod > 0)
-      Timer::wait(waitPeriod);
+    // run the emulation on the calling thread, display data is processed
+    // in sync_display()
+    while (!vmThread->isReady())
+    {
+      if (!vmThread->process())
+        break;
+    }
+    return;
   }
-  while(true);
+  w->wakeDisplay(false);
+  // sleep until the emulation thread signals that the frame is complete
+  vmThread->waitUntilReady();
 }
 
 void LibretroCore::sync_display(void)
@@ -1229,6 +1275,174 @@ void LibretroCore::sync_display(void)
   w->wakeDisplay(true);
 }
 
+void LibretroCore::set_av_enable(bool videoEnabled_, bool audioEnabled_)
+{
+  if (videoEnabled_ != videoEnabled)
+  {
+    videoEnabled = videoEnabled_;
+    // Line data is still collected while video is disabled, so that the
+    // next frame shown is complete; only the conversion to pixels is skipped.
+    w->setSkipDraw(!videoEnabled);
+  }
+  if (audioEnabled_ != audioEnabled)
+  {
+    audioEnabled = audioEnabled_;
+    vm->setEnableAudioOutput(audioEnabled && config->sound.enabled);
+  }
+}
+
+// Autostart and tape warp: run additional frames with video and audio output
+// disabled, so that booting, typing the start sequence and loading the program
+// take a fraction of the real time. Frames are run for most of the frame
+// period; the warp state only depends on the number of emulated frames, and
+// warp frames are not run during run-ahead or netplay.
+void LibretroCore::run_warp(retro_usec_t frameTime, retro_environment_t environ_cb)
+{
+  update_warp_state();
+  update_tape_warp_state();
+  if (!warpActive && !tapeWarpActive)
+    return;
+  set_av_enable(false, false);
+  Ep128Emu::Timer timer;
+  double  timeLimit = double(frameTime) * 0.000001 * WARP_FRAME_TIME_USED;
+  do
+  {
+    run_for(frameTime, NULL);
+    sync_display();
+    update_start_sequence();
+    update_warp_state();
+    // return to normal speed as soon as the tape motor is stopped
+    if (!update_tape_warp_state() && !warpActive)
+      break;
+  }
+  while (timer.getRealTime() < timeLimit);
+  if (tapeWarpActive)
+  {
+    if (tapeWarpMessageCounter == 0)
+    {
+      double tapePosition = 0.0;
+      double tapeLength = 0.0;
+      get_tape_loading(tapePosition, tapeLength);
+      show_tape_warp_message(tapePosition, tapeLength, environ_cb);
+    }
+    if (++tapeWarpMessageCounter >= TAPE_WARP_MESSAGE_FRAMES)
+      tapeWarpMessageCounter = 0;
+  }
+}
+
+void LibretroCore::stop_warp(void)
+{
+  if (warpActive)
+  {
+    warpActive = false;
+    log_cb(RETRO_LOG_DEBUG, "Autostart warp stopped at frame %u\n", (unsigned int)w->frameCount);
+  }
+}
+
+// The frame counter, the display line counters and the autostart state are
+// saved together with VM checkpoints, so that after a run-ahead rollback the
+// start sequence keys are typed again at the same frames.
+void LibretroCore::save_autostart_state(Ep128Emu::File::Buffer& buf)
+{
+  buf.truncate();
+  buf.writeUInt32(0x01000001);        // version number
+  buf.writeUInt32(w->frameCount);
+  buf.writeUInt32(uint32_t(startSequenceIndex));
+  buf.writeBoolean(warpActive);
+  buf.writeUInt32(warpLastActiveFrame);
+  w->saveState(buf);
+}
+
+void LibretroCore::load_autostart_state(Ep128Emu::File::Buffer& buf)
+{
+  buf.setPosition(0);
+  if (buf.readUInt32() != 0x01000001)
+    throw Ep128Emu::Exception("incompatible autostart state format");
+  w->frameCount = buf.readUInt32();
+  // do not report the next frame as a duplicate of the current one
+  prevFrameCount = w->frameCount;
+  startSequenceIndex = buf.readUInt32();
+  warpActive = buf.readBoolean();
+  warpLastActiveFrame = buf.readUInt32();
+  w->loadState(buf);
+}
+
+// The program is considered to be ready when the start sequence is complete,
+// and there has been no tape motor or disk drive activity for a while.
+void LibretroCore::update_warp_state(void)
+{
+  if (!warpActive)
+    return;
+  if (startSequenceIndex <= startSequence.length())
+  {
+    warpLastActiveFrame = w->frameCount;
+  }
+  else
+  {
+    Ep128Emu::VMThread::VMThreadStatus  vmThreadStatus(*vmThread);
+    if ((vmThreadStatus.tapeMotorOn &&
+         vmThreadStatus.tapePosition < vmThreadStatus.tapeLength) ||
+        (vmThreadStatus.floppyDriveLEDState & ~0xC0U) != 0U)
+    {
+      warpLastActiveFrame = w->frameCount;
+    }
+  }
+  if ((w->frameCount - warpLastActiveFrame) >= WARP_IDLE_FRAMES ||
+      w->frameCount >= WARP_MAX_FRAMES)
+  {
+    stop_warp();
+  }
+}
+
+// Tape warp is active while the tape is playing and the motor is on, unless
+// the autostart warp is already running. Returns the new state.
+bool LibretroCore::update_tape_warp_state(void)
+{
+  double tapePosition = 0.0;
+  double tapeLength = 0.0;
+  if (!tapeWarpEnabled || warpActive || !get_tape_loading(tapePosition, tapeLength))
+  {
+    stop_tape_warp();
+  }
+  else if (!tapeWarpActive)
+  {
+    tapeWarpActive = true;
+    tapeWarpMessageCounter = 0;
+    log_cb(RETRO_LOG_DEBUG, "Tape warp started at %.1f seconds\n", tapePosition);
+  }
+  return tapeWarpActive;
+}
+
+void LibretroCore::stop_tape_warp(void)
+{
+  if (tapeWarpActive)
+  {
+    tapeWarpActive = false;
+    log_cb(RETRO_LOG_DEBUG, "Tape warp stopped at frame %u\n", (unsigned int)w->frameCount);
+  }
+}
+
+bool LibretroCore::get_tape_loading(double& position, double& length)
+{
+  Ep128Emu::VMThread::VMThreadStatus  vmThreadStatus(*vmThread);
+  position = vmThreadStatus.tapePosition;
+  length = vmThreadStatus.tapeLength;
+  return (vmThreadStatus.tapeMotorOn && position >= 0.0 && position < length);
+}
+
+void LibretroCore::show_tape_warp_message(double position, double length, retro_environment_t environ_cb)
+{
+  char buf[64];
+  int  pos = int(position);
+  int  len = int(length);
+  std::snprintf(buf, sizeof(buf), "Tape loading: %d%% (%d:%02d / %d:%02d)",
+                int(position * 100.0 / length), pos / 60, pos % 60, len / 60, len % 60);
+  struct retro_message message;
+  message.msg = buf;
+  message.frames = TAPE_WARP_MESSAGE_FRAMES;
+  environ_cb(RETRO_ENVIRONMENT_SET_MESSAGE, &message);
+}
+
 void LibretroCore::errorCallback(void *userData, const char *msg)
 {
   (void) userData;
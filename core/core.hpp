@@ -134,6 +134,17 @@ const std::map<std::string, int> joystick_type {
 };
 const int JOY_TYPE_AMOUNT = 11;
 
+// Autostart warp ends after this many frames without tape or disk activity
+// once the start sequence is typed in, or after the frame limit at the latest.
+const unsigned int WARP_IDLE_FRAMES = 100;
+const unsigned int WARP_MAX_FRAMES = 50*60*5;
+// Fraction of the frame period spent running additional frames while
+// warping. Only whole frames are run, so the emulated state stays the same
+// as without warp, just reached sooner.
+const double WARP_FRAME_TIME_USED = 0.9;
+// Tape warp progress message is updated after this many frames shown
+const unsigned int TAPE_WARP_MESSAGE_FRAMES = 50;
+
 #define RETRO_DEVICE_EP_JOYSTICK_DEF  RETRO_DEVICE_SUBCLASS(RETRO_DEVICE_JOYPAD, 1)
 #define RETRO_DEVICE_EP_JOYSTICK_INT  RETRO_DEVICE_SUBCLASS(RETRO_DEVICE_JOYPAD, 2)
 #define RETRO_DEVICE_EP_JOYSTICK_EXT1 RETRO_DEVICE_SUBCLASS(RETRO_DEVICE_JOYPAD, 3)
@@ -272,6 +283,12 @@ private:
   unsigned int autofireFrame;
   unsigned int autofireButtonId;
   unsigned int autofireFrameCycle;
+  uint32_t warpLastActiveFrame;
+  unsigned int tapeWarpMessageCounter;
+
+  void update_start_sequence(void);
+  bool get_tape_loading(double& position, double& length);
+  void show_tape_warp_message(double position, double length, retro_environment_t environ_cb);
 
 public:
   uint16_t audioBuffer[EP128EMU_SAMPLE_RATE*1000*2];
@@ -280,10 +297,22 @@ public:
   bool useHalfFrame;
   bool isHalfFrame;
   bool canSkipFrames;
+  bool canDupeFrames;
+  bool singleThreaded;
+  bool videoEnabled;
+  bool audioEnabled;
+  bool warpActive;
+  bool tapeWarpEnabled;
+  bool tapeWarpActive;
   bool joypadConfigChanged;
   uint32_t prevFrameCount;
+  uint32_t prevChangedFrameCount;
   size_t startSequenceIndex;
   int currWidth;
+  // viewport width in full resolution (768 pixel) units, currWidth is
+  // this divided by 2 while the display uses native resolution
+  int currViewWidth;
+  int widthShift;
   int currHeight;
   int fullHeight;
   int halfHeight;
@@ -305,7 +334,7 @@ public:
   // ----------------
 
   LibretroCore(retro_log_printf_t log_cb_, int machineDetailedType, int contentLocale, bool canSkipFrames_, const char* romDirectory_, const char* saveDirectory_,
-  const char* startSequence_, const char* cfgFile, bool useHalfFrame, bool enhancedRom);
+  const char* startSequence_, const char* cfgFile, bool useHalfFrame, bool enhancedRom, bool singleThreaded_ = false);
   virtual ~LibretroCore();
 
   void initialize_keyboard_map(void);
@@ -315,8 +344,16 @@ public:
   void reset_joystick_map(int port, unsigned value);
   void reset_joystick_map(int port);
   void start(void);
-  void run_for(retro_usec_t frameTime, float waitPeriod, void * fb);
+  void run_for(retro_usec_t frameTime, void * fb);
   void sync_display();
+  void set_av_enable(bool videoEnabled_, bool audioEnabled_);
+  void run_warp(retro_usec_t frameTime, retro_environment_t environ_cb);
+  void stop_warp(void);
+  void update_warp_state(void);
+  void save_autostart_state(Ep128Emu::File::Buffer& buf);
+  void load_autostart_state(Ep128Emu::File::Buffer& buf);
+  bool update_tape_warp_state(void);
+  void stop_tape_warp(void);
   char* get_current_message(void);
   void update_input(retro_input_state_t input_state_cb, retro_environment_t environ_cb, unsigned maxUsers);
   void render(retro_video_refresh_t video_cb, retro_environment_t environ_cb);
@@ -64,30 +64,6 @@ struct retro_core_option_v2_category option_cats_us[] = {
 };
 
 struct retro_core_option_v2_definition option_defs_us[] = {
-   {
-      "ep128emu_wait",                            /* key (option name) */
-      "Main thread wait (ms)",                    /* description (label) */
-      NULL,                                       /* 'categorised' description (used instead of
-                                                   * 'description' if frontend has category
-                                                   * support; if NULL or empty, regular
-                                                   * description is always used */
-      "Forced sleep in main emulation loop, 0 means no sleep.", /* sublabel */
-      NULL,                                       /* 'categorised' sublabel (used instead of
-                                                   * 'sublabel' if frontend has category
-                                                   * support; if NULL or empty, regular
-                                                   * sublabel is always used */
-      "latency",                               /* category key (must match an entry in
-                                                   * option_cats_us; if NULL or empty,
-                                                   * option is uncategorised */
-      {
-         { "0",  "0" },                    /* value_1, value_1_label */
-         { "1",  "1" },                   /* value_2, value_2_label */
-         { "5",  "5" },                 /* value_3, value_3_label */
-         { "10", "10" },                  /* value_4, value_4_label */
-         { NULL, NULL },
-      },
-      "0"                                      /* default_value */
-   },
    {
       "ep128emu_sdhq",
       "High sound quality",
@@ -116,6 +92,20 @@ struct retro_core_option_v2_definition option_defs_us[] = {
       },
       "0"
    },
+   {
+      "ep128emu_sync",
+      "Single-threaded emulation (requires restart)",
+      NULL,
+      "Run emulation and rendering on the frontend thread. Frames are deterministic, at the cost of some performance on multi-core systems.",
+      NULL,
+      "latency",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
    {
       "ep128emu_useh",
       "Enable resolution changes (requires restart)",
@@ -162,6 +152,106 @@ struct retro_core_option_v2_definition option_defs_us[] = {
       },
       "Original"
    },
+   {
+      "ep128emu_warp",
+      "Warp speed autostart",
+      NULL,
+      "Run the emulation at maximum speed without sound while the startup sequence is typed in and the content is loading from tape or disk. Normal speed resumes when loading stops or any button is pressed.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+   {
+      "ep128emu_tapewarp",
+      "Warp speed tape loading",
+      NULL,
+      "Run the emulation at maximum speed without sound whenever the tape is playing and the tape motor is on, showing the tape position. Normal speed resumes as soon as the motor stops.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+   {
+      "ep128emu_nres",
+      "Native horizontal resolution",
+      NULL,
+      "Output frames at the native width of most video modes (384 pixels instead of 768), switching to full width only while hi-res content is displayed. Reduces the work of the frontend and of video filters.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+   {
+      "ep128emu_tapetraps",
+      "Fast tape loading",
+      NULL,
+      "Load tape data blocks instantly when the ROM loader routine is called (ZX and CPC, TAP/TZX/CDT images only). Programs with custom loaders still load in real time.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+   {
+      "ep128emu_cow",
+      "Keep disk images unmodified",
+      NULL,
+      "Open floppy and IDE disk images read-only, and store the sectors written by the emulated machine in a delta file in the save directory. The changes are applied again when the same image is loaded later. Takes effect for the next disk image loaded.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+   {
+      "ep128emu_fdcturbo",
+      "Fast floppy disk access (CPC)",
+      NULL,
+      "Skip the seek, head load and rotational delays of the CPC floppy disk controller, and transfer sector data as fast as the emulated program reads it. Disk images with copy protection features are still emulated with accurate timing.",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+#ifdef EP128EMU_ENABLE_PROFILING
+   {
+      "ep128emu_prof",
+      "Log profiling summary",
+      NULL,
+      "Log the time spent in the emulation, video and audio conversion once per second (profiling builds only).",
+      NULL,
+      "hacks",
+      {
+         { "0",  "Off" },
+         { "1",  "On" },
+         { NULL, NULL },
+      },
+      "0"
+   },
+#endif
    {
       "ep128emu_zoom",
       "Player 1 Zoom button",
@@ -19,6 +19,7 @@
 #include "ep128emu.hpp"
 #include "system.hpp"
 #include "libretrodisp.hpp"
+#include "profiler.hpp"
 
 namespace Ep128Emu
 {
@@ -85,11 +86,15 @@ uint16_t LibretroDisplay::Colormap::pixelConvRGB565(double r, double g, double b
 
 
 
-void LibretroDisplay::decodeLine(unsigned char *outBuf,
+// Decode a line of compressed video data directly to frame buffer pixels,
+// looking up each color index in the palette only once per group.
+void LibretroDisplay::decodeLine(pixel_t *outBuf,
                                  const unsigned char *inBuf, size_t nBytes)
 {
+  EP128EMU_PROFILE_SCOPE(PROFILER_DISPLAY_DECODE);
+  const pixel_t *palette = colormap.getPalette();
   const unsigned char *bufp = inBuf;
-  unsigned char *endp = outBuf + 768;
+  pixel_t *endp = outBuf + 768;
   do
   {
     switch (bufp[0])
@@ -97,14 +102,9 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x00:                        // blank
       do
       {
-        outBuf[15] = outBuf[14] =
-        outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] =
-        outBuf[ 9] = outBuf[ 8] =
-        outBuf[ 7] = outBuf[ 6] =
-        outBuf[ 5] = outBuf[ 4] =
-        outBuf[ 3] = outBuf[ 2] =
-        outBuf[ 1] = outBuf[ 0] = 0x00;
+        pixel_t c = palette[0];
+        for (int i = 0; i < 16; i++)
+          outBuf[i] = c;
         outBuf = outBuf + 16;
         bufp = bufp + 1;
         if (outBuf >= endp)
@@ -115,14 +115,9 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x01:                        // 1 pixel, 256 colors
       do
       {
-        outBuf[15] = outBuf[14] =
-        outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] =
-        outBuf[ 9] = outBuf[ 8] =
-        outBuf[ 7] = outBuf[ 6] =
-        outBuf[ 5] = outBuf[ 4] =
-        outBuf[ 3] = outBuf[ 2] =
-        outBuf[ 1] = outBuf[ 0] = bufp[1];
+        pixel_t c = palette[bufp[1]];
+        for (int i = 0; i < 16; i++)
+          outBuf[i] = c;
         outBuf = outBuf + 16;
         bufp = bufp + 2;
         if (outBuf >= endp)
@@ -133,14 +128,13 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x02:                        // 2 pixels, 256 colors
       do
       {
-        outBuf[ 7] = outBuf[ 6] =
-        outBuf[ 5] = outBuf[ 4] =
-        outBuf[ 3] = outBuf[ 2] =
-        outBuf[ 1] = outBuf[ 0] = bufp[1];
-        outBuf[15] = outBuf[14] =
-        outBuf[13] = outBuf[12] =
-        outBuf[11] = outBuf[10] =
-        outBuf[ 9] = outBuf[ 8] = bufp[2];
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
+        for (int i = 0; i < 8; i++)
+        {
+          outBuf[i] = c0;
+          outBuf[i + 8] = c1;
+        }
         outBuf = outBuf + 16;
         bufp = bufp + 3;
         if (outBuf >= endp)
@@ -151,17 +145,14 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x03:                        // 8 pixels, 2 colors
       do
       {
-        unsigned char c0 = bufp[1];
-        unsigned char c1 = bufp[2];
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
         unsigned char b = bufp[3];
-        outBuf[ 1] = outBuf[ 0] = ((b & 128) ? c1 : c0);
-        outBuf[ 3] = outBuf[ 2] = ((b &  64) ? c1 : c0);
-        outBuf[ 5] = outBuf[ 4] = ((b &  32) ? c1 : c0);
-        outBuf[ 7] = outBuf[ 6] = ((b &  16) ? c1 : c0);
-        outBuf[ 9] = outBuf[ 8] = ((b &   8) ? c1 : c0);
-        outBuf[11] = outBuf[10] = ((b &   4) ? c1 : c0);
-        outBuf[13] = outBuf[12] = ((b &   2) ? c1 : c0);
-        outBuf[15] = outBuf[14] = ((b &   1) ? c1 : c0);
+        for (int i = 0; i < 16; i += 2)
+        {
+          outBuf[i + 1] = outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 1;
+        }
         outBuf = outBuf + 16;
         bufp = bufp + 4;
         if (outBuf >= endp)
@@ -172,14 +163,12 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x04:                        // 4 pixels, 256 colors
       do
       {
-        outBuf[ 3] = outBuf[ 2] =
-        outBuf[ 1] = outBuf[ 0] = bufp[1];
-        outBuf[ 7] = outBuf[ 6] =
-        outBuf[ 5] = outBuf[ 4] = bufp[2];
-        outBuf[11] = outBuf[10] =
-        outBuf[ 9] = outBuf[ 8] = bufp[3];
-        outBuf[15] = outBuf[14] =
-        outBuf[13] = outBuf[12] = bufp[4];
+        for (int i = 0; i < 4; i++)
+        {
+          pixel_t c = palette[bufp[i + 1]];
+          outBuf[(i << 2) + 3] = outBuf[(i << 2) + 2] =
+          outBuf[(i << 2) + 1] = outBuf[(i << 2) + 0] = c;
+        }
         outBuf = outBuf + 16;
         bufp = bufp + 5;
         if (outBuf >= endp)
@@ -190,28 +179,22 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x06:                        // 16 (2*8) pixels, 2*2 colors
       do
       {
-        unsigned char c0 = bufp[1];
-        unsigned char c1 = bufp[2];
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
         unsigned char b = bufp[3];
-        outBuf[ 0] = ((b & 128) ? c1 : c0);
-        outBuf[ 1] = ((b &  64) ? c1 : c0);
-        outBuf[ 2] = ((b &  32) ? c1 : c0);
-        outBuf[ 3] = ((b &  16) ? c1 : c0);
-        outBuf[ 4] = ((b &   8) ? c1 : c0);
-        outBuf[ 5] = ((b &   4) ? c1 : c0);
-        outBuf[ 6] = ((b &   2) ? c1 : c0);
-        outBuf[ 7] = ((b &   1) ? c1 : c0);
-        c0 = bufp[4];
-        c1 = bufp[5];
+        for (int i = 0; i < 8; i++)
+        {
+          outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 1;
+        }
+        c0 = palette[bufp[4]];
+        c1 = palette[bufp[5]];
         b = bufp[6];
-        outBuf[ 8] = ((b & 128) ? c1 : c0);
-        outBuf[ 9] = ((b &  64) ? c1 : c0);
-        outBuf[10] = ((b &  32) ? c1 : c0);
-        outBuf[11] = ((b &  16) ? c1 : c0);
-        outBuf[12] = ((b &   8) ? c1 : c0);
-        outBuf[13] = ((b &   4) ? c1 : c0);
-        outBuf[14] = ((b &   2) ? c1 : c0);
-        outBuf[15] = ((b &   1) ? c1 : c0);
+        for (int i = 8; i < 16; i++)
+        {
+          outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 1;
+        }
         outBuf = outBuf + 16;
         bufp = bufp + 7;
         if (outBuf >= endp)
@@ -222,14 +205,11 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     case 0x08:                        // 8 pixels, 256 colors
       do
       {
-        outBuf[ 1] = outBuf[ 0] = bufp[1];
-        outBuf[ 3] = outBuf[ 2] = bufp[2];
-        outBuf[ 5] = outBuf[ 4] = bufp[3];
-        outBuf[ 7] = outBuf[ 6] = bufp[4];
-        outBuf[ 9] = outBuf[ 8] = bufp[5];
-        outBuf[11] = outBuf[10] = bufp[6];
-        outBuf[13] = outBuf[12] = bufp[7];
-        outBuf[15] = outBuf[14] = bufp[8];
+        for (int i = 0; i < 8; i++)
+        {
+          pixel_t c = palette[bufp[i + 1]];
+          outBuf[(i << 1) + 1] = outBuf[(i << 1) + 0] = c;
+        }
         outBuf = outBuf + 16;
         bufp = bufp + 9;
         if (outBuf >= endp)
@@ -240,7 +220,7 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
     default:                          // invalid flag byte
       do
       {
-        *(outBuf++) = 0x00;
+        *(outBuf++) = palette[0];
       }
       while (outBuf < endp);
       break;
@@ -255,10 +235,176 @@ void LibretroDisplay::decodeLine(unsigned char *outBuf,
 #endif
 }
 
+// Same as decodeLine(), but only every second pixel is stored (384 pixels).
+// Hi-res lines (flag 0x06) are not expected here, from those only the even
+// pixels are kept.
+void LibretroDisplay::decodeLineHalfWidth(pixel_t *outBuf,
+                                          const unsigned char *inBuf,
+                                          size_t nBytes)
+{
+  EP128EMU_PROFILE_SCOPE(PROFILER_DISPLAY_DECODE);
+  const pixel_t *palette = colormap.getPalette();
+  const unsigned char *bufp = inBuf;
+  pixel_t *endp = outBuf + 384;
+  do
+  {
+    switch (bufp[0])
+    {
+    case 0x00:                        // blank
+      do
+      {
+        pixel_t c = palette[0];
+        for (int i = 0; i < 8; i++)
+          outBuf[i] = c;
+        outBuf = outBuf + 8;
+        bufp = bufp + 1;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x00);
+      break;
+    case 0x01:                        // 1 pixel, 256 colors
+      do
+      {
+        pixel_t c = palette[bufp[1]];
+        for (int i = 0; i < 8; i++)
+          outBuf[i] = c;
+        outBuf = outBuf + 8;
+        bufp = bufp + 2;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x01);
+      break;
+    case 0x02:                        // 2 pixels, 256 colors
+      do
+      {
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
+        for (int i = 0; i < 4; i++)
+        {
+          outBuf[i] = c0;
+          outBuf[i + 4] = c1;
+        }
+        outBuf = outBuf + 8;
+        bufp = bufp + 3;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x02);
+      break;
+    case 0x03:                        // 8 pixels, 2 colors
+      do
+      {
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
+        unsigned char b = bufp[3];
+        for (int i = 0; i < 8; i++)
+        {
+          outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 1;
+        }
+        outBuf = outBuf + 8;
+        bufp = bufp + 4;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x03);
+      break;
+    case 0x04:                        // 4 pixels, 256 colors
+      do
+      {
+        for (int i = 0; i < 4; i++)
+        {
+          pixel_t c = palette[bufp[i + 1]];
+          outBuf[(i << 1) + 1] = outBuf[(i << 1) + 0] = c;
+        }
+        outBuf = outBuf + 8;
+        bufp = bufp + 5;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x04);
+      break;
+    case 0x06:                        // 16 (2*8) pixels, 2*2 colors
+      do
+      {
+        pixel_t c0 = palette[bufp[1]];
+        pixel_t c1 = palette[bufp[2]];
+        unsigned char b = bufp[3];
+        for (int i = 0; i < 4; i++)
+        {
+          outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 2;
+        }
+        c0 = palette[bufp[4]];
+        c1 = palette[bufp[5]];
+        b = bufp[6];
+        for (int i = 4; i < 8; i++)
+        {
+          outBuf[i] = ((b & 128) ? c1 : c0);
+          b = b << 2;
+        }
+        outBuf = outBuf + 8;
+        bufp = bufp + 7;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x06);
+      break;
+    case 0x08:                        // 8 pixels, 256 colors
+      do
+      {
+        for (int i = 0; i < 8; i++)
+          outBuf[i] = palette[bufp[i + 1]];
+        outBuf = outBuf + 8;
+        bufp = bufp + 9;
+        if (outBuf >= endp)
+          break;
+      }
+      while (bufp[0] == 0x08);
+      break;
+    default:                          // invalid flag byte
+      do
+      {
+        *(outBuf++) = palette[0];
+      }
+      while (outBuf < endp);
+      break;
+    }
+  }
+  while (outBuf < endp);
+
+  (void) nBytes;
+}
+
+void LibretroDisplay::getLineData(int n, const unsigned char*& buf,
+                                  size_t& nBytes) const
+{
+  buf = (unsigned char *) 0;
+  nBytes = 0;
+  if (n >= 0 && n < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2))
+    lineBuffers[n].getLineData(buf, nBytes);
+}
+
+bool LibretroDisplay::isHiResLine(const unsigned char *buf, size_t nBytes)
+{
+  size_t  i = 0;
+  while (i < nBytes)
+  {
+    unsigned char flag = buf[i];
+    if (flag == 0x06)
+      return true;
+    if (flag > 0x08)
+      break;
+    i = i + size_t(flag) + 1;
+  }
+  return false;
+}
+
 // --------------------------------------------------------------------------
 
-void LibretroDisplay::Message_LineData::copyLine(const uint8_t *buf,
-    size_t nBytes)
+void LibretroDisplay::LineData::copyLine(const uint8_t *buf, size_t nBytes)
 {
   nBytes_ = (unsigned int) nBytes;
   if (nBytes_ & 3U)
@@ -267,8 +413,8 @@ void LibretroDisplay::Message_LineData::copyLine(const uint8_t *buf,
     std::memcpy(&(buf_[0]), buf, nBytes_);
 }
 
-LibretroDisplay::Message_LineData&
-LibretroDisplay::Message_LineData::operator=(const Message_LineData& r)
+LibretroDisplay::LineData&
+LibretroDisplay::LineData::operator=(const LineData& r)
 {
   std::memcpy(&nBytes_, &(r.nBytes_),
               size_t((const char *) &(r.buf_[((r.nBytes_ + 7U) & (~7U)) / 4U])
@@ -276,46 +422,12 @@ LibretroDisplay::Message_LineData::operator=(const Message_LineData& r)
   return (*this);
 }
 
-void LibretroDisplay::deleteMessage(Message *m)
-{
-  messageQueueMutex.lock();
-  m->nxt = freeMessageStack;
-  freeMessageStack = m;
-  messageQueueMutex.unlock();
-}
-
-void LibretroDisplay::queueMessage(Message *m)
-{
-  messageQueueMutex.lock();
-  if (exitFlag)
-  {
-    messageQueueMutex.unlock();
-    std::free(m);
-    return;
-  }
-  m->nxt = (Message *) 0;
-  if (lastMessage)
-    lastMessage->nxt = m;
-  else
-    messageQueue = m;
-  lastMessage = m;
-//  bool    isFrameDone = (m->msgType == Message::MsgType_FrameDone);
-  messageQueueMutex.unlock();
-  /*if (EP128EMU_UNLIKELY(isFrameDone))
-  {
-    if (!videoResampleEnabled)
-    {
-      threadLock.wait(1);
-    }
-  }*/
-}
-
-
 void LibretroDisplay::setDisplayParameters(const DisplayParameters& dp)
 {
   // No other display parameters are supported.
   displayParameters.indexToRGBFunc = dp.indexToRGBFunc;
   colormap.setParams(dp);
+  fullRedrawNeeded = true;
 
 }
 
@@ -330,10 +442,13 @@ void LibretroDisplay::drawLine(const uint8_t *buf, size_t nBytes)
 
   if (curLine >= 0 && curLine < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2))
   {
-    Message_LineData  *m = allocateMessage<Message_LineData>();
-    m->lineNum = curLine;
-    m->copyLine(buf, nBytes);
-    queueMessage(m);
+    FieldBuffer&  f = fieldBuffers[writeFieldIndex];
+    // a field without vsync can revisit lines; drop them when full
+    if (f.nLines < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2))
+    {
+      f.lines[curLine].copyLine(buf, nBytes);
+      f.lineNums[f.nLines++] = uint16_t(curLine);
+    }
   }
   if (vsyncCnt != 0)
   {
@@ -372,24 +487,46 @@ void LibretroDisplay::vsyncStateChange(bool newState, unsigned int currentSlot_)
     else interlacedFrameCount = interlacedFrameCount > 0 ? interlacedFrameCount - 1 : 0;
   }
 }
+void LibretroDisplay::saveState(Ep128Emu::File::Buffer& buf)
+{
+  buf.writeInt32(curLine);
+  buf.writeInt32(vsyncCnt);
+  buf.writeBoolean(vsyncState);
+  buf.writeBoolean(oddFrame);
+  buf.writeUInt32(interlacedFrameCount);
+}
+
+void LibretroDisplay::loadState(Ep128Emu::File::Buffer& buf)
+{
+  curLine = buf.readInt32();
+  vsyncCnt = buf.readInt32();
+  vsyncState = buf.readBoolean();
+  oddFrame = buf.readBoolean();
+  interlacedFrameCount = buf.readUInt32();
+  // the partially written field does not match the restored line position
+  fieldBuffers[writeFieldIndex].nLines = 0;
+}
+
 // --------------------------------------------------------------------------
 
 LibretroDisplay::LibretroDisplay(int xx, int yy, int ww, int hh,
-                                 const char *lbl, bool useHalfFrame_)
+                                 const char *lbl, bool useHalfFrame_,
+                                 bool singleThreaded_)
   :     colormap(),
-        messageQueue((Message *) 0),
-        lastMessage((Message *) 0),
-        freeMessageStack((Message *) 0),
-        messageQueueMutex(),
-        lineBuffers((Message_LineData **) 0),
+        fieldBuffers((FieldBuffer *) 0),
+        writeFieldIndex(0),
+        readFieldIndex(1),
+        readyFieldIndex(2),
+        lineBuffers((LineData *) 0),
         curLine(0),
         vsyncCnt(0),
         skippingFrame(false),
         useHalfFrame(useHalfFrame_),
+        singleThreaded(singleThreaded_),
         framesPendingFlag(false),
         vsyncState(false),
         oddFrame(false),
-        lineBuf((unsigned char *) 0),
+        lineBuf((pixel_t *) 0),
         threadLock1(false),
         threadLock2(true),
         exitFlag(false),
@@ -398,6 +535,16 @@ LibretroDisplay::LibretroDisplay(int xx, int yy, int ww, int hh,
         redrawFlag(false),
         prvFrameWasOdd(false),
         lastLineNum(-2),
+        linesChanged((bool *) 0),
+        linesHiRes((bool *) 0),
+        nativeResolution(false),
+        fullRedrawNeeded(true),
+        prvFrameWasInterlaced(false),
+        prvDrawBuffer((void *) 0),
+        prvViewPortX1(-1),
+        prvViewPortY1(-1),
+        prvViewPortX2(-1),
+        prvViewPortY2(-1),
 #ifdef EP128EMU_USE_XRGB8888
         frame_buf1((uint32_t *) 0),
 #else
@@ -405,23 +552,24 @@ LibretroDisplay::LibretroDisplay(int xx, int yy, int ww, int hh,
 #endif // EP128EMU_USE_XRGB8888
         interlacedFrameCount(0),
         frameCount(0),
+        changedFrameCount(0),
         contentTopEdge(0),
         contentLeftEdge(0),
         contentBottomEdge(EP128EMU_LIBRETRO_SCREEN_HEIGHT-1),
         contentRightEdge(EP128EMU_LIBRETRO_SCREEN_WIDTH-1),
         scanBorders(false),
-        bordersScanned(false)
+        bordersScanned(false),
+        frameWidthShift(0)
 {
   try
   {
-    lineBuffers = new Message_LineData*[EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2];
-    for (size_t n = 0; n < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2); n++)
-      lineBuffers[n] = (Message_LineData *) 0;
+    fieldBuffers = new FieldBuffer[3];
+    lineBuffers = new LineData[EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2];
   }
   catch (...)
   {
-    if (lineBuffers)
-      delete[] lineBuffers;
+    if (fieldBuffers)
+      delete[] fieldBuffers;
     throw;
   }
   try
@@ -429,11 +577,18 @@ LibretroDisplay::LibretroDisplay(int xx, int yy, int ww, int hh,
     linesChanged = new bool[289];
     for (size_t n = 0; n < 289; n++)
       linesChanged[n] = false;
+    linesHiRes = new bool[EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2];
+    for (size_t n = 0; n < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2); n++)
+      linesHiRes[n] = false;
   }
   catch (...)
   {
     if (linesChanged)
       delete[] linesChanged;
+    if (linesHiRes)
+      delete[] linesHiRes;
+    delete[] lineBuffers;
+    delete[] fieldBuffers;
     throw;
   }
   resetViewport();
@@ -449,13 +604,23 @@ LibretroDisplay::LibretroDisplay(int xx, int yy, int ww, int hh,
 #endif // EP128EMU_USE_XRGB8888
   frame_bufActive = frame_buf1;
   frame_bufSpare = frame_buf3;
-  lineBuf = (unsigned char*) calloc(ww, sizeof(unsigned char));
-  this->start();
+  lineBuf = (pixel_t*) calloc(ww, sizeof(pixel_t));
+  // in single-threaded mode frames are processed by wakeDisplay() and the
+  // thread is not started here; join() in the destructor runs it only to
+  // see exitFlag and return
+  if (!singleThreaded)
+    this->start();
 }
 
 // Enable display processing. If sync is required, do not return until all input is processed.
+// In single-threaded mode, input is always processed before returning.
 void LibretroDisplay::wakeDisplay(bool syncRequired)
 {
+  if (singleThreaded)
+  {
+    processMessages();
+    return;
+  }
   threadLock1.notify();
   if (syncRequired)
   {
@@ -463,6 +628,20 @@ void LibretroDisplay::wakeDisplay(bool syncRequired)
   }
 }
 
+void LibretroDisplay::setSkipDraw(bool isEnabled)
+{
+  skippingFrame = isEnabled;
+}
+
+void LibretroDisplay::setNativeResolution(bool isEnabled)
+{
+  if (isEnabled != nativeResolution)
+  {
+    nativeResolution = isEnabled;
+    fullRedrawNeeded = true;
+  }
+}
+
 void LibretroDisplay::resetViewport()
 {
   setViewport(0,0,EP128EMU_LIBRETRO_SCREEN_WIDTH-1,EP128EMU_LIBRETRO_SCREEN_HEIGHT-1);
@@ -508,86 +687,63 @@ bool LibretroDisplay::isViewportDefault()
 // Main display routine implementing Thread::run.
 void LibretroDisplay::run()
 {
-  bool frameDone;
   while (true)
   {
     if (exitFlag) break;
-    frameDone = false;
     threadLock1.wait(10);
-    do
+    processMessages();
+    threadLock2.notify();
+  }
+}
+
+void LibretroDisplay::processMessages()
+{
+  bool frameDone;
+  do
+  {
+    frameDone = checkEvents();
+    if (frameDone && !skippingFrame)
     {
-      frameDone = checkEvents();
-      if (frameDone)
-      {
-        draw(frame_bufActive, scanBorders);
-        scanBorders = false;
-      }
+      draw(frame_bufActive, scanBorders);
+      scanBorders = false;
     }
-    while (frameDone);
-    threadLock2.notify();
   }
+  while (frameDone);
 }
 
 void LibretroDisplay::frameDone()
 {
-  Message *m = allocateMessage<Message_FrameDone>();
-  queueMessage(m);
+  // Publish the completed field, and continue with either the field last
+  // read by the display, or the previous one if it was not read in time.
+  int     prvIndex = readyFieldIndex.exchange(writeFieldIndex | 4,
+                                              std::memory_order_acq_rel);
+  writeFieldIndex = prvIndex & 3;
+  fieldBuffers[writeFieldIndex].nLines = 0;
 }
 
 bool LibretroDisplay::checkEvents()
 {
   redrawFlag = false;
-  while (true)
+  if (!(readyFieldIndex.load(std::memory_order_acquire) & 4))
+    return false;
+  readFieldIndex = readyFieldIndex.exchange(readFieldIndex,
+                                            std::memory_order_acq_rel) & 3;
+  const FieldBuffer&  f = fieldBuffers[readFieldIndex];
+  for (int i = 0; i < f.nLines; i++)
   {
-    messageQueueMutex.lock();
-    Message *m = messageQueue;
-    if (m)
-    {
-      messageQueue = m->nxt;
-      if (messageQueue)
-      {
-        if (!messageQueue->nxt)
-          lastMessage = messageQueue;
-      }
-      else
-        lastMessage = (Message *) 0;
-    }
-    messageQueueMutex.unlock();
-    if (!m)
-      break;
-
-    if (EP128EMU_EXPECT(m->msgType == Message::MsgType_LineData))
-    {
-      Message_LineData  *msg;
-      msg = static_cast<Message_LineData *>(m);
-      int     lineNum = msg->lineNum;
-      if (lineNum >= 0 && lineNum < 578)
-      {
-        lastLineNum = lineNum;
-        // check if this line has changed
-        if (lineBuffers[lineNum])
-        {
-          if (*(lineBuffers[lineNum]) == *msg)
-          {
-            deleteMessage(m);
-            continue;
-          }
-        }
-        linesChanged[lineNum >> 1] = true;
-        if (lineBuffers[lineNum])
-          deleteMessage(lineBuffers[lineNum]);
-        lineBuffers[lineNum] = msg;
-        continue;
-      }
-    }
-    else if (m->msgType == Message::MsgType_FrameDone)
-    {
-      redrawFlag = true;
-      deleteMessage(m);
-      break;
-    }
-    deleteMessage(m);
+    int     lineNum = f.lineNums[i];
+    lastLineNum = lineNum;
+    // check if this line has changed
+    if (lineBuffers[lineNum] == f.lines[lineNum])
+      continue;
+    linesChanged[lineNum >> 1] = true;
+    lineBuffers[lineNum] = f.lines[lineNum];
+    const unsigned char *bufp = (unsigned char *) 0;
+    size_t  nBytes = 0;
+    lineBuffers[lineNum].getLineData(bufp, nBytes);
+    linesHiRes[lineNum] = isHiResLine(bufp, nBytes);
   }
+  redrawFlag = true;
   return redrawFlag;
 }
 
@@ -606,31 +762,10 @@ LibretroDisplay::~LibretroDisplay()
   frame_bufSpare = NULL;
   free(lineBuf);
   lineBuf = NULL;
-  messageQueueMutex.lock();
-  while (freeMessageStack)
-  {
-    Message *m = freeMessageStack;
-    freeMessageStack = m->nxt;
-    std::free(m);
-  }
-  while (messageQueue)
-  {
-    Message *m = messageQueue;
-    messageQueue = m->nxt;
-    std::free(m);
-  }
-  lastMessage = (Message *) 0;
-  messageQueueMutex.unlock();
-  for (size_t n = 0; n < (EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2); n++)
-  {
-    Message *m = lineBuffers[n];
-    if (m)
-    {
-      lineBuffers[n] = (Message_LineData *) 0;
-      std::free(m);
-    }
-  }
+  delete[] fieldBuffers;
   delete[] lineBuffers;
+  delete[] linesChanged;
+  delete[] linesHiRes;
 }
 
 void LibretroDisplay::limitFrameRate(bool isEnabled)
@@ -640,6 +775,7 @@ void LibretroDisplay::limitFrameRate(bool isEnabled)
 
 void LibretroDisplay::draw(void * fb, bool scanForBorder)
 {
+  EP128EMU_PROFILE_SCOPE(PROFILER_DISPLAY_DRAW);
   int borderColor = 0;
   int firstNonzeroLine   = EP128EMU_LIBRETRO_SCREEN_HEIGHT;
   int firstNonzeroCol    = EP128EMU_LIBRETRO_SCREEN_WIDTH;
@@ -655,36 +791,104 @@ void LibretroDisplay::draw(void * fb, bool scanForBorder)
   {
     frame_bufActive = frame_buf1;
   }
+  // With native resolution, the frame is drawn 384 pixels wide unless any
+  // visible line has hi-res (width 1) pixels.
+  int widthShift = 0;
+  if (nativeResolution)
+  {
+    widthShift = 1;
+    for (int yc = viewPortY1; yc <= viewPortY2; yc++)
+    {
+      if (!interlacedFrameCount && (yc & 1)) continue;
+      if (linesHiRes[yc])
+      {
+        widthShift = 0;
+        break;
+      }
+    }
+  }
+  if (widthShift != frameWidthShift)
+  {
+    // the frame size changes, which the frontend frame buffer may not have
+    frameWidthShift = widthShift;
+    frame_bufActive = frame_buf1;
+    fullRedrawNeeded = true;
+  }
+  // Only the changed lines are converted if the previous frame was drawn
+  // to the same (own) frame buffer with the same settings. Border scanning
+  // and interlace need all lines.
+  bool fullRedraw = (fullRedrawNeeded || scanForBorder ||
+                     interlacedFrameCount || prvFrameWasInterlaced ||
+                     frame_bufActive != frame_buf1 ||
+                     (void *) frame_bufActive != prvDrawBuffer ||
+                     viewPortX1 != prvViewPortX1 || viewPortY1 != prvViewPortY1 ||
+                     viewPortX2 != prvViewPortX2 || viewPortY2 != prvViewPortY2);
+  bool frameChanged = fullRedraw;
+  fullRedrawNeeded = false;
+  prvFrameWasInterlaced = (interlacedFrameCount != 0);
+  prvDrawBuffer = (void *) frame_bufActive;
+  prvViewPortX1 = viewPortX1;
+  prvViewPortY1 = viewPortY1;
+  prvViewPortX2 = viewPortX2;
+  prvViewPortY2 = viewPortY2;
   for (int yc = 0; yc < EP128EMU_LIBRETRO_SCREEN_HEIGHT; yc++)
   {
     // Skip odd lines if interlace is not used.
     if (!interlacedFrameCount && (yc & 1)) continue;
     // Skip any display if not within viewport (inclusive).
     if (yc < viewPortY1 || yc > viewPortY2) continue;
-    if (lineBuffers[yc])
+    // Skip lines that are already up to date in the frame buffer.
+    if (!fullRedraw && !linesChanged[yc >> 1]) continue;
+    if (!lineBuffers[yc].isEmpty())
     {
+      frameChanged = true;
       // decode video data
       const unsigned char *bufp = (unsigned char *) 0;
       size_t  nBytes = 0;
       bool nonzero = false;
       bool nonborder = false;
-      lineBuffers[yc]->getLineData(bufp, nBytes);
-      decodeLine(lineBuf,bufp,nBytes);
-
-      for(int i=0; i<EP128EMU_LIBRETRO_SCREEN_WIDTH; i++)
+      lineBuffers[yc].getLineData(bufp, nBytes);
+      if (widthShift)
+        decodeLineHalfWidth(lineBuf,bufp,nBytes);
+      else
+        decodeLine(lineBuf,bufp,nBytes);
+
+      // only the pixels within the viewport (inclusive) are stored
+      int currWidth = (viewPortX2 - viewPortX1 + 1) >> widthShift;
+      int currLine = yc - viewPortY1;
+      const pixel_t *srcp = lineBuf + (viewPortX1 >> widthShift);
+      size_t rowBytes = size_t(currWidth) * sizeof(pixel_t);
+      // Fake interlace: use previous frame's alternate lines.
+      // Fake as there's no fading or other effect to actually emulate interlace artifacts
+      if (interlacedFrameCount)
       {
-        // Skip any display if not within viewport (inclusive).
-        if (i<viewPortX1 || i>viewPortX2) continue;
-        unsigned char pixelValue = lineBuf[i];
-
-#ifdef EP128EMU_USE_XRGB8888
-        uint32_t pixelResult = colormap(pixelValue);
-#else
-        uint16_t pixelResult = colormap(pixelValue);
-#endif // EP128EMU_USE_XRGB8888
-
-        if (scanForBorder && pixelResult > 0)
+        std::memcpy(&(frame_bufActive[currLine * currWidth]), srcp, rowBytes);
+        std::memcpy(&(frame_bufSpare[currLine * currWidth]), srcp, rowBytes);
+        if (yc < viewPortY2-1)
+          std::memcpy(&(frame_bufActive[(currLine+1) * currWidth]),
+                      &(frame_bufSpare[(currLine+1) * currWidth]), rowBytes);
+      }
+      else
+      {
+        if (useHalfFrame)
+        {
+          // use different addressing to achieve packed frame even in this case
+          std::memcpy(&(frame_bufActive[currLine/2 * currWidth]), srcp, rowBytes);
+        }
+        else
         {
+          // doublescan if half frame usage is disabled
+          std::memcpy(&(frame_bufActive[currLine * currWidth]), srcp, rowBytes);
+          std::memcpy(&(frame_bufActive[(currLine+1) * currWidth]), srcp, rowBytes);
+        }
+      }
+      if (scanForBorder)
+      {
+        for (int i = viewPortX1; i <= viewPortX2; i++)
+        {
+          pixel_t pixelResult = lineBuf[i >> widthShift];
+          if (pixelResult == 0)
+            continue;
           if (!nonzero)
           {
             nonzero=true;
@@ -706,32 +910,6 @@ void LibretroDisplay::draw(void * fb, bool scanForBorder)
             lastNonborderCol = i;
           }
         }
-        int currWidth = viewPortX2 - viewPortX1 + 1;
-        int currLine = yc - viewPortY1;
-        int currPos = i - viewPortX1;
-        // Fake interlace: use previous frame's alternate lines.
-        // Fake as there's no fading or other effect to actually emulate interlace artifacts
-        if (interlacedFrameCount)
-        {
-          frame_bufActive[currLine * currWidth + currPos] = pixelResult;
-          frame_bufSpare[currLine * currWidth + currPos] = pixelResult;
-          if (yc < viewPortY2-1)
-            frame_bufActive[(currLine+1) * currWidth + currPos] = frame_bufSpare[(currLine+1) * currWidth + currPos];
-        }
-        else
-        {
-          if (useHalfFrame)
-          {
-            // use different addressing to achieve packed frame even in this case
-            frame_bufActive[currLine/2 * currWidth + currPos] = pixelResult;
-          }
-          else
-          {
-            // doublescan if half frame usage is disabled
-            frame_bufActive[currLine * currWidth + currPos] = pixelResult;
-            frame_bufActive[(currLine+1) * currWidth + currPos] = pixelResult;
-          }
-        }
       }
       if(scanForBorder && nonzero)
       {
@@ -766,6 +944,10 @@ void LibretroDisplay::draw(void * fb, bool scanForBorder)
     }
     bordersScanned = true;
   }
+  for (size_t n = 0; n < 289; n++)
+    linesChanged[n] = false;
+  if (frameChanged)
+    changedFrameCount++;
 }
 
 }       // namespace Ep128Emu
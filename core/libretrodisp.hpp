@@ -25,9 +25,17 @@
 #include "display.hpp"
 #include "libretro-funcs.hpp"
 
+#include <atomic>
+
 namespace Ep128Emu {
 
   class LibretroDisplay : public VideoDisplay, private Thread {
+   public:
+#ifdef EP128EMU_USE_XRGB8888
+    typedef uint32_t  pixel_t;
+#else
+    typedef uint16_t  pixel_t;
+#endif // EP128EMU_USE_XRGB8888
    private:
     class Colormap {
      private:
@@ -50,59 +58,42 @@ namespace Ep128Emu {
         return palette16[c];
       }
 #endif // EP128EMU_USE_XRGB8888
+      inline const pixel_t *getPalette() const
+      {
+#ifdef EP128EMU_USE_XRGB8888
+        return palette32;
+#else
+        return palette16;
+#endif // EP128EMU_USE_XRGB8888
+      }
     };
     Colormap      colormap;
 
    protected:
-    class Message {
-     public:
-      enum {
-        MsgType_None = 0,
-        MsgType_LineData = 1,
-        MsgType_FrameDone = 2,
-        MsgType_SetParameters = 3
-      };
-      Message   *nxt;
-      intptr_t  msgType;
-      // --------
-      Message()
-        : nxt((Message *) 0),
-          msgType(MsgType_None)
-      {
-      }
-     protected:
-      Message(int msgType_)
-        : nxt((Message *) 0),
-          msgType(msgType_)
-      {
-      }
-    };
-    class Message_LineData : public Message {
+    class LineData {
      private:
       // number of bytes in buffer
       unsigned int  nBytes_;
-     public:
-      // line number
-      int       lineNum;
-     private:
       // a line of 768 pixels needs a maximum space of 768 * (9 / 16) = 432
       // ( = 108 * 4) bytes in compressed format
       uint32_t  buf_[108];
      public:
-      Message_LineData()
-        : Message(MsgType_LineData)
+      LineData()
+        : nBytes_(0U)
       {
-        nBytes_ = 0U;
-        lineNum = 0;
       }
       // copy a line (768 pixels in compressed format) to the buffer
       void copyLine(const uint8_t *buf, size_t nBytes);
-      inline void getLineData(const unsigned char*& buf, size_t& nBytes)
+      inline void getLineData(const unsigned char*& buf, size_t& nBytes) const
       {
-        buf = reinterpret_cast<unsigned char *>(&(buf_[0]));
+        buf = reinterpret_cast<const unsigned char *>(&(buf_[0]));
         nBytes = nBytes_;
       }
-      bool operator==(const Message_LineData& r) const
+      inline bool isEmpty() const
+      {
+        return (nBytes_ == 0U);
+      }
+      bool operator==(const LineData& r) const
       {
         if (r.nBytes_ != nBytes_)
           return false;
@@ -113,73 +104,55 @@ namespace Ep128Emu {
         }
         return true;
       }
-      Message_LineData& operator=(const Message_LineData& r);
+      LineData& operator=(const LineData& r);
     };
-    class Message_FrameDone : public Message {
-     public:
-      Message_FrameDone()
-        : Message(MsgType_FrameDone)
-      {
-      }
-    };
-    class Message_SetParameters : public Message {
-     public:
-      DisplayParameters dp;
-      Message_SetParameters()
-        : Message(MsgType_SetParameters),
-          dp()
+    // Preallocated storage for the lines of one field. The emulation thread
+    // fills one of these, and publishes it with frameDone().
+    struct FieldBuffer {
+      // number of lines stored, and their line numbers in drawing order
+      int       nLines;
+      uint16_t  lineNums[EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2];
+      LineData  lines[EP128EMU_LIBRETRO_SCREEN_HEIGHT + 2];
+      FieldBuffer()
+        : nLines(0)
       {
       }
     };
-    template <typename T>
-    T * allocateMessage()
-    {
-      void  *m_ = (void *) 0;
-      messageQueueMutex.lock();
-      if (freeMessageStack) {
-        Message *m = freeMessageStack;
-        freeMessageStack = m->nxt;
-        m_ = m;
-      }
-      messageQueueMutex.unlock();
-      if (!m_) {
-        // allocate space that is enough for the largest message type
-        m_ = std::malloc((sizeof(Message_LineData) | 15) + 1);
-        if (!m_)
-          throw std::bad_alloc();
-      }
-      T *m;
-      try {
-        m = new(m_) T();
-      }
-      catch (...) {
-        std::free(m_);
-        throw;
-      }
-      return m;
-    }
-    void deleteMessage(Message *m);
-    void queueMessage(Message *m);
-    static void decodeLine(unsigned char *outBuf,
-                           const unsigned char *inBuf, size_t nBytes);
+    // decode a line at half horizontal resolution (384 pixels)
+    void decodeLineHalfWidth(pixel_t *outBuf,
+                             const unsigned char *inBuf, size_t nBytes);
+    // returns true if the line contains pixels of width 1 (flag 0x06)
+    static bool isHiResLine(const unsigned char *buf, size_t nBytes);
     void frameDone();
     void run();
+    // read the completed fields and draw them
+    void processMessages();
     // ----------------
-    Message       *messageQueue;
-    Message       *lastMessage;
-    Message       *freeMessageStack;
-    Mutex         messageQueueMutex;
-    // for 578 lines (576 + 2 border)
-    Message_LineData  **lineBuffers;
+    // Triple buffered field storage: the emulation thread writes
+    // fieldBuffers[writeFieldIndex], the display reads
+    // fieldBuffers[readFieldIndex], and the index of the last completed
+    // field is exchanged through readyFieldIndex without locking
+    // (bit 2 is set if the field has not been read yet).
+    FieldBuffer   *fieldBuffers;
+    int           writeFieldIndex;
+    int           readFieldIndex;
+    std::atomic< int >  readyFieldIndex;
+    // lines currently displayed, for 578 lines (576 + 2 border)
+    LineData      *lineBuffers;
     int           curLine;
     int           vsyncCnt;
     int           framesPending;
-    bool          skippingFrame;
+    // if true, completed frames are not drawn to the frame buffer
+    volatile bool skippingFrame;
     bool          useHalfFrame;
+    // if true, messages are processed by the caller of wakeDisplay()
+    // instead of the display thread
+    bool          singleThreaded;
     bool          framesPendingFlag;
     bool          vsyncState;
     bool          oddFrame;
-    unsigned char *lineBuf;
+    // a decoded line of 768 pixels
+    pixel_t       *lineBuf;
     ThreadLock    threadLock1;
     ThreadLock    threadLock2;
     volatile bool videoResampleEnabled;
@@ -196,7 +169,20 @@ namespace Ep128Emu {
     bool          redrawFlag;
     bool          prvFrameWasOdd;
     int           lastLineNum;
+    // lines changed since the last draw(), indexed by line number / 2
     bool          *linesChanged;
+    // lines that need full horizontal resolution, indexed by line number
+    bool          *linesHiRes;
+    // if true, frames without hi-res lines are drawn 384 pixels wide
+    volatile bool nativeResolution;
+    // set if the whole frame needs to be converted on the next draw()
+    bool          fullRedrawNeeded;
+    bool          prvFrameWasInterlaced;
+    void          *prvDrawBuffer;
+    int           prvViewPortX1;
+    int           prvViewPortY1;
+    int           prvViewPortX2;
+    int           prvViewPortY2;
    public:
 #ifdef EP128EMU_USE_XRGB8888
     uint32_t *frame_buf1;
@@ -218,6 +204,8 @@ namespace Ep128Emu {
     uint32_t frameSize;
     uint32_t interlacedFrameCount;
     uint32_t frameCount;
+    // incremented by draw() if any line of the frame buffer was updated
+    uint32_t changedFrameCount;
     int      contentTopEdge;
     int      contentLeftEdge;
     int      contentBottomEdge;
@@ -228,8 +216,12 @@ namespace Ep128Emu {
     int      viewPortY2;
     volatile bool scanBorders;
     bool bordersScanned;
+    // 1 if the last frame was drawn at half horizontal resolution
+    // (the width of the frame is the viewport width >> frameWidthShift)
+    int      frameWidthShift;
     LibretroDisplay(int xx, int yy, int ww, int hh,
-                               const char *lbl, bool useHalfFrame_);
+                               const char *lbl, bool useHalfFrame_,
+                               bool singleThreaded_ = false);
     virtual ~LibretroDisplay();
     /*!
      * Set color correction and other display parameters
@@ -264,8 +256,15 @@ namespace Ep128Emu {
      */
     virtual void vsyncStateChange(bool newState, unsigned int currentSlot_);
     /*!
-     * Read and process messages sent by the child thread. Returns true if
-     * redraw() needs to be called to update the display.
+     * Save or restore the line and vertical sync counters, so that frames
+     * end at the same emulated time after restoring a checkpoint.
+     */
+    void saveState(Ep128Emu::File::Buffer& buf);
+    void loadState(Ep128Emu::File::Buffer& buf);
+    /*!
+     * Collect the lines of the last field completed by the emulation
+     * thread. Returns true if redraw() needs to be called to update the
+     * display.
      */
     virtual bool checkEvents();
     /*!
@@ -275,9 +274,33 @@ namespace Ep128Emu {
     virtual void limitFrameRate(bool isEnabled);
     virtual void draw(void* fb, bool scanForBorder);
     void wakeDisplay(bool syncRequired);
+    /*!
+     * If enabled, completed frames are not converted to the frame buffer.
+     * Line data is still collected, and the lines changed meanwhile are
+     * drawn with the next frame after disabling.
+     */
+    void setSkipDraw(bool isEnabled);
+    /*!
+     * If enabled, frames are drawn at the native horizontal resolution of
+     * most video modes (384 pixels), and full resolution (768 pixels) is
+     * only used while any line of the frame contains hi-res data.
+     */
+    void setNativeResolution(bool isEnabled);
     void resetViewport(void);
     bool setViewport(int x1, int y1, int x2, int y2);
     bool isViewportDefault(void);
+    /*!
+     * Decode a line of video data in the format described at drawLine()
+     * to 768 pixels in the frame buffer format.
+     */
+    void decodeLine(pixel_t *outBuf,
+                    const unsigned char *inBuf, size_t nBytes);
+    /*!
+     * Returns the video data of the currently displayed line 'n' (0 to 577)
+     * in 'buf' and 'nBytes', for use by the benchmark driver. 'nBytes' is
+     * zero if the line is empty.
+     */
+    void getLineData(int n, const unsigned char*& buf, size_t& nBytes) const;
 
   };
 
@@ -29,117 +29,84 @@ sound.swPeriods	16
 #include "ep128emu.hpp"
 #include "system.hpp"
 #include "libretrosnd.hpp"
-#include <vector>
+
+// ring buffer size in stereo frames, must be a power of two
+// (about 1.5 seconds at 44100 Hz)
+#define LIBRETRO_RING_BUFFER_FRAMES 65536
 
 namespace Ep128Emu {
 
-#define LIBRETRO_PERIOD_SIZE 16
   AudioOutput_libretro::AudioOutput_libretro()
     : AudioOutput(),
-      writeBufIndex(0),
-      readBufIndex(0),
-      readSubBufIndex(0)
+      ringBuffer((int16_t *) 0),
+      ringBufferAlloc((int16_t *) 0),
+      ringBufferFrames(LIBRETRO_RING_BUFFER_FRAMES),
+      writePos(0),
+      readPos(0)
   {
-    // initialize buffers
-    int nPeriodsSW_ = 44100;
-    int periodSize = LIBRETRO_PERIOD_SIZE;
-    buffers.resize(size_t(nPeriodsSW_));
-    for (int i = 0; i < nPeriodsSW_; i++)
-    {
-      buffers[i].audioData.resize(size_t(periodSize) << 1);
-      for (int j = 0; j < (periodSize << 1); j++)
-        buffers[i].audioData[j] = 0;
-    }
+    // allocate 64 bytes (32 samples) more, and align the start of the buffer
+    ringBufferAlloc = new int16_t[(ringBufferFrames << 1) + 32];
+    ringBuffer = ringBufferAlloc
+                 + (((64 - (size_t(ringBufferAlloc) & 63)) & 63) >> 1);
+    std::memset(ringBuffer, 0, (ringBufferFrames << 1) * sizeof(int16_t));
   }
 
   AudioOutput_libretro::~AudioOutput_libretro()
   {
-    writeBufIndex = 0;
-    readBufIndex = 0;
-    readSubBufIndex = 0;
-    buffers.clear();
+    delete[] ringBufferAlloc;
+    ringBufferAlloc = (int16_t *) 0;
+    ringBuffer = (int16_t *) 0;
   }
 
   void AudioOutput_libretro::sendAudioData(const int16_t *buf, size_t nFrames)
   {
-    for (size_t i = 0; i < nFrames; i++)
+    size_t  writePos_ = writePos.load(std::memory_order_relaxed);
+    size_t  readPos_ = readPos.load(std::memory_order_acquire);
+    size_t  freeFrames = ringBufferFrames - (writePos_ - readPos_);
+    // if the frontend does not keep up, the frames that do not fit are lost
+    size_t  framesToWrite = (nFrames < freeFrames ? nFrames : freeFrames);
+    size_t  offs = writePos_ & (ringBufferFrames - 1);
+    size_t  n1 = ringBufferFrames - offs;
+    n1 = (framesToWrite < n1 ? framesToWrite : n1);
+    std::memcpy(&(ringBuffer[offs << 1]), buf, (n1 << 1) * sizeof(int16_t));
+    if (framesToWrite > n1)
     {
-      Buffer& buf_ = buffers[writeBufIndex];
-      buf_.audioData[buf_.writePos++] = buf[(i << 1) + 0];
-      buf_.audioData[buf_.writePos++] = buf[(i << 1) + 1];
-      if (buf_.writePos >= buf_.audioData.size())
-      {
-        buf_.writePos = 0;
-        //buf_.lrLock.notify();
-        forwardMutex.lock();
-        if (++writeBufIndex >= buffers.size())
-          writeBufIndex = 0;
-        forwardMutex.unlock();
-      }
+      std::memcpy(&(ringBuffer[0]), &(buf[n1 << 1]),
+                  ((framesToWrite - n1) << 1) * sizeof(int16_t));
     }
+    writePos.store(writePos_ + framesToWrite, std::memory_order_release);
     // call base class to write sound file
     AudioOutput::sendAudioData(buf, nFrames);
   }
 
   void AudioOutput_libretro::forwardAudioData(int16_t *buf_out, size_t* nFrames, int expectedFrames)
   {
-    //printf("Trying forwardAudioData: %d %d\n",readBufIndex,writeBufIndex);
-
-    int currOutputIndex = -1;
     int expectedLatencyFrames = 800;
-    size_t ringBufferSize = buffers.size();
-    int partialFrames_pre = LIBRETRO_PERIOD_SIZE - readSubBufIndex;
-
-    forwardMutex.lock();
-    size_t writeBufIndex_ = writeBufIndex;
-    int partialFrames_post = buffers[writeBufIndex_].writePos;
-    forwardMutex.unlock();
-
-    signed int availableBuffers = 0;
-    if(readBufIndex<writeBufIndex_)
-    {
-      availableBuffers = writeBufIndex_ - readBufIndex - 1;
-    }
-    else if (readBufIndex > writeBufIndex_)
-    {
-      availableBuffers = writeBufIndex_ + (ringBufferSize - readBufIndex) -1;
-    }
-    else
-    {
-      availableBuffers = 0;
-      // if no full buffer available, discard the partial frame as well
-      partialFrames_post = 0;
-      partialFrames_pre = 0;
-    }
-    // do not care about partial frames in the buffer being written
-    int availableFrames = partialFrames_pre + availableBuffers * LIBRETRO_PERIOD_SIZE + partialFrames_post;
+    size_t  readPos_ = readPos.load(std::memory_order_relaxed);
+    size_t  writePos_ = writePos.load(std::memory_order_acquire);
+    int availableFrames = int(writePos_ - readPos_);
 
     signed int framesToSend = 0;
     // slowly try to pull frames towards the expected amount
     framesToSend = expectedFrames + (availableFrames - expectedFrames - expectedLatencyFrames)/100;
     if (framesToSend > availableFrames) {
       framesToSend = availableFrames;
-      //printf("Audio buffer underrun: rd %d wr %d av %d exp %d fts %d\n",readBufIndex,writeBufIndex_, availableFrames, expectedFrames, framesToSend);
+      //printf("Audio buffer underrun: av %d exp %d fts %d\n", availableFrames, expectedFrames, framesToSend);
     }
-    //printf("Trying forwardAudioData: rd %d wr %d av %d exp %d fts %d\n",readBufIndex,writeBufIndex_, availableFrames, expectedFrames, framesToSend);
-
-    for (signed int i=0; i<framesToSend; i++)
+    if (framesToSend < 0)
+      framesToSend = 0;
+
+    size_t  offs = readPos_ & (ringBufferFrames - 1);
+    size_t  n1 = ringBufferFrames - offs;
+    n1 = (size_t(framesToSend) < n1 ? size_t(framesToSend) : n1);
+    std::memcpy(buf_out, &(ringBuffer[offs << 1]), (n1 << 1) * sizeof(int16_t));
+    if (size_t(framesToSend) > n1)
     {
-      Buffer& buf_ = buffers[readBufIndex];
-      currOutputIndex++;
-      buf_out[(currOutputIndex << 1) + 0] = buf_.audioData[(readSubBufIndex << 1) + 0];
-      buf_out[(currOutputIndex << 1) + 1] = buf_.audioData[(readSubBufIndex << 1) + 1];
-      readSubBufIndex++;
-      if (readSubBufIndex>=LIBRETRO_PERIOD_SIZE)
-      {
-        readSubBufIndex = 0;
-        readBufIndex++;
-        if (readBufIndex >= ringBufferSize) readBufIndex = 0;
-      }
+      std::memcpy(&(buf_out[n1 << 1]), &(ringBuffer[0]),
+                  ((size_t(framesToSend) - n1) << 1) * sizeof(int16_t));
     }
-
-    //printf("Returned frames: %d\n",currOutputIndex);
-    nFrames[0]=currOutputIndex+1;
+    readPos.store(readPos_ + size_t(framesToSend), std::memory_order_release);
+    nFrames[0] = size_t(framesToSend);
   }
 
   void AudioOutput_libretro::closeDevice()
@@ -23,30 +23,27 @@
 #include "ep128emu.hpp"
 #include "system.hpp"
 #include "soundio.hpp"
-#include <vector>
+#include <atomic>
 
 namespace Ep128Emu {
 
 class AudioOutput_libretro : public AudioOutput {
    private:
-    struct Buffer {
-      std::vector< int16_t >    audioData;
-      ThreadLock  lrLock;
-      ThreadLock  epLock;
-      size_t      writePos;
-      Buffer()
-        : lrLock(true), epLock(true), writePos(0)
-      {
-      }
-      ~Buffer()
-      {
-      }
-    };
-    std::vector< Buffer >   buffers;
-    size_t        writeBufIndex;
-    size_t        readBufIndex;
-    size_t        readSubBufIndex;
-    Mutex         forwardMutex;
+    // Single producer (emulation thread, sendAudioData()) / single consumer
+    // (frontend thread, forwardAudioData()) ring buffer of stereo frames.
+    // The positions are free running frame counters, the buffer index is
+    // calculated by masking with (ringBufferFrames - 1).
+    // The positions are padded to separate cache lines, so that updating
+    // one of them does not invalidate the other in the cache of the other
+    // thread (the object itself may not be 64 byte aligned).
+    int16_t       *ringBuffer;          // aligned to 64 bytes
+    int16_t       *ringBufferAlloc;
+    size_t        ringBufferFrames;
+    char          padding0_[64];
+    std::atomic< size_t >   writePos;
+    char          padding1_[64];
+    std::atomic< size_t >   readPos;
+    char          padding2_[64];
 
    public:
     AudioOutput_libretro();
@@ -79,6 +79,7 @@ led driver for tape loading - see comments inside
 #include "libretro-funcs.hpp"
 #include "libretrodisp.hpp"
 #include "core.hpp"
+#include "profiler.hpp"
 #include "libretro_core_options.h"
 #ifdef WIN32
 #include <windows.h>
@@ -101,13 +102,23 @@ std::string contentFileName="";
 
 retro_usec_t curr_frame_time = 0;
 retro_usec_t prev_frame_time = 0;
-float waitPeriod = 0.001;
 bool useSwFb = false;
 bool useHalfFrame = false;
+bool singleThreaded = false;
 int borderSize = 0;
+bool nativeResolution = false;
 bool soundHq = true;
 bool canSkipFrames = false;
+bool canDupeFrames = false;
 bool enhancedRom = false;
+bool warpAutostart = false;
+bool tapeWarp = false;
+bool diskOverlay = false;
+#ifdef EP128EMU_ENABLE_PROFILING
+bool profilingLog = false;
+unsigned profilingFrameCnt = 0;
+Ep128Emu::ProfilerStatus profilingPrvStatus;
+#endif // EP128EMU_ENABLE_PROFILING
 
 unsigned maxUsers;
 bool maxUsersSupported = true;
@@ -128,6 +139,11 @@ Ep128Emu::VMThread              *vmThread    = (Ep128Emu::VMThread *) 0;
 Ep128Emu::EmulatorConfiguration *config      = (Ep128Emu::EmulatorConfiguration *) 0;
 Ep128Emu::LibretroCore          *core        = (Ep128Emu::LibretroCore *) 0;
 
+// fast savestates (used by run-ahead) store a VM checkpoint after this header
+static const unsigned char checkpointMagic[8] = { 'E', 'P', '1', '2', '8', 'C', 'K', 'P' };
+static Ep128Emu::File::Buffer   checkpointBuffer;
+static Ep128Emu::File::Buffer   autostartBuffer;
+
 static retro_video_refresh_t video_cb;
 static retro_audio_sample_t audio_cb;
 static retro_audio_sample_batch_t audio_batch_cb;
@@ -205,22 +221,20 @@ static void update_keyboard_cb(bool down, unsigned keycode,
                                uint32_t character, uint16_t key_modifiers)
 {
   if(keycode != RETROK_UNKNOWN && core)
+  {
+    if(down)
+      core->stop_warp();
     core->update_keyboard(down,keycode,character,key_modifiers);
+  }
 }
 
 static void check_variables(void)
 {
   struct retro_variable var =
   {
-    .key = "ep128emu_wait",
+    .key = "ep128emu_swfb",
   };
   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
-  {
-    waitPeriod = 0.001f * std::atoi(var.value);
-  }
-
-  var.key = "ep128emu_swfb";
-  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
   {
     useSwFb = std::atoi(var.value) == 1 ? true : false;
   }
@@ -242,12 +256,57 @@ static void check_variables(void)
     }
   }
 
+  var.key = "ep128emu_tapetraps";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    bool tapeTraps_;
+    tapeTraps_ = std::atoi(var.value) == 1 ? true : false;
+    if (core && core->config->tape.loaderTraps != tapeTraps_)
+    {
+      core->config->tape.loaderTraps = tapeTraps_;
+      core->config->tapeSettingsChanged = true;
+      core->config->applySettings();
+    }
+  }
+
+  var.key = "ep128emu_cow";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    diskOverlay = std::atoi(var.value) == 1 ? true : false;
+    std::string overlayDirectory_(diskOverlay ? retro_system_save_directory : "");
+    if (core && core->config->floppy.overlayDirectory != overlayDirectory_)
+    {
+      core->config->floppy.overlayDirectory = overlayDirectory_;
+      core->config->diskOverlaySettingsChanged = true;
+      core->config->applySettings();
+    }
+  }
+
+  var.key = "ep128emu_fdcturbo";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    bool floppyTurbo_;
+    floppyTurbo_ = std::atoi(var.value) == 1 ? true : false;
+    if (core && core->config->floppy.turboMode != floppyTurbo_)
+    {
+      core->config->floppy.turboMode = floppyTurbo_;
+      core->config->floppyTurboModeChanged = true;
+      core->config->applySettings();
+    }
+  }
+
   var.key = "ep128emu_useh";
   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
   {
     useHalfFrame = std::atoi(var.value) == 1 ? true : false;
   }
 
+  var.key = "ep128emu_sync";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    singleThreaded = std::atoi(var.value) == 1 ? true : false;
+  }
+
   var.key = "ep128emu_brds";
   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
   {
@@ -256,6 +315,14 @@ static void check_variables(void)
       core->borderSize = borderSize*2;
   }
 
+  var.key = "ep128emu_nres";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    nativeResolution = std::atoi(var.value) == 1 ? true : false;
+    if(core)
+      core->w->setNativeResolution(nativeResolution);
+  }
+
   var.key = "ep128emu_romv";
   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
   {
@@ -263,6 +330,30 @@ static void check_variables(void)
     else { enhancedRom = false;}
   }
 
+  var.key = "ep128emu_warp";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    warpAutostart = std::atoi(var.value) == 1 ? true : false;
+    if(core && !warpAutostart)
+      core->stop_warp();
+  }
+
+  var.key = "ep128emu_tapewarp";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    tapeWarp = std::atoi(var.value) == 1 ? true : false;
+    if(core)
+      core->tapeWarpEnabled = tapeWarp;
+  }
+
+#ifdef EP128EMU_ENABLE_PROFILING
+  var.key = "ep128emu_prof";
+  if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+  {
+    profilingLog = std::atoi(var.value) == 1 ? true : false;
+  }
+#endif // EP128EMU_ENABLE_PROFILING
+
   std::string zoomKey;
   var.key = "ep128emu_zoom";
   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
@@ -598,16 +689,17 @@ void retro_init(void)
   struct retro_frame_time_callback ftcb = { set_frame_time_cb };
   environ_cb(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &ftcb);
 
-  environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE,&canSkipFrames);
+  environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE,&canDupeFrames);
   //environ_cb(RETRO_ENVIRONMENT_GET_OVERSCAN,&showan);
-  // safe mode
+  // safe mode: frames are only duplicated if the display content is unchanged
   canSkipFrames = false;
   check_variables();
 #ifdef WIN32
   timeBeginPeriod(1U);
 #endif
   log_cb(RETRO_LOG_DEBUG, "Creating core...\n");
-  core = new Ep128Emu::LibretroCore(log_cb, Ep128Emu::VM_config.at("EP128_DISK"), Ep128Emu::LOCALE_UK, canSkipFrames, retro_system_bios_directory, retro_system_save_directory,"","",useHalfFrame, enhancedRom);
+  core = new Ep128Emu::LibretroCore(log_cb, Ep128Emu::VM_config.at("EP128_DISK"), Ep128Emu::LOCALE_UK, canSkipFrames, retro_system_bios_directory, retro_system_save_directory,"","",useHalfFrame, enhancedRom, singleThreaded);
+  core->canDupeFrames = canDupeFrames;
   config = core->config;
   config->setErrorCallback(&cfgErrorFunc, (void *) 0);
   vmThread = core->vmThread;
@@ -634,7 +726,7 @@ void retro_init(void)
   check_variables();
   log_cb(RETRO_LOG_DEBUG, "Starting core...\n");
   core->start();
-  core->change_resolution(core->currWidth,core->currHeight,environ_cb);
+  core->change_resolution(core->currViewWidth,core->currHeight,environ_cb);
 }
 
 void retro_deinit(void)
@@ -696,12 +788,18 @@ void retro_set_environment(retro_environment_t cb)
 
 /*  static const struct retro_variable vars[] =
   {
-    { "ep128emu_wait", "Main thread wait (ms); 0|1|5|10" },
     { "ep128emu_sdhq", "High sound quality; 1|0" },
     { "ep128emu_swfb", "Use accelerated SW framebuffer; 0|1" },
     { "ep128emu_useh", "Enable resolution changes (requires restart); 1|0" },
+    { "ep128emu_sync", "Single-threaded emulation (requires restart); 0|1" },
     { "ep128emu_brds", "Border lines to keep when zooming in; 0|2|4|8|10|20" },
+    { "ep128emu_nres", "Native horizontal resolution; 0|1" },
     { "ep128emu_romv", "System ROM version (EP only); Original|Enhanced" },
+    { "ep128emu_warp", "Warp speed autostart; 0|1" },
+    { "ep128emu_tapewarp", "Warp speed tape loading; 0|1" },
+    { "ep128emu_tapetraps", "Fast tape loading; 0|1" },
+    { "ep128emu_cow", "Keep disk images unmodified; 0|1" },
+    { "ep128emu_fdcturbo", "Fast floppy disk access (CPC); 0|1" },
     { "ep128emu_zoom", "User 1 Zoom button; R3|Start|Select|X|Y|A|B|L|R|L2|R2|L3" },
     { "ep128emu_info", "User 1 Info button; L3|R3|Start|Select|X|Y|A|B|L|R|L2|R2" },
     { "ep128emu_afbt", "User 1 Autofire for button; None|X|Y|A|B|L|R|L2|R2|L3|R3|Start|Select" },
@@ -749,6 +847,20 @@ static void update_input(void)
   core->update_input(input_state_cb, environ_cb, maxUsers);
 }
 
+// bit 0: video enabled, bit 1: audio enabled, bit 2: fast savestates
+static int get_av_enable(void)
+{
+  int avEnable = 0;
+  if (environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &avEnable))
+    return avEnable;
+  return 3;
+}
+
+static bool use_fast_savestates(void)
+{
+  return (get_av_enable() & 4) != 0;
+}
+
 static void render(void)
 {
   core->render(video_cb, environ_cb);
@@ -760,6 +872,28 @@ static void audio_callback(void)
     audio_cb(0, 0);
 }
 */
+#ifdef EP128EMU_ENABLE_PROFILING
+// log time spent in the instrumented functions once per second
+static void log_profiling_summary(void)
+{
+  if (++profilingFrameCnt < 50)
+    return;
+  profilingFrameCnt = 0;
+  Ep128Emu::ProfilerStatus status;
+  char buf[512];
+  size_t len = 0;
+  for (int i = 0; i < int(Ep128Emu::PROFILER_COUNTER_CNT) && len < sizeof(buf); i++)
+  {
+    len += snprintf(&(buf[len]), sizeof(buf) - len, " %s: %.2f ms (%lu)",
+                    Ep128Emu::ProfilerStatus::getCounterName(i),
+                    (status.seconds[i] - profilingPrvStatus.seconds[i]) * 1000.0,
+                    (unsigned long) (status.calls[i] - profilingPrvStatus.calls[i]));
+  }
+  profilingPrvStatus = status;
+  log_cb(RETRO_LOG_INFO, "Profiling, last 50 frames:%s\n", buf);
+}
+#endif // EP128EMU_ENABLE_PROFILING
+
 static void audio_callback_batch(void)
 {
   size_t nFrames=0;
@@ -795,11 +929,30 @@ void retro_run(void)
       buf = fb.data;
     }
   }
+  // skip generating video or audio that the frontend would discard
+  // (run-ahead and fast-forward frames)
+  int avEnable = get_av_enable();
   update_input();
-  core->run_for(curr_frame_time,waitPeriod,buf);
-  audio_callback_batch();
+  // the warp states are checked on every frame, but additional frames are
+  // only run on frames that are shown, and not while fast savestates are
+  // used by run-ahead or netplay
+  core->update_warp_state();
+  core->update_tape_warp_state();
+  if ((avEnable & 5) == 1)
+    core->run_warp(curr_frame_time, environ_cb);
+  // audio stays muted until the autostart or tape warp is over
+  core->set_av_enable((avEnable & 1) != 0, (avEnable & 2) != 0 && !(avEnable & 8) &&
+                      !core->warpActive && !core->tapeWarpActive);
+  core->run_for(curr_frame_time,buf);
+  if (core->audioEnabled)
+    audio_callback_batch();
   core->sync_display();
-  render();
+  if (core->videoEnabled)
+    render();
+#ifdef EP128EMU_ENABLE_PROFILING
+  if (profilingLog)
+    log_profiling_summary();
+#endif // EP128EMU_ENABLE_PROFILING
    /* LED interface */
    if (led_state_cb)
       update_led_interface();
@@ -1069,8 +1222,9 @@ bool retro_load_game(const struct retro_game_info *info)
       check_variables();
       core = new Ep128Emu::LibretroCore(log_cb, detectedMachineDetailedType, contentLocale, canSkipFrames,
                                         retro_system_bios_directory, retro_system_save_directory,
-                                        startupSequence,configFile.c_str(),useHalfFrame, enhancedRom);
+                                        startupSequence,configFile.c_str(),useHalfFrame, enhancedRom, singleThreaded);
       log_cb(RETRO_LOG_DEBUG, "Core created\n");
+      core->canDupeFrames = canDupeFrames;
       config = core->config;
       check_variables();
       if (diskContent)
@@ -1117,6 +1271,7 @@ bool retro_load_game(const struct retro_game_info *info)
           core->vm->tapePlay();
         }
       }
+      core->warpActive = warpAutostart && !core->startSequence.empty();
     }
     catch (...)
     {
@@ -1190,17 +1345,53 @@ size_t retro_serialize_size(void)
     return EP128EMU_SNAPSHOT_SIZE;
 }
 
+
 bool retro_serialize(void *data_, size_t size)
 {
+  EP128EMU_PROFILE_SCOPE(PROFILER_SERIALIZE);
   if (size < retro_serialize_size())
     return false;
 
-  memset( data_, 0x00,size);
-
-  Ep128Emu::File  f;
-  core->vm->saveState(f);
-  f.writeMem(data_, size);
+  if (use_fast_savestates())
+  {
+    try
+    {
+      core->vm->saveCheckpoint(checkpointBuffer);
+      core->save_autostart_state(autostartBuffer);
+      uint32_t checkpointSize = (uint32_t) checkpointBuffer.getDataSize();
+      uint32_t autostartSize = (uint32_t) autostartBuffer.getDataSize();
+      if (16 + (size_t) checkpointSize + (size_t) autostartSize <= size)
+      {
+        unsigned char *buf = (unsigned char *)data_;
+        memcpy(buf, checkpointMagic, 8);
+        memcpy(buf + 8, &checkpointSize, 4);
+        memcpy(buf + 12, &autostartSize, 4);
+        memcpy(buf + 16, checkpointBuffer.getData(), checkpointSize);
+        memcpy(buf + 16 + checkpointSize, autostartBuffer.getData(), autostartSize);
+        return true;
+      }
+    }
+    catch (...)
+    {
+      // fall back to a normal snapshot
+    }
+  }
 
+  try
+  {
+    Ep128Emu::File  f;
+    core->vm->saveState(f);
+    // magic header + chunks + end-of-file chunk, only clear the unused tail
+    size_t  usedSize = 16 + f.getBufferDataSize() + 12;
+    f.writeMem(data_, size);
+    if (usedSize < size)
+      memset((unsigned char *)data_ + usedSize, 0x00, size - usedSize);
+  }
+  catch (...)
+  {
+    log_cb(RETRO_LOG_ERROR, "Exception in serialize\n");
+    return false;
+  }
   return true;
 }
 
@@ -1211,21 +1402,78 @@ bool retro_unserialize(const void *data_, size_t size)
 
   unsigned char *buf= (unsigned char*)data_;
 
-  // workaround: find last non-zero byte - which will be crc32 of the end-of-file chunk type, 6A 50 08 5E, so essentially the end of content
-  size_t lastNonZeroByte = size-1;
-  for (size_t i=size-1; i>0; i--)
+  if (memcmp(buf, checkpointMagic, 8) == 0)
+  {
+    uint32_t checkpointSize;
+    uint32_t autostartSize;
+    memcpy(&checkpointSize, buf + 8, 4);
+    memcpy(&autostartSize, buf + 12, 4);
+    if (16 + (size_t) checkpointSize + (size_t) autostartSize > size)
+      return false;
+    try
+    {
+      checkpointBuffer.truncate();
+      checkpointBuffer.writeData(buf + 16, checkpointSize);
+      core->vm->restoreCheckpoint(checkpointBuffer);
+      autostartBuffer.truncate();
+      autostartBuffer.writeData(buf + 16 + checkpointSize, autostartSize);
+      core->load_autostart_state(autostartBuffer);
+    }
+    catch (...)
+    {
+      log_cb(RETRO_LOG_ERROR, "Exception in unserialize\n");
+      return false;
+    }
+    return true;
+  }
+
+  // find the end of content by walking the chunk headers (type, length,
+  // data, crc32) up to the end-of-file chunk (type 0)
+  size_t contentSize = 0;
+  size_t pos = 16;
+  while (pos + 12 <= size)
   {
-    if(buf[i] != 0)
+    uint32_t chunkType = ((uint32_t)buf[pos] << 24) | ((uint32_t)buf[pos+1] << 16) |
+                         ((uint32_t)buf[pos+2] << 8) | (uint32_t)buf[pos+3];
+    uint32_t chunkLen  = ((uint32_t)buf[pos+4] << 24) | ((uint32_t)buf[pos+5] << 16) |
+                         ((uint32_t)buf[pos+6] << 8) | (uint32_t)buf[pos+7];
+    if (chunkType == 0)
     {
-      lastNonZeroByte = i;
+      contentSize = pos + 12;
+      break;
+    }
+    if ((size_t)chunkLen > size - pos - 12)
       break;
+    pos += 12 + (size_t)chunkLen;
+  }
+  if (contentSize == 0)
+  {
+    // fallback: find last non-zero byte - which will be crc32 of the end-of-file chunk type, 6A 50 08 5E, so essentially the end of content
+    contentSize = size;
+    for (size_t i=size-1; i>0; i--)
+    {
+      if(buf[i] != 0)
+      {
+        contentSize = i+1;
+        break;
+      }
     }
   }
-  Ep128Emu::File  f((unsigned char *)data_,lastNonZeroByte+1);
-  core->vm->registerChunkTypes(f);
-  f.processAllChunks();
-  core->config->applySettings();
+  try
+  {
+    Ep128Emu::File  f((unsigned char *)data_,contentSize);
+    core->vm->registerChunkTypes(f);
+    f.processAllChunks();
+    core->config->applySettings();
+  }
+  catch (...)
+  {
+    log_cb(RETRO_LOG_ERROR, "Exception in unserialize\n");
+    return false;
+  }
   core->startSequenceIndex = core->startSequence.length();
+  core->stop_warp();
+  core->stop_tape_warp();
   if(vmThread) vmThread->resetKeyboard();
 
   // todo: restore filenamecallback if file is used?
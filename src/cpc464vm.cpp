@@ -32,6 +32,7 @@
 #include "videorec.hpp"
 #include "fdc765.hpp"
 #include "cpcdisk.hpp"
+#include "profiler.hpp"
 #include "roms/roms.hpp"
 
 #include <vector>
@@ -106,12 +107,9 @@ namespace CPC464 {
 
   EP128EMU_REGPARM1 void CPC464VM::runOneCycle()
   {
-    CPC464VMCallback *p = firstCallback;
-    while (p) {
-      CPC464VMCallback *nxt = p->nxt;
-      p->func(p->userData);
-      p = nxt;
-    }
+    if (EP128EMU_UNLIKELY(callbackTime >= nextCallbackTime))
+      runCallbacks();
+    callbackTime++;
     if (--ayCycleCnt == 0) {
       ayCycleCnt = 8;
       if (--floppyCycleCnt == 0) {
@@ -178,6 +176,10 @@ namespace CPC464 {
   {
     uint16_t  addr = uint16_t(R.PC.W.l);
     vm.memoryWaitM1();
+    if (EP128EMU_UNLIKELY(addr == vm.casReadAddr)) {
+      loadTapeBlock();
+      addr = uint16_t(R.PC.W.l);
+    }
     if (!vm.singleStepMode) {
       uint8_t   retval = vm.memory.readOpcode(addr);
       vm.updateCPUHalfCycles(4);
@@ -189,6 +191,57 @@ namespace CPC464 {
     return retval;
   }
 
+  uint32_t CPC464VM::getCASReadAddress() const
+  {
+    // the CAS READ jumpblock entry is RST 08H (LOW JUMP) followed by the
+    // address of the routine in the lower ROM; bit 14 is set if the lower
+    // ROM is disabled, and bit 15 if the upper ROM is disabled
+    if (memory.readNoDebug(0xBCA1) != 0xCF)
+      return 0xFFFFFFFFU;
+    uint16_t  addr = uint16_t(memory.readNoDebug(0xBCA2))
+                     | (uint16_t(memory.readNoDebug(0xBCA3)) << 8);
+    if (addr & 0x4000)
+      return 0xFFFFFFFFU;
+    return uint32_t(addr & 0x3FFF);
+  }
+
+  void CPC464VM::Z80_::loadTapeBlock()
+  {
+    // firmware routine called by CAS READ, which is also used by the
+    // cassette manager (CAS IN CHAR etc.) to read the header and data
+    // records: if loader traps are enabled, copy the next record with sync
+    // byte A from the tape to DE bytes at HL, and return with carry set and
+    // zero flag clear
+    if (vm.isRecordingDemo | vm.isPlayingDemo)
+      return;
+    if (vm.memory.getPage(0) != 0x80 || !vm.memory.isSegmentROM(0x80) ||
+        uint32_t(R.PC.W.l) != vm.getCASReadAddress()) {
+      return;                           // not the lower ROM routine
+    }
+    std::vector< uint8_t >  buf;
+    do {
+      if (!vm.readTapeDataBlock(buf))
+        return;
+    } while (buf.size() < 1 || buf[0] != R.AF.B.h);
+    size_t  nBytes = size_t(R.DE.W != 0 ? R.DE.W : 0x10000);
+    // the data is stored in segments of 256 bytes, followed by a 16-bit CRC
+    if (buf.size() < (1 + ((nBytes + 255) >> 8) * 258)) {
+      R.AF.B.h = 0x02;                  // error: record too short
+      R.AF.B.l = R.AF.B.l & 0xBE;
+    }
+    else {
+      for (size_t i = 0; i < nBytes; i++) {
+        vm.memory.write(uint16_t((R.HL.W + i) & 0xFFFF),
+                        buf[1 + ((i >> 8) * 258) + (i & 0xFF)]);
+      }
+      R.AF.B.l = (R.AF.B.l & 0xBE) | 0x01;
+    }
+    // RET
+    R.PC.W.l = uint16_t(vm.memory.readNoDebug(R.SP.W))
+               | (uint16_t(vm.memory.readNoDebug((R.SP.W + 1) & 0xFFFF)) << 8);
+    R.SP.W = (R.SP.W + 2) & 0xFFFF;
+  }
+
   EP128EMU_REGPARM2 uint8_t CPC464VM::Z80_::readOpcodeSecondByte(
       const bool *invalidOpcodeTable)
   {
@@ -759,7 +812,7 @@ namespace CPC464 {
     vm.videoRenderer.crtcVSyncStateChange(newState);
   }
 
-  void CPC464VM::tapeCallback(void *userData)
+  uint32_t CPC464VM::tapeCallback(void *userData)
   {
     CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
     vm.tapeSamplesRemaining += vm.tapeSamplesPerCRTCCycle;
@@ -772,9 +825,17 @@ namespace CPC464 {
       if (vm.tapeInputSignal != prvTapeInput)
         vm.updatePPIState();
     }
+    // skip the cycles until the next tape sample is due
+    if (vm.tapeSamplesPerCRTCCycle < 1)
+      return 1U;
+    int64_t n = (-vm.tapeSamplesRemaining - 1) / vm.tapeSamplesPerCRTCCycle;
+    if (n < 1)
+      return 1U;
+    vm.tapeSamplesRemaining += (n * vm.tapeSamplesPerCRTCCycle);
+    return uint32_t(n + 1);
   }
 
-  void CPC464VM::demoPlayCallback(void *userData)
+  uint32_t CPC464VM::demoPlayCallback(void *userData)
   {
     CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
     while (!vm.demoTimeCnt) {
@@ -818,18 +879,21 @@ namespace CPC464 {
     }
     if (vm.demoTimeCnt)
       vm.demoTimeCnt--;
+    return 1U;
   }
 
-  void CPC464VM::demoRecordCallback(void *userData)
+  uint32_t CPC464VM::demoRecordCallback(void *userData)
   {
     CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
     vm.demoTimeCnt++;
+    return 1U;
   }
 
-  void CPC464VM::videoCaptureCallback(void *userData)
+  uint32_t CPC464VM::videoCaptureCallback(void *userData)
   {
     CPC464VM& vm = *(reinterpret_cast<CPC464VM *>(userData));
     vm.videoCapture->runOneCycle(vm.soundOutputSignal);
+    return 1U;
   }
 
   uint8_t CPC464VM::checkSingleStepModeBreak()
@@ -926,7 +990,7 @@ namespace CPC464 {
     updatePPIState();
   }
 
-  void CPC464VM::setCallback(void (*func)(void *userData), void *userData_,
+  void CPC464VM::setCallback(uint32_t (*func)(void *userData), void *userData_,
                              bool isEnabled)
   {
     if (!func)
@@ -954,7 +1018,7 @@ namespace CPC464 {
         p = p->nxt;
       }
       if (!isEnabled) {
-        callbacks[ndx].func = (void (*)(void *)) 0;
+        callbacks[ndx].func = (uint32_t (*)(void *)) 0;
         callbacks[ndx].userData = (void *) 0;
         callbacks[ndx].nxt = (CPC464VMCallback *) 0;
       }
@@ -963,7 +1027,7 @@ namespace CPC464 {
       return;
     if (ndx < 0) {
       for (size_t i = 0; i < maxCallbacks; i++) {
-        if (callbacks[i].func == (void (*)(void *)) 0) {
+        if (callbacks[i].func == (uint32_t (*)(void *)) 0) {
           ndx = int(i);
           break;
         }
@@ -974,6 +1038,9 @@ namespace CPC464 {
     callbacks[ndx].func = func;
     callbacks[ndx].userData = userData_;
     callbacks[ndx].nxt = (CPC464VMCallback *) 0;
+    callbacks[ndx].nextTime = callbackTime;
+    if (callbackTime < nextCallbackTime)
+      nextCallbackTime = callbackTime;
     if (isEnabled) {
       CPC464VMCallback   *prv = (CPC464VMCallback *) 0;
       CPC464VMCallback   *p = firstCallback;
@@ -989,6 +1056,25 @@ namespace CPC464 {
     }
   }
 
+  EP128EMU_REGPARM1 void CPC464VM::runCallbacks()
+  {
+    uint64_t  t = callbackTime;
+    uint64_t  nextTime = ~(uint64_t(0));
+    nextCallbackTime = nextTime;
+    CPC464VMCallback *p = firstCallback;
+    while (p) {
+      CPC464VMCallback *nxt = p->nxt;
+      if (p->nextTime <= t)
+        p->nextTime = t + p->func(p->userData);
+      if (p->nextTime < nextTime)
+        nextTime = p->nextTime;
+      p = nxt;
+    }
+    // setCallback() may have also changed nextCallbackTime
+    if (nextTime < nextCallbackTime)
+      nextCallbackTime = nextTime;
+  }
+
   // --------------------------------------------------------------------------
 
   CPC464VM::CPC464VM(Ep128Emu::VideoDisplay& display_,
@@ -1021,6 +1107,7 @@ namespace CPC464 {
       singleStepModeNextAddr(int32_t(-1)),
       tapeCallbackFlag(false),
       prvTapeCallbackFlag(false),
+      casReadAddr(0xFFFFFFFFU),
       soundOutputSignal(0U),
       demoFile((Ep128Emu::File *) 0),
       demoBuffer(),
@@ -1032,6 +1119,8 @@ namespace CPC464 {
       floppyCycleCnt(1),
       breakPointPriorityThreshold(0),
       firstCallback((CPC464VMCallback *) 0),
+      callbackTime(0U),
+      nextCallbackTime(~(uint64_t(0))),
       videoCapture((Ep128Emu::VideoCapture *) 0),
       tapeSamplesPerCRTCCycle(0L),
       tapeSamplesRemaining(-1L),
@@ -1040,7 +1129,7 @@ namespace CPC464 {
     for (size_t i = 0;
          i < (sizeof(callbacks) / sizeof(CPC464VMCallback));
          i++) {
-      callbacks[i].func = (void (*)(void *)) 0;
+      callbacks[i].func = (uint32_t (*)(void *)) 0;
       callbacks[i].userData = (void *) 0;
       callbacks[i].nxt = (CPC464VMCallback *) 0;
     }
@@ -1082,6 +1171,7 @@ namespace CPC464 {
 
   void CPC464VM::run(size_t microseconds)
   {
+    EP128EMU_PROFILE_SCOPE(PROFILER_VM_RUN);
     Ep128Emu::VirtualMachine::run(microseconds);
     if (snapshotLoadFlag) {
       snapshotLoadFlag = false;
@@ -1103,6 +1193,10 @@ namespace CPC464 {
       }
       prvTapeCallbackFlag = newTapeCallbackFlag;
     }
+    // the firmware turns on the tape motor only after CAS READ is called,
+    // so the loader trap is armed while the tape is playing
+    casReadAddr = ((haveTape() && getTapeButtonState() != 0) ?
+                   getCASReadAddress() : 0xFFFFFFFFU);
     z80OpcodeHalfCycles = z80OpcodeHalfCycles & 0xFE;
     int64_t crtcCyclesRemaining =
         int64_t(crtcCyclesRemainingL) + (int64_t(crtcCyclesRemainingH) << 32)
@@ -1116,6 +1210,7 @@ namespace CPC464 {
       while (EP128EMU_UNLIKELY(z80OpcodeHalfCycles >= 8))
         runOneCycle();
     }
+    flushAudioOutput();
   }
 
   void CPC464VM::reset(bool isColdReset)
@@ -1239,6 +1334,7 @@ namespace CPC464 {
   void CPC464VM::getVMStatus(VMStatus& vmStatus_)
   {
     vmStatus_.tapeReadOnly = getIsTapeReadOnly();
+    vmStatus_.tapeMotorOn = (getIsTapeMotorOn() && getTapeButtonState() != 0);
     vmStatus_.tapePosition = getTapePosition();
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
@@ -1308,6 +1404,16 @@ namespace CPC464 {
       floppyDrive->openDiskImage(n, fileName_.c_str());
   }
 
+  void CPC464VM::setDiskOverlayDirectory(const std::string& dirName)
+  {
+    floppyDrive->setOverlayDirectory(dirName);
+  }
+
+  void CPC464VM::setFloppyTurboMode(bool isEnabled)
+  {
+    floppyDrive->setTurboMode(isEnabled);
+  }
+
   uint32_t CPC464VM::getFloppyDriveLEDState()
   {
     return floppyDrive->getLEDState(0x0C);
@@ -1635,3 +1741,10 @@ namespace CPC464 {
 
 }       // namespace CPC464
 
+
+// The Z80 instruction decoder is instantiated here, so that it can call the
+// memory and I/O functions of CPC464VM::Z80_ directly.
+
+#include "z80core.hpp"
+
+template class Ep128::Z80Core<CPC464::CPC464VM::Z80_>;
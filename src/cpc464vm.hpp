@@ -66,6 +66,8 @@ namespace CPC464 {
       virtual EP128EMU_REGPARM2 uint8_t doIn(uint16_t addr);
       virtual EP128EMU_REGPARM1 void updateCycle();
       virtual EP128EMU_REGPARM2 void updateCycles(int cycles);
+     private:
+      void loadTapeBlock();
     };
     class Memory_ : public Memory {
      private:
@@ -99,7 +101,7 @@ namespace CPC464 {
       virtual void vsyncStateChange(bool newState, unsigned int currentSlot_);
     };
     // ----------------
-    Z80_      z80;
+    Ep128::Z80Core<Z80_>  z80;
     Memory_   memory;
     IOPorts_  ioPorts;
     ZX128::AY3_8912 ay3;
@@ -127,6 +129,9 @@ namespace CPC464 {
     int32_t   singleStepModeNextAddr;
     bool      tapeCallbackFlag;
     bool      prvTapeCallbackFlag;
+    // address of the firmware routine called by the CAS READ jumpblock
+    // entry while play is pressed, or 0xFFFFFFFF (no loader trap)
+    uint32_t  casReadAddr;
     uint32_t  soundOutputSignal;
     Ep128Emu::File  *demoFile;
     // contains demo data, which is the emulator version number as a 32-bit
@@ -156,12 +161,16 @@ namespace CPC464 {
     uint8_t   floppyCycleCnt;           // divides 125 kHz sound clock by 4
     uint8_t   breakPointPriorityThreshold;
     struct CPC464VMCallback {
-      void      (*func)(void *);
+      uint32_t  (*func)(void *);
       void      *userData;
       CPC464VMCallback  *nxt;
+      uint64_t  nextTime;
     };
     CPC464VMCallback  callbacks[16];
     CPC464VMCallback  *firstCallback;
+    // current CRTC cycle, and the earliest time a callback is due
+    uint64_t  callbackTime;
+    uint64_t  nextCallbackTime;
     Ep128Emu::VideoCapture  *videoCapture;
     int64_t   tapeSamplesPerCRTCCycle;
     int64_t   tapeSamplesRemaining;
@@ -183,20 +192,34 @@ namespace CPC464 {
                                                            bool newState);
     static EP128EMU_REGPARM2 void vSyncStateChangeCallback(void *userData,
                                                            bool newState);
-    static void tapeCallback(void *userData);
-    static void demoPlayCallback(void *userData);
-    static void demoRecordCallback(void *userData);
-    static void videoCaptureCallback(void *userData);
+    static uint32_t tapeCallback(void *userData);
+    static uint32_t demoPlayCallback(void *userData);
+    static uint32_t demoRecordCallback(void *userData);
+    static uint32_t videoCaptureCallback(void *userData);
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
+    // write the state of the machine that is not stored by the components
+    void saveVMState(Ep128Emu::File::Buffer& buf);
+    // if 'isDelta' is true, only the changed memory blocks are stored
+    void saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    void restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    // state that is only stored in checkpoints: the time remaining from
+    // the last run() call, and the tape and disk drive emulation
+    void saveDeviceCheckpoint_();
+    void restoreDeviceCheckpoint_();
     EP128EMU_REGPARM1 void updatePPIState();
     uint8_t checkSingleStepModeBreak();
     void convertKeyboardState();
     void resetKeyboard();
+    uint32_t getCASReadAddress() const;
     // Set function to be called at every CRTC cycle. The functions are called
     // in the order of being registered; up to 16 callbacks can be set.
-    void setCallback(void (*func)(void *userData), void *userData_,
+    // Each function returns the number of CRTC cycles after which it is to
+    // be called again (1 = next cycle).
+    void setCallback(uint32_t (*func)(void *userData), void *userData_,
                      bool isEnabled);
+    // call the functions that are due at the current CRTC cycle
+    EP128EMU_REGPARM1 void runCallbacks();
    public:
     CPC464VM(Ep128Emu::VideoDisplay&, Ep128Emu::AudioOutput&);
     virtual ~CPC464VM();
@@ -263,6 +286,8 @@ namespace CPC464 {
     virtual void setDiskImageFile(int n, const std::string& fileName_,
                                   int nTracks_ = -1, int nSides_ = 2,
                                   int nSectorsPerTrack_ = 9);
+    virtual void setDiskOverlayDirectory(const std::string& dirName);
+    virtual void setFloppyTurboMode(bool isEnabled);
     /*!
      * Returns the current state of the disk drive LEDs, which is the sum
      * of any of the following values:
@@ -471,6 +496,15 @@ namespace CPC464 {
      * playing a demo.
      */
     virtual bool getIsPlayingDemo() const;
+    /*!
+     * Save or restore a checkpoint of the virtual machine state for
+     * run-ahead (see Ep128Emu::VirtualMachine::saveCheckpoint()).
+     */
+    virtual void saveCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void clearMemoryDirtyBlocks();
+    virtual void saveDeltaCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreDeltaCheckpoint(Ep128Emu::File::Buffer&);
     // ----------------
     virtual void loadState(Ep128Emu::File::Buffer&);
     virtual void loadMachineConfiguration(Ep128Emu::File::Buffer&);
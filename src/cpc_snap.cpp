@@ -32,29 +32,162 @@ namespace CPC464 {
     z80.saveState(f);
     {
       Ep128Emu::File::Buffer  buf;
-      buf.setPosition(0);
-      buf.writeUInt32(0x01000000);      // version number
-      for (uint8_t i = 0; i <= 16; i++)
-        buf.writeByte(videoRenderer.getColor(i));
-      buf.writeByte(videoRenderer.getVideoMode());
-      buf.writeByte(ayRegisterSelected);
-      buf.writeByte(ayCycleCnt - 1);
-      buf.writeByte(z80OpcodeHalfCycles);
-      buf.writeByte(ppiPortARegister);
-      buf.writeByte(ppiPortBRegister);
-      buf.writeByte(ppiPortCRegister);
-      buf.writeByte(ppiControlRegister);
-      buf.writeByte(crtcRegisterSelected);
-      buf.writeByte(gateArrayIRQCounter);
-      buf.writeByte(gateArrayVSyncDelay);
-      buf.writeByte(gateArrayPenSelected);
-      buf.writeUInt32(uint32_t(crtcFrequency));
-      for (int i = 0; i < 16; i++)
-        buf.writeByte(keyboardState[i]);
+      saveVMState(buf);
       f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_CPCVM_STATE, buf);
     }
   }
 
+  void CPC464VM::saveVMState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    buf.writeUInt32(0x01000000);        // version number
+    for (uint8_t i = 0; i <= 16; i++)
+      buf.writeByte(videoRenderer.getColor(i));
+    buf.writeByte(videoRenderer.getVideoMode());
+    buf.writeByte(ayRegisterSelected);
+    buf.writeByte(ayCycleCnt - 1);
+    buf.writeByte(z80OpcodeHalfCycles);
+    buf.writeByte(ppiPortARegister);
+    buf.writeByte(ppiPortBRegister);
+    buf.writeByte(ppiPortCRegister);
+    buf.writeByte(ppiControlRegister);
+    buf.writeByte(crtcRegisterSelected);
+    buf.writeByte(gateArrayIRQCounter);
+    buf.writeByte(gateArrayVSyncDelay);
+    buf.writeByte(gateArrayPenSelected);
+    buf.writeUInt32(uint32_t(crtcFrequency));
+    for (int i = 0; i < 16; i++)
+      buf.writeByte(keyboardState[i]);
+  }
+
+  void CPC464VM::saveDeviceCheckpoint_()
+  {
+    checkpointBuf.writeUInt32(0x01000000);      // version number
+    checkpointBuf.writeUInt32(crtcCyclesRemainingL);
+    checkpointBuf.writeInt32(crtcCyclesRemainingH);
+    floppyDrive->saveState(checkpointBuf);
+    // time until the next tape sample
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(CPC464VMCallback);
+    uint32_t  tapeCallbackDelay = 0U;
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback &&
+          callbacks[i].nextTime > callbackTime) {
+        tapeCallbackDelay = uint32_t(callbacks[i].nextTime - callbackTime);
+      }
+    }
+    checkpointBuf.writeBoolean(tapeCallbackFlag);
+    checkpointBuf.writeBoolean(prvTapeCallbackFlag);
+    checkpointBuf.writeByte(tapeInputSignal);
+    checkpointBuf.writeUInt32(tapeCallbackDelay);
+    checkpointBuf.writeInt64(tapeSamplesRemaining);
+    // stored last, as it is not read if the tape has been removed
+    saveTapeCheckpoint();
+  }
+
+  void CPC464VM::restoreDeviceCheckpoint_()
+  {
+    // check version number
+    unsigned int  version = checkpointBuf.readUInt32();
+    if (version != 0x01000000) {
+      checkpointBuf.setPosition(checkpointBuf.getDataSize());
+      throw Ep128Emu::Exception("incompatible cpc464 checkpoint version");
+    }
+    crtcCyclesRemainingL = checkpointBuf.readUInt32();
+    crtcCyclesRemainingH = checkpointBuf.readInt32();
+    floppyDrive->loadState(checkpointBuf);
+    bool      tapeCallbackFlag_ = checkpointBuf.readBoolean();
+    prvTapeCallbackFlag = checkpointBuf.readBoolean();
+    tapeInputSignal = checkpointBuf.readByte() & 0x01;
+    uint32_t  tapeCallbackDelay = checkpointBuf.readUInt32();
+    tapeSamplesRemaining = checkpointBuf.readInt64();
+    restoreTapeCheckpoint();
+    if (tapeCallbackFlag_ != tapeCallbackFlag) {
+      tapeCallbackFlag = tapeCallbackFlag_;
+      setCallback(&tapeCallback, this, tapeCallbackFlag);
+    }
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(CPC464VMCallback);
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback) {
+        callbacks[i].nextTime = callbackTime + tapeCallbackDelay;
+        if (callbacks[i].nextTime < nextCallbackTime)
+          nextCallbackTime = callbacks[i].nextTime;
+      }
+    }
+  }
+
+  void CPC464VM::saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.truncate();
+    if (isDelta)
+      memory.saveDeltaState(checkpointBuf);
+    else
+      memory.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    crtc.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    ay3.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    z80.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveVMState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveDeviceCheckpoint_();
+    writeCheckpointData(buf);
+  }
+
+  void CPC464VM::restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.setPosition(0);
+    restoringCheckpoint = true;
+    try {
+      readCheckpointData(buf);
+      if (isDelta)
+        memory.loadDeltaState(checkpointBuf);
+      else
+        memory.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      crtc.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      ay3.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      z80.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      this->loadState(checkpointBuf);
+      readCheckpointData(buf);
+      restoreDeviceCheckpoint_();
+    }
+    catch (...) {
+      restoringCheckpoint = false;
+      throw;
+    }
+    restoringCheckpoint = false;
+  }
+
+  void CPC464VM::saveCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, false);
+  }
+
+  void CPC464VM::restoreCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, false);
+  }
+
+  void CPC464VM::clearMemoryDirtyBlocks()
+  {
+    memory.clearDirtyBlocks();
+  }
+
+  void CPC464VM::saveDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, true);
+  }
+
+  void CPC464VM::restoreDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, true);
+  }
+
   void CPC464VM::saveMachineConfiguration(Ep128Emu::File& f)
   {
     Ep128Emu::File::Buffer  buf;
@@ -114,10 +247,12 @@ namespace CPC464 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible cpc464 snapshot version");
     }
-    stopDemo();
-    snapshotLoadFlag = true;
-    // reset floppy emulation, as its state is not saved
-    floppyDrive->reset();
+    if (!restoringCheckpoint) {
+      stopDemo();
+      snapshotLoadFlag = true;
+      // reset floppy emulation, as its state is not saved
+      floppyDrive->reset();
+    }
     try {
       for (uint8_t i = 0; i <= 16; i++)
         videoRenderer.setColor(i, buf.readByte());
@@ -135,9 +270,16 @@ namespace CPC464 {
       gateArrayVSyncDelay = buf.readByte() & 0x03;
       gateArrayPenSelected = buf.readByte() & 0x3F;
       (void) buf.readUInt32();          // crtcFrequency (ignored)
-      for (int i = 0; i < 16; i++)
-        keyboardState[i] = buf.readByte();
-      convertKeyboardState();
+      if (!restoringCheckpoint) {
+        for (int i = 0; i < 16; i++)
+          keyboardState[i] = buf.readByte();
+        convertKeyboardState();
+      }
+      else {
+        // keep the current keyboard state when restoring a checkpoint
+        for (int i = 0; i < 16; i++)
+          (void) buf.readByte();
+      }
       if (buf.getPosition() != buf.getDataSize())
         throw Ep128Emu::Exception("trailing garbage at end of "
                                   "cpc464 snapshot data");
@@ -31,10 +31,9 @@ namespace CPC464 {
 
   void CPCDiskImage::readImageFile(uint8_t *buf, size_t filePos, size_t nBytes)
   {
-    if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0)
-      throw Ep128Emu::Exception("error seeking CPC disk image file");
-    if (std::fread(buf, sizeof(uint8_t), nBytes, imageFile) != nBytes)
+    if (filePos > imageCache.size() || nBytes > (imageCache.size() - filePos))
       throw Ep128Emu::Exception("error reading CPC disk image file");
+    std::memcpy(buf, imageCache.getData() + filePos, nBytes);
   }
 
   void CPCDiskImage::parseDSKFileHeaders(uint8_t *buf, size_t fileSize)
@@ -270,6 +269,36 @@ namespace CPC464 {
     }
   }
 
+  bool CPCDiskImage::checkCopyProtection() const
+  {
+    for (int c = 0; c < nCylinders; c++) {
+      for (int h = 0; h < nSides; h++) {
+        const CPCDiskTrackInfo& t = trackTable[c * nSides + h];
+        if (t.nSectors > 18)
+          return true;
+        for (int i = 0; i < int(t.nSectors); i++) {
+          const CPCDiskSectorInfo&  s = t.sectorTable[i];
+          // sector with error flags, weak or truncated data, sector size
+          // that does not fit on a track, or wrong cylinder number
+          if (s.statusRegister1 != 0 || s.statusRegister2 != 0 ||
+              s.sectorSizeCode > 5 ||
+              s.dataSize != (0x80U << s.sectorSizeCode) ||
+              int(s.trackNum) != c) {
+            return true;
+          }
+          // duplicate sector ID
+          for (int j = 0; j < i; j++) {
+            if (t.sectorTable[j].sectorNum == s.sectorNum &&
+                t.sectorTable[j].sideNum == s.sideNum) {
+              return true;
+            }
+          }
+        }
+      }
+    }
+    return false;
+  }
+
   bool CPCDiskImage::openFloppyDevice(const char *fileName)
   {
     // file name is assumed to be non-NULL and non-empty
@@ -356,9 +385,12 @@ namespace CPC464 {
     : trackTable((CPCDiskTrackInfo *) 0),
       sectorTableBuf((CPCDiskSectorInfo *) 0),
       imageFile((std::FILE *) 0),
+      overlay((Ep128Emu::DiskImageOverlay *) 0),
+      overlayDirectory(""),
       nCylinders(0),
       nSides(0),
       writeProtectFlag(true),
+      copyProtectedFlag(false),
       currentCylinder(1),
       randomSeed(0)
   {
@@ -378,6 +410,12 @@ namespace CPC464 {
   void CPCDiskImage::openDiskImage(const char *fileName)
   {
     // close any previous image file first
+    if (imageFile)
+      (void) flushImageFile();          // FIXME: errors are ignored here
+    imageCache.clear();
+    if (overlay)
+      delete overlay;
+    overlay = (Ep128Emu::DiskImageOverlay *) 0;
     if (imageFile)
       std::fclose(imageFile);           // FIXME: errors are ignored here
     imageFile = (std::FILE *) 0;
@@ -390,6 +428,7 @@ namespace CPC464 {
     nCylinders = 0;
     nSides = 0;
     writeProtectFlag = true;
+    copyProtectedFlag = false;
     // empty or NULL file name: close image
     if (fileName == (char *) 0 || fileName[0] == '\0')
       return;
@@ -397,11 +436,13 @@ namespace CPC464 {
       if (openFloppyDevice(fileName))
         return;
       // open image file
-      imageFile = Ep128Emu::fileOpen(fileName, "r+b");
+      if (overlayDirectory.empty())
+        imageFile = Ep128Emu::fileOpen(fileName, "r+b");
       if (!imageFile) {
         imageFile = Ep128Emu::fileOpen(fileName, "rb");
         if (!imageFile)
           throw Ep128Emu::Exception("error opening CPC disk image file");
+        writeProtectFlag = overlayDirectory.empty();
       }
       else {
         writeProtectFlag = false;
@@ -412,6 +453,22 @@ namespace CPC464 {
       long    fileSize = std::ftell(imageFile);
       if (fileSize < 512L)
         throw Ep128Emu::Exception("invalid CPC disk image file");
+      if (!overlayDirectory.empty()) {
+        overlay = new Ep128Emu::DiskImageOverlay(overlayDirectory, fileName,
+                                                 imageFile, uint64_t(fileSize));
+      }
+      // read the whole image, the track headers and sector data are then
+      // accessed in memory
+      imageCache.resize(size_t(fileSize));
+      if (std::fseek(imageFile, 0L, SEEK_SET) < 0 ||
+          std::fread(imageCache.getData(), sizeof(uint8_t), size_t(fileSize),
+                     imageFile) != size_t(fileSize)) {
+        throw Ep128Emu::Exception("error reading CPC disk image file");
+      }
+      if (overlay) {
+        if (!overlay->patchData(imageCache.getData(), 0U, size_t(fileSize)))
+          throw Ep128Emu::Exception("error reading CPC disk image file");
+      }
       // check file header
       uint8_t tmpBuf[256];
       readImageFile(&(tmpBuf[0]), 0, 256);
@@ -434,6 +491,7 @@ namespace CPC464 {
         parseDSKFileHeaders(&(tmpBuf[0]), size_t(fileSize));
       else                              // extended disk image format
         parseEXTFileHeaders(&(tmpBuf[0]), size_t(fileSize));
+      copyProtectedFlag = checkCopyProtection();
     }
     catch (...) {
       openDiskImage((char *) 0);
@@ -519,11 +577,20 @@ namespace CPC464 {
                 + (sectorBytes
                    * size_t(getRandomNumber(int(dataSize) / int(sectorBytes))));
     }
-    if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0)
-      return FDC765::CPCDISK_ERROR_SECTOR_NOT_FOUND;
     size_t  nBytes = (dataSize < sectorBytes ? dataSize : sectorBytes);
-    if (std::fread(buf, sizeof(uint8_t), nBytes, imageFile) != nBytes)
-      return FDC765::CPCDISK_ERROR_READ_FAILED;
+    if (!imageCache.empty()) {
+      if (filePos > imageCache.size() ||
+          nBytes > (imageCache.size() - filePos)) {
+        return FDC765::CPCDISK_ERROR_READ_FAILED;
+      }
+      std::memcpy(buf, imageCache.getData() + filePos, nBytes);
+    }
+    else {
+      if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0)
+        return FDC765::CPCDISK_ERROR_SECTOR_NOT_FOUND;
+      if (std::fread(buf, sizeof(uint8_t), nBytes, imageFile) != nBytes)
+        return FDC765::CPCDISK_ERROR_READ_FAILED;
+    }
     if (dataSize < sectorBytes) {
       for (size_t i = dataSize; i < sectorBytes; i++)
         buf[i] = buf[i - dataSize];
@@ -553,11 +620,16 @@ namespace CPC464 {
       err = FDC765::CPCDISK_ERROR_WRITE_FAILED;
       if (t.sectorTableFileOffset != 0U) {
         // deleted sector flag changed: update status register 2 in image file
-        if (std::fseek(imageFile, long(t.sectorTableFileOffset)
-                                  + (long(&s - t.sectorTable) * 8L) + 5L,
-                       SEEK_SET) >= 0) {
-          uint8_t newStatusRegister2 =
-              (s.statusRegister2 & 0xBF) | (statusRegister2 & 0x40);
+        long    flagPos = long(t.sectorTableFileOffset)
+                          + (long(&s - t.sectorTable) * 8L) + 5L;
+        uint8_t newStatusRegister2 =
+            (s.statusRegister2 & 0xBF) | (statusRegister2 & 0x40);
+        if (!imageCache.empty()) {
+          imageCache.writeData(&newStatusRegister2, size_t(flagPos), 1);
+          s.statusRegister2 = newStatusRegister2;
+          err = FDC765::CPCDISK_NO_ERROR;
+        }
+        else if (std::fseek(imageFile, flagPos, SEEK_SET) >= 0) {
           if (std::fputc(newStatusRegister2, imageFile) != EOF) {
             s.statusRegister2 = newStatusRegister2;
             err = FDC765::CPCDISK_NO_ERROR;
@@ -576,14 +648,43 @@ namespace CPC464 {
                    * size_t(getRandomNumber(int(dataSize) / int(sectorBytes))));
       err = FDC765::CPCDISK_ERROR_WRITE_FAILED;
     }
+    size_t  nBytes = (dataSize < sectorBytes ? dataSize : sectorBytes);
+    if (!imageCache.empty()) {
+      // written to the file later by flushImageFile()
+      if (filePos > imageCache.size() ||
+          nBytes > (imageCache.size() - filePos)) {
+        return FDC765::CPCDISK_ERROR_WRITE_FAILED;
+      }
+      imageCache.writeData(buf, filePos, nBytes);
+      return err;
+    }
     if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0)
       return FDC765::CPCDISK_ERROR_SECTOR_NOT_FOUND;
-    size_t  nBytes = (dataSize < sectorBytes ? dataSize : sectorBytes);
     if (std::fwrite(buf, sizeof(uint8_t), nBytes, imageFile) != nBytes)
       return FDC765::CPCDISK_ERROR_WRITE_FAILED;
     return err;
   }
 
+  bool CPCDiskImage::flushImageFile()
+  {
+    bool    errorFlag = false;
+    size_t  filePos = 0;
+    size_t  nBytes = 0;
+    while (imageCache.getDirtyRange(filePos, nBytes)) {
+      const uint8_t *buf = imageCache.getData() + filePos;
+      if (overlay) {
+        if (!overlay->writeData(buf, uint64_t(filePos), nBytes))
+          errorFlag = true;
+      }
+      else if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0 ||
+               std::fwrite(buf, sizeof(uint8_t), nBytes, imageFile)
+               != nBytes) {
+        errorFlag = true;
+      }
+    }
+    return (!errorFlag);
+  }
+
   void CPCDiskImage::stepIn(int nSteps)
   {
     int     tmp = int(currentCylinder) + nSteps;
@@ -596,6 +697,19 @@ namespace CPC464 {
     currentCylinder = uint8_t(tmp > 0 ? (tmp < 84 ? tmp : 84) : 0);
   }
 
+  void CPCDiskImage::saveState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.writeByte(currentCylinder);
+    buf.writeInt32(int32_t(randomSeed));
+  }
+
+  void CPCDiskImage::loadState(Ep128Emu::File::Buffer& buf)
+  {
+    uint8_t c = buf.readByte();
+    currentCylinder = (c < 84 ? c : 84);
+    randomSeed = int(buf.readInt32());
+  }
+
   // ==========================================================================
 
   FDC765_CPC::FDC765_CPC()
@@ -618,6 +732,33 @@ namespace CPC464 {
     }
   }
 
+  void FDC765_CPC::setOverlayDirectory(const std::string& dirName)
+  {
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].setOverlayDirectory(dirName);
+  }
+
+  void FDC765_CPC::saveState(Ep128Emu::File::Buffer& buf)
+  {
+    FDC765::saveState(buf);
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].saveState(buf);
+  }
+
+  void FDC765_CPC::loadState(Ep128Emu::File::Buffer& buf)
+  {
+    FDC765::loadState(buf);
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].loadState(buf);
+    updateDriveReadyStatus();
+  }
+
+  void FDC765_CPC::motorStopped()
+  {
+    for (int i = 0; i < 4; i++)
+      (void) floppyDrives[i].flushImageFile();  // FIXME: errors are ignored
+  }
+
   bool FDC765_CPC::haveDisk(int driveNum) const
   {
     return floppyDrives[driveNum & 3].haveDisk();
@@ -633,6 +774,11 @@ namespace CPC464 {
     return floppyDrives[driveNum & 3].getIsWriteProtected();
   }
 
+  bool FDC765_CPC::getIsCopyProtected(int driveNum) const
+  {
+    return floppyDrives[driveNum & 3].getIsCopyProtected();
+  }
+
   uint8_t FDC765_CPC::getPhysicalTrackSectors(int c) const
   {
     return floppyDrives[cmdParams.unitNumber].getPhysicalTrackSectors(
@@ -23,6 +23,7 @@
 #include "ep128emu.hpp"
 #include "fdc765.hpp"
 #include "system.hpp"
+#include "diskovl.hpp"
 
 namespace CPC464 {
 
@@ -51,9 +52,14 @@ namespace CPC464 {
     CPCDiskTrackInfo  *trackTable;
     CPCDiskSectorInfo *sectorTableBuf;
     std::FILE *imageFile;
+    Ep128Emu::DiskImageOverlay  *overlay;       // NULL if not used
+    std::string overlayDirectory;
+    // copy of the image file in memory, empty for real floppy disks
+    Ep128Emu::DiskImageCache    imageCache;
     int       nCylinders;               // number of cylinders (1 to 240)
     int       nSides;                   // number of sides (1 or 2)
     bool      writeProtectFlag;
+    bool      copyProtectedFlag;
     uint8_t   currentCylinder;          // drive head position
     int       randomSeed;               // for emulating weak sectors
     // ----------------
@@ -61,15 +67,27 @@ namespace CPC464 {
     void parseDSKFileHeaders(uint8_t *buf, size_t fileSize);
     void parseEXTFileHeaders(uint8_t *buf, size_t fileSize);
     void calculateSectorPositions(CPCDiskTrackInfo& t);
+    // returns true if the disk has any non-standard sectors or tracks that
+    // may be used for copy protection
+    bool checkCopyProtection() const;
     bool openFloppyDevice(const char *fileName);
    public:
     CPCDiskImage();
     virtual ~CPCDiskImage();
     virtual void openDiskImage(const char *fileName);
+    // if 'dirName' is not empty, disk image files opened later are not
+    // modified, written data is stored in a delta file in 'dirName'
+    inline void setOverlayDirectory(const std::string& dirName)
+    {
+      overlayDirectory = dirName;
+    }
     inline bool haveDisk() const
     {
       return (imageFile != (std::FILE *) 0);
     }
+    // write the data modified in memory to the image file or overlay,
+    // returns false on error
+    bool flushImageFile();
     inline bool getIsTrack0() const
     {
       return (currentCylinder == 0);
@@ -78,6 +96,10 @@ namespace CPC464 {
     {
       return writeProtectFlag;
     }
+    inline bool getIsCopyProtected() const
+    {
+      return copyProtectedFlag;
+    }
     inline uint8_t getPhysicalTrackSectors(int c, int h) const
     {
       if (c < 0 || c >= nCylinders || h < 0 || h >= nSides)
@@ -121,6 +143,9 @@ namespace CPC464 {
     {
       return (Ep128Emu::getRandomNumber(randomSeed) % n);
     }
+    // save and restore the head position for virtual machine checkpoints
+    void saveState(Ep128Emu::File::Buffer& buf);
+    void loadState(Ep128Emu::File::Buffer& buf);
   };
 
   // --------------------------------------------------------------------------
@@ -132,10 +157,15 @@ namespace CPC464 {
     FDC765_CPC();
     virtual ~FDC765_CPC();
     virtual void openDiskImage(int n, const char *fileName);
+    void setOverlayDirectory(const std::string& dirName);
+    virtual void saveState(Ep128Emu::File::Buffer& buf);
+    virtual void loadState(Ep128Emu::File::Buffer& buf);
    protected:
+    virtual void motorStopped();
     virtual bool haveDisk(int driveNum) const;
     virtual bool getIsTrack0(int driveNum) const;
     virtual bool getIsWriteProtected(int driveNum) const;
+    virtual bool getIsCopyProtected(int driveNum) const;
     virtual uint8_t getPhysicalTrackSectors(int c) const;
     virtual uint8_t getCurrentTrackSectors() const;
     // returns the ID (C, H, R, N) of the physical sector specified by c, s
@@ -29,6 +29,7 @@ namespace CPC464 {
     if (segmentTable[n] == (uint8_t *) 0)
       segmentTable[n] = new uint8_t[16384];
     segmentROMTable[n] = isROM;
+    dirtyMap.setSegmentDirty(n);
     setPaging(currentPaging);
   }
 
@@ -341,6 +342,7 @@ namespace CPC464 {
       delete[] segmentTable[segment];
     segmentTable[segment] = (uint8_t*) 0;
     segmentROMTable[segment] = true;
+    dirtyMap.setSegmentDirty(segment);
     setPaging(currentPaging);
   }
 
@@ -497,8 +499,7 @@ namespace CPC464 {
     buf.writeByte(expansionRAMBlocks);
     for (uint8_t i = 0; i < ((expansionRAMBlocks << 2) + 0x04); i++) {
       if (segmentTable[i] != (uint8_t *) 0) {
-        for (size_t j = 0; j < 16384; j++)
-          buf.writeByte(segmentTable[i][j]);
+        buf.writeData(segmentTable[i], 16384);
       }
       else {
         for (size_t j = 0; j < 16384; j++)
@@ -510,8 +511,7 @@ namespace CPC464 {
         i = 0xC0;
       if (segmentTable[i] != (uint8_t *) 0) {
         buf.writeByte(uint8_t(i));
-        for (size_t j = 0; j < 16384; j++)
-          buf.writeByte(segmentTable[i][j]);
+        buf.writeData(segmentTable[i], 16384);
       }
     }
   }
@@ -533,6 +533,7 @@ namespace CPC464 {
       throw Ep128Emu::Exception("incompatible CPC memory snapshot format");
     }
     // reset memory
+    dirtyMap.setAllDirty();
     deleteAllSegments();
     try {
       currentPaging = buf.readUInt16();
@@ -541,8 +542,7 @@ namespace CPC464 {
       setRAMSize((size_t(expansionRAMBlocks) << 6) + 64);
       for (uint8_t i = 0; i < ((expansionRAMBlocks << 2) + 0x04); i++) {
         if (segmentTable[i] != (uint8_t *) 0) {
-          for (size_t j = 0; j < 16384; j++)
-            segmentTable[i][j] = buf.readByte();
+          buf.readData(segmentTable[i], 16384);
         }
         else {
           for (size_t j = 0; j < 16384; j++)
@@ -555,8 +555,7 @@ namespace CPC464 {
         if (segment >= 0xC0 || segment == 0x80)
           allocateSegment(segment, true);
         if (segmentTable[segment] != (uint8_t *) 0) {
-          for (size_t i = 0; i < 16384; i++)
-            segmentTable[segment][i] = buf.readByte();
+          buf.readData(segmentTable[segment], 16384);
         }
         else {
           for (size_t i = 0; i < 16384; i++)
@@ -572,6 +571,33 @@ namespace CPC464 {
     }
   }
 
+  void Memory::clearDirtyBlocks()
+  {
+    dirtyMap.clear();
+  }
+
+  void Memory::saveDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    buf.writeUInt32(0x02000000);        // delta state version number
+    buf.writeUInt16(currentPaging);
+    dirtyMap.saveDelta(buf, segmentTable, segmentROMTable);
+  }
+
+  void Memory::loadDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    // check version number
+    unsigned int  version = buf.readUInt32();
+    if (version != 0x02000000) {
+      buf.setPosition(buf.getDataSize());
+      throw Ep128Emu::Exception("incompatible CPC memory delta state format");
+    }
+    uint16_t  savedPaging = buf.readUInt16();
+    dirtyMap.loadDelta(buf, segmentTable, segmentROMTable);
+    setPaging(savedPaging);
+  }
+
   void Memory::registerChunkType(Ep128Emu::File& f)
   {
     ChunkType_CPCMemSnapshot  *p;
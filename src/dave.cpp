@@ -94,10 +94,69 @@ namespace Ep128 {
     interruptRequest();
   }
 
+  // advance the counters by 'n' cycles, assuming that no oscillator is
+  // reloaded, and the polynomial counter of channel 3 is not clocked
+
+  void Dave::advanceCounters(int n)
+  {
+    polycnt4_phase -= (n % 15);
+    if (polycnt4_phase < 0)
+      polycnt4_phase += 15;
+    polycnt4_state = (int) t.polycnt4_table[polycnt4_phase];
+    polycnt5_phase -= (n % 31);
+    if (polycnt5_phase < 0)
+      polycnt5_phase += 31;
+    polycnt5_state = (int) t.polycnt5_table[polycnt5_phase];
+    if (!noise_polycnt_is_7bit) {
+      polycnt7_phase -= (n % 127);
+      if (polycnt7_phase < 0)
+        polycnt7_phase += 127;
+      polycnt7_state = (int) t.polycnt7_table[polycnt7_phase];
+    }
+    else {
+      polycntVL_phase -= (n % (polycntVL_maxphase + 1));
+      if (polycntVL_phase < 0)
+        polycntVL_phase += (polycntVL_maxphase + 1);
+      polycntVL_state = (int) polycntVL_table[polycntVL_phase];
+    }
+    clk_62500_phase -= n;
+    if (clk_62500_phase < 0) {
+      int     k = ((-1 - clk_62500_phase) >> 2) + 1;
+      clk_62500_phase += ((clk_62500_frq + 1) * k);
+      clk_62500_state = (clk_62500_state ^ k) & 1;
+    }
+    clk_1000_phase -= n;
+    chn0_phase -= (chn0_run * n);
+    chn1_phase -= (chn1_run * n);
+    chn2_phase -= (chn2_run * n);
+  }
+
+  // apply the idle cycles elapsed so far to the counters
+
+  void Dave::syncIdleCycles()
+  {
+    int     n = idleCyclesTotal - idleCycles;
+    idleCyclesTotal = idleCycles;
+    if (n > 0)
+      advanceCounters(n);
+  }
+
+  // end the current idle period, needed when the output may change
+
+  void Dave::stopIdleCycles()
+  {
+    syncIdleCycles();
+    idleCycles = 0;
+    idleCyclesTotal = 0;
+  }
+
   // run DAVE emulation, and also trigger any sound or timer interrupts
 
   uint32_t Dave::runOneCycle_()
   {
+    if (idleCyclesTotal)
+      syncIdleCycles();
+
     // update polynomial counters
     if (--polycnt4_phase < 0)                   // 4-bit
       polycnt4_phase = 14;
@@ -322,6 +381,24 @@ namespace Ep128 {
     }
 
     audioOutput = uint32_t(lval + (rval << 16)) << 7;
+
+    // if there are no edges to be processed, find the number of cycles
+    // until the next oscillator or timer reload
+    if (chn0_state == chn0_prv && chn1_state == chn1_prv &&
+        chn2_state == chn2_prv && chn3_state == chn3_prv &&
+        *chn3_clk_source == chn3_clk_source_prv) {
+      int     n = clk_1000_phase;
+      if (chn0_run && chn0_phase < n)
+        n = chn0_phase;
+      if (chn1_run && chn1_phase < n)
+        n = chn1_phase;
+      if (chn2_run && chn2_phase < n)
+        n = chn2_phase;
+      if (chn3_clk_source == &clk_62500_state && clk_62500_phase < n)
+        n = clk_62500_phase;
+      idleCycles = n;
+      idleCyclesTotal = n;
+    }
     return audioOutput;
   }
 
@@ -351,6 +428,8 @@ namespace Ep128 {
 
   void Dave::writePort(uint16_t addr, uint8_t value)
   {
+    if ((addr & 0x1F) < 0x10 || (addr & 0x1F) == 0x15)
+      stopIdleCycles();
     switch (uint8_t(addr & 0x1F)) {
     case 0x00:
       // channel 0 frequency
@@ -706,6 +785,8 @@ namespace Ep128 {
   {
     clockDiv = 2;
     clockCnt = 1;
+    idleCycles = 0;
+    idleCyclesTotal = 0;
     polycnt4_state = 0;
     polycnt5_state = 0;
     polycnt7_state = 0;
@@ -751,6 +832,8 @@ namespace Ep128 {
 
   void Dave::reset(bool isColdReset)
   {
+    idleCycles = 0;
+    idleCyclesTotal = 0;
     polycnt4_phase = 0;
     polycnt5_phase = 0;
     polycnt7_phase = 0;
@@ -778,6 +861,8 @@ namespace Ep128 {
 
   void Dave::setTapeInput(int state, int level)
   {
+    if (tape_input != (state ? 1 : 0))
+      stopIdleCycles();
     tape_input = (state ? 1 : 0);
     tape_input_level = (level > 0 ? 1 : 0);
   }
@@ -824,6 +909,7 @@ namespace Ep128 {
 
   void Dave::saveState(Ep128Emu::File::Buffer& buf)
   {
+    syncIdleCycles();
     buf.setPosition(0);
     buf.writeUInt32(0x01000003);        // version number
     buf.writeByte(uint8_t(clockDiv));
@@ -21,6 +21,7 @@
 #define EP128EMU_DAVE_HPP
 
 #include "ep128emu.hpp"
+#include "profiler.hpp"
 
 namespace Ep128 {
 
@@ -45,6 +46,10 @@ namespace Ep128 {
     static DaveTables t;
     int     clockDiv;               // 2 if bit 1 of port 0xBF is 0, 3 otherwise
     int     clockCnt;               // counts from 'clockDiv' towards zero
+    // number of remaining DAVE cycles in which only the counters change,
+    // and the number of cycles not yet applied to the counters
+    int     idleCycles;
+    int     idleCyclesTotal;
     // variable length counter uses one of the 9, 11, 15, and 17 bit tables
     uint8_t *polycntVL_table;
     // polynomial counters
@@ -152,6 +157,9 @@ namespace Ep128 {
     inline void triggerIntSnd();
     inline void triggerInt1Hz();
     int * findPolycntForToneChannel(int n);
+    void advanceCounters(int n);
+    void syncIdleCycles();
+    void stopIdleCycles();
     uint32_t runOneCycle_();
    public:
     Dave();
@@ -169,12 +177,20 @@ namespace Ep128 {
      * Return value is audio output in left_channel + (right_channel << 16)
      * format, where the range for a single channel is 0 to 40320 (sum of 4
      * sound generators and tape feedback, 0 to 8064 each).
+     * Cycles in which no oscillator is reloaded and no edge needs to be
+     * processed only update a counter, the polynomial counters and phases
+     * are advanced in one step at the end of such a period.
      */
     inline uint32_t runOneCycle()
     {
+      EP128EMU_PROFILE_SCOPE(PROFILER_DAVE);
       if (--clockCnt > 0)
         return audioOutput;
       clockCnt = clockDiv;
+      if (idleCycles > 0) {
+        idleCycles--;
+        return audioOutput;
+      }
       return runOneCycle_();
     }
     /*!
@@ -242,6 +258,11 @@ namespace Ep128 {
      * +------+-------+-------+-------+-------+-------+-------+-------+-------+
      */
     void setKeyboardState(int keyCode, int state);
+    inline bool getKeyboardState(int keyCode) const
+    {
+      return !(keyboardState[(keyCode & 0x78) >> 3]
+               & uint8_t(1 << (keyCode & 0x07)));
+    }
     inline void setMouseInput(uint8_t value)
     {
       mouseInput = value;
@@ -0,0 +1,406 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "diskovl.hpp"
+#include "fileio.hpp"
+#include "system.hpp"
+
+#include <sys/types.h>
+#ifdef WIN32
+#  include <io.h>
+#  include <windows.h>
+#else
+#  include <sys/file.h>
+#endif
+
+// delta file header: 16 byte identifier, size of the image file (64-bit
+// little endian), 8 reserved bytes; followed by slots of an 8 byte chunk
+// number and the chunk data
+static const char     *deltaFileHeader = "ep128emu overlay";
+static const size_t   deltaHeaderSize = 32;
+
+// try to take an exclusive lock on 'f', which is released when the file is
+// closed; returns false if another instance of the emulator has locked it
+static bool lockDeltaFile(std::FILE *f)
+{
+#ifdef WIN32
+  // the byte locked is beyond the end of the file, so that other instances
+  // can still read the data
+  HANDLE      h = (HANDLE) _get_osfhandle(_fileno(f));
+  OVERLAPPED  ov;
+  std::memset(&ov, 0, sizeof(OVERLAPPED));
+  ov.Offset = 0xFFFFFFFEUL;
+  ov.OffsetHigh = 0x7FFFFFFFUL;
+  return (LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                     0, 1, 0, &ov) != FALSE);
+#else
+  return (flock(fileno(f), LOCK_EX | LOCK_NB) == 0);
+#endif
+}
+
+namespace Ep128Emu {
+
+  extern bool seekImageFile(std::FILE *f, uint64_t filePos)
+  {
+#ifdef WIN32
+    return (_fseeki64(f, __int64(filePos), SEEK_SET) == 0);
+#else
+    return (fseeko(f, off_t(filePos), SEEK_SET) == 0);
+#endif
+  }
+
+  extern int64_t getImageFileSize(std::FILE *f)
+  {
+#ifdef WIN32
+    if (_fseeki64(f, 0, SEEK_END) != 0)
+      return -1;
+    int64_t fileSize = int64_t(_ftelli64(f));
+#else
+    if (fseeko(f, 0, SEEK_END) != 0)
+      return -1;
+    int64_t fileSize = int64_t(ftello(f));
+#endif
+    if (!seekImageFile(f, 0U))
+      return -1;
+    return fileSize;
+  }
+
+  // --------------------------------------------------------------------------
+
+  DiskImageOverlay::DiskImageOverlay(const std::string& overlayDir,
+                                     const std::string& imageFileName,
+                                     std::FILE *baseFile_,
+                                     uint64_t baseFileSize_)
+    : deltaFileName(getDeltaFileName(overlayDir, imageFileName)),
+      baseFile(baseFile_),
+      deltaFile((std::FILE *) 0),
+      baseFileSize(baseFileSize_),
+      inMemory(false)
+  {
+    deltaFile = fileOpen(deltaFileName.c_str(), "r+b");
+    if (deltaFile) {
+      try {
+        inMemory = !lockDeltaFile(deltaFile);
+        loadDeltaFile_();
+      }
+      catch (...) {
+        std::fclose(deltaFile);
+        deltaFile = (std::FILE *) 0;
+        throw;
+      }
+      if (inMemory) {
+        // the image is also open in another instance of the emulator:
+        // continue with a copy of the delta file in memory, and do not save
+        // any changes
+        std::fclose(deltaFile);
+        deltaFile = (std::FILE *) 0;
+      }
+    }
+  }
+
+  DiskImageOverlay::~DiskImageOverlay()
+  {
+    if (deltaFile)
+      std::fclose(deltaFile);
+  }
+
+  void DiskImageOverlay::loadDeltaFile_()
+  {
+    std::setvbuf(deltaFile, (char *) 0, _IONBF, 0);
+    uint8_t *buf = &(slotBuf[0]);
+    bool    headerOK = (std::fread(buf, 1, deltaHeaderSize, deltaFile)
+                        == deltaHeaderSize);
+    if (headerOK) {
+      uint64_t  n = 0U;
+      for (int i = 7; i >= 0; i--)
+        n = (n << 8) | uint64_t(buf[16 + i]);
+      headerOK = (std::memcmp(buf, deltaFileHeader, 16) == 0 &&
+                  n == baseFileSize);
+    }
+    if (!headerOK)
+      throw Exception("disk image overlay file does not match the image");
+    // an incomplete slot at the end of the file is ignored
+    uint32_t  slotNum = 0U;
+    while (std::fread(buf, 1, chunkSize + 8, deltaFile) == (chunkSize + 8)) {
+      uint64_t  chunkNum = 0U;
+      for (int i = 7; i >= 0; i--)
+        chunkNum = (chunkNum << 8) | uint64_t(buf[i]);
+      chunkMap[chunkNum] = slotNum;
+      slotNum++;
+      if (inMemory)
+        memoryBuf.insert(memoryBuf.end(), buf + 8, buf + (chunkSize + 8));
+    }
+  }
+
+  bool DiskImageOverlay::createDeltaFile_()
+  {
+    // the file is created without truncating it first, as another instance
+    // of the emulator may have created and locked it since the image was
+    // opened
+    deltaFile = fileOpen(deltaFileName.c_str(), "ab");
+    if (!deltaFile)
+      return false;
+    std::fclose(deltaFile);
+    deltaFile = fileOpen(deltaFileName.c_str(), "r+b");
+    if (!deltaFile)
+      return false;
+    if (!lockDeltaFile(deltaFile) || getImageFileSize(deltaFile) != 0) {
+      // in use, or written by another instance: keep the changes in memory
+      std::fclose(deltaFile);
+      deltaFile = (std::FILE *) 0;
+      inMemory = true;
+      return true;
+    }
+    std::setvbuf(deltaFile, (char *) 0, _IONBF, 0);
+    uint8_t buf[deltaHeaderSize];
+    std::memset(&(buf[0]), 0x00, deltaHeaderSize);
+    std::memcpy(&(buf[0]), deltaFileHeader, 16);
+    for (int i = 0; i < 8; i++)
+      buf[16 + i] = uint8_t((baseFileSize >> (i * 8)) & 0xFFU);
+    if (std::fwrite(&(buf[0]), 1, deltaHeaderSize, deltaFile)
+        != deltaHeaderSize) {
+      std::fclose(deltaFile);
+      deltaFile = (std::FILE *) 0;
+      return false;
+    }
+    return true;
+  }
+
+  bool DiskImageOverlay::readChunk_(uint8_t *buf, uint32_t slotNum)
+  {
+    if (inMemory) {
+      std::memcpy(buf, &(memoryBuf[size_t(slotNum) * chunkSize]), chunkSize);
+      return true;
+    }
+    uint64_t  filePos =
+        uint64_t(deltaHeaderSize) + (uint64_t(slotNum) * (chunkSize + 8))
+        + 8U;
+    if (!seekImageFile(deltaFile, filePos))
+      return false;
+    return (std::fread(buf, 1, chunkSize, deltaFile) == chunkSize);
+  }
+
+  bool DiskImageOverlay::writeChunk_(const uint8_t *buf, uint64_t chunkNum)
+  {
+    if (!(deltaFile || inMemory)) {
+      if (!createDeltaFile_())
+        return false;
+    }
+    std::map< uint64_t, uint32_t >::iterator  i = chunkMap.find(chunkNum);
+    if (inMemory) {
+      if (i != chunkMap.end()) {
+        std::memcpy(&(memoryBuf[size_t(i->second) * chunkSize]), buf,
+                    chunkSize);
+      }
+      else {
+        chunkMap[chunkNum] = uint32_t(chunkMap.size());
+        memoryBuf.insert(memoryBuf.end(), buf, buf + chunkSize);
+      }
+      return true;
+    }
+    if (i != chunkMap.end()) {
+      // overwrite the data of an existing slot
+      uint64_t  filePos =
+          uint64_t(deltaHeaderSize) + (uint64_t(i->second) * (chunkSize + 8))
+          + 8U;
+      return (seekImageFile(deltaFile, filePos) &&
+              std::fwrite(buf, 1, chunkSize, deltaFile) == chunkSize);
+    }
+    uint32_t  slotNum = uint32_t(chunkMap.size());
+    for (int j = 0; j < 8; j++)
+      slotBuf[j] = uint8_t((chunkNum >> (j * 8)) & 0xFFU);
+    std::memcpy(&(slotBuf[8]), buf, chunkSize);
+    uint64_t  filePos =
+        uint64_t(deltaHeaderSize) + (uint64_t(slotNum) * (chunkSize + 8));
+    if (!seekImageFile(deltaFile, filePos) ||
+        std::fwrite(&(slotBuf[0]), 1, chunkSize + 8, deltaFile)
+        != (chunkSize + 8)) {
+      return false;
+    }
+    chunkMap[chunkNum] = slotNum;
+    return true;
+  }
+
+  bool DiskImageOverlay::patchData(uint8_t *buf, uint64_t filePos,
+                                   size_t nBytes)
+  {
+    if (chunkMap.empty() || nBytes < 1)
+      return true;
+    uint64_t  endPos = filePos + nBytes;
+    std::map< uint64_t, uint32_t >::const_iterator  i =
+        chunkMap.lower_bound(filePos / chunkSize);
+    for ( ; i != chunkMap.end(); i++) {
+      uint64_t  chunkPos = i->first * chunkSize;
+      if (chunkPos >= endPos)
+        break;
+      if (!readChunk_(&(slotBuf[8]), i->second))
+        return false;
+      // copy the part of the chunk that overlaps the requested range
+      uint64_t  startPos = (chunkPos > filePos ? chunkPos : filePos);
+      uint64_t  stopPos = chunkPos + chunkSize;
+      if (stopPos > endPos)
+        stopPos = endPos;
+      std::memcpy(buf + size_t(startPos - filePos),
+                  &(slotBuf[8]) + size_t(startPos - chunkPos),
+                  size_t(stopPos - startPos));
+    }
+    return true;
+  }
+
+  bool DiskImageOverlay::writeData(const uint8_t *buf, uint64_t filePos,
+                                   size_t nBytes)
+  {
+    uint64_t  endPos = filePos + nBytes;
+    uint8_t   chunkBuf[chunkSize];
+    for (uint64_t chunkNum = filePos / chunkSize;
+         (chunkNum * chunkSize) < endPos;
+         chunkNum++) {
+      uint64_t  chunkPos = chunkNum * chunkSize;
+      if (chunkPos >= filePos && (chunkPos + chunkSize) <= endPos) {
+        if (!writeChunk_(buf + size_t(chunkPos - filePos), chunkNum))
+          return false;
+        continue;
+      }
+      // partially overwritten chunk: read the current data first
+      std::map< uint64_t, uint32_t >::const_iterator  i =
+          chunkMap.find(chunkNum);
+      if (i != chunkMap.end()) {
+        if (!readChunk_(&(chunkBuf[0]), i->second))
+          return false;
+      }
+      else {
+        if (!baseFile)
+          return false;
+        std::memset(&(chunkBuf[0]), 0x00, chunkSize);
+        size_t  n = chunkSize;
+        if (chunkPos >= baseFileSize)
+          n = 0;
+        else if ((baseFileSize - chunkPos) < uint64_t(chunkSize))
+          n = size_t(baseFileSize - chunkPos);
+        if (n > 0) {
+          if (!seekImageFile(baseFile, chunkPos) ||
+              std::fread(&(chunkBuf[0]), 1, n, baseFile) != n) {
+            return false;
+          }
+        }
+      }
+      uint64_t  startPos = (chunkPos > filePos ? chunkPos : filePos);
+      uint64_t  stopPos = chunkPos + chunkSize;
+      if (stopPos > endPos)
+        stopPos = endPos;
+      std::memcpy(&(chunkBuf[0]) + size_t(startPos - chunkPos),
+                  buf + size_t(startPos - filePos),
+                  size_t(stopPos - startPos));
+      if (!writeChunk_(&(chunkBuf[0]), chunkNum))
+        return false;
+    }
+    return true;
+  }
+
+  std::string DiskImageOverlay::getDeltaFileName(
+      const std::string& overlayDir, const std::string& imageFileName)
+  {
+    std::string dirName;
+    std::string baseName;
+    splitPath(imageFileName, dirName, baseName);
+    uint32_t  h = File::hash_32(
+                      reinterpret_cast< const unsigned char * >(
+                          imageFileName.c_str()), imageFileName.length());
+    char    tmpBuf[16];
+    std::sprintf(&(tmpBuf[0]), "_%08X.cow", (unsigned int) h);
+    std::string fileName(overlayDir);
+    if (fileName.length() > 0) {
+      char    c = fileName[fileName.length() - 1];
+      if (c != '/' && c != '\\') {
+#ifdef WIN32
+        fileName += '\\';
+#else
+        fileName += '/';
+#endif
+      }
+    }
+    fileName += baseName;
+    fileName += &(tmpBuf[0]);
+    return fileName;
+  }
+
+  // --------------------------------------------------------------------------
+
+  DiskImageCache::DiskImageCache()
+    : firstDirtyWord(0),
+      dirtyFlag(false)
+  {
+  }
+
+  DiskImageCache::~DiskImageCache()
+  {
+  }
+
+  void DiskImageCache::resize(size_t nBytes)
+  {
+    buf.resize(nBytes);
+    dirtyMap.clear();
+    dirtyMap.resize(((nBytes + (chunkSize - 1)) / chunkSize + 31) >> 5, 0U);
+    firstDirtyWord = dirtyMap.size();
+    dirtyFlag = false;
+  }
+
+  void DiskImageCache::writeData(const uint8_t *src, size_t pos, size_t nBytes)
+  {
+    if (pos >= buf.size() || nBytes < 1)
+      return;
+    if (nBytes > (buf.size() - pos))
+      nBytes = buf.size() - pos;
+    std::memcpy(&(buf[pos]), src, nBytes);
+    size_t  lastChunk = (pos + nBytes - 1) / chunkSize;
+    for (size_t i = pos / chunkSize; i <= lastChunk; i++)
+      dirtyMap[i >> 5] |= (uint32_t(1) << (i & 31));
+    if (((pos / chunkSize) >> 5) < firstDirtyWord)
+      firstDirtyWord = (pos / chunkSize) >> 5;
+    dirtyFlag = true;
+  }
+
+  bool DiskImageCache::getDirtyRange(size_t& pos, size_t& nBytes)
+  {
+    pos = 0;
+    nBytes = 0;
+    while (firstDirtyWord < dirtyMap.size() && !dirtyMap[firstDirtyWord])
+      firstDirtyWord++;
+    if (firstDirtyWord >= dirtyMap.size()) {
+      dirtyFlag = false;
+      return false;
+    }
+    size_t  firstChunk = firstDirtyWord << 5;
+    while (!(dirtyMap[firstChunk >> 5] & (uint32_t(1) << (firstChunk & 31))))
+      firstChunk++;
+    size_t  nChunks = (buf.size() + (chunkSize - 1)) / chunkSize;
+    size_t  i = firstChunk;
+    while (i < nChunks && (dirtyMap[i >> 5] & (uint32_t(1) << (i & 31)))) {
+      dirtyMap[i >> 5] &= ~(uint32_t(1) << (i & 31));
+      i++;
+    }
+    pos = firstChunk * chunkSize;
+    nBytes = i * chunkSize;
+    if (nBytes > buf.size())
+      nBytes = buf.size();
+    nBytes -= pos;
+    return true;
+  }
+
+}       // namespace Ep128Emu
@@ -0,0 +1,146 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_DISKOVL_HPP
+#define EP128EMU_DISKOVL_HPP
+
+#include "ep128emu.hpp"
+
+#include <map>
+#include <vector>
+
+namespace Ep128Emu {
+
+  // seek to a 64-bit position in 'f', returns false on error
+  extern bool seekImageFile(std::FILE *f, uint64_t filePos);
+  // returns the size of 'f' in bytes, or -1 on error
+  extern int64_t getImageFileSize(std::FILE *f);
+
+  /*!
+   * Copy-on-write overlay for a disk image file that is opened read-only.
+   * Data written by the emulated machine is stored in 512 byte chunks in
+   * a delta file, and applied to the data read from the image. The delta
+   * file is only created on the first write, and is loaded again when the
+   * same image is opened later. The delta file is locked while in use; if
+   * it is already locked by another instance of the emulator, then the
+   * changes are kept in memory only, and are lost when the image is closed.
+   */
+  class DiskImageOverlay {
+   protected:
+    static const size_t chunkSize = 512;
+    std::string deltaFileName;
+    std::FILE   *baseFile;      // not owned, may be NULL
+    std::FILE   *deltaFile;     // NULL until the first write
+    uint64_t    baseFileSize;
+    // chunk number -> slot number in the delta file
+    std::map< uint64_t, uint32_t >  chunkMap;
+    uint8_t     slotBuf[chunkSize + 8];
+    // chunk data if the delta file is in use by another instance
+    std::vector< uint8_t >  memoryBuf;
+    bool        inMemory;
+    // --------
+    void loadDeltaFile_();
+    bool createDeltaFile_();
+    bool readChunk_(uint8_t *buf, uint32_t slotNum);
+    bool writeChunk_(const uint8_t *buf, uint64_t chunkNum);
+   public:
+    /*!
+     * Open or prepare the delta file for 'imageFileName' in 'overlayDir'.
+     * 'baseFile_' is only used for reading the unmodified parts of chunks
+     * that are partially overwritten, it can be NULL if all writes are
+     * aligned to 512 bytes. Throws Ep128Emu::Exception if an existing
+     * delta file is invalid or belongs to an image of different size.
+     */
+    DiskImageOverlay(const std::string& overlayDir,
+                     const std::string& imageFileName,
+                     std::FILE *baseFile_, uint64_t baseFileSize_);
+    virtual ~DiskImageOverlay();
+    /*!
+     * Replace the modified parts of 'nBytes' bytes of image data starting
+     * at 'filePos' in 'buf'. Returns false on error reading the delta file.
+     */
+    bool patchData(uint8_t *buf, uint64_t filePos, size_t nBytes);
+    /*!
+     * Store 'nBytes' bytes from 'buf' at 'filePos' in the delta file.
+     * Returns false on error.
+     */
+    bool writeData(const uint8_t *buf, uint64_t filePos, size_t nBytes);
+    /*!
+     * Returns the name of the delta file for 'imageFileName'. The full path
+     * of the image is hashed, so that images with the same base name in
+     * different directories do not share the delta file.
+     */
+    static std::string getDeltaFileName(const std::string& overlayDir,
+                                        const std::string& imageFileName);
+  };
+
+  // --------------------------------------------------------------------------
+
+  /*!
+   * Copy of a disk image file in memory, with flags for the 512 byte
+   * chunks that have been modified since they were last written back.
+   * The file I/O is left to the drive, which knows how to access it.
+   */
+  class DiskImageCache {
+   protected:
+    static const size_t chunkSize = 512;
+    std::vector< uint8_t >  buf;
+    std::vector< uint32_t > dirtyMap;   // one bit per chunk
+    size_t      firstDirtyWord;         // no modified chunks before this
+    bool        dirtyFlag;
+   public:
+    DiskImageCache();
+    virtual ~DiskImageCache();
+    // resize to 'nBytes' bytes and clear the modified flags
+    void resize(size_t nBytes);
+    inline void clear()
+    {
+      resize(0);
+    }
+    inline bool empty() const
+    {
+      return buf.empty();
+    }
+    inline size_t size() const
+    {
+      return buf.size();
+    }
+    inline uint8_t *getData()
+    {
+      return &(buf.front());
+    }
+    inline const uint8_t *getData() const
+    {
+      return &(buf.front());
+    }
+    inline bool isDirty() const
+    {
+      return dirtyFlag;
+    }
+    // copy 'nBytes' bytes from 'src' to 'pos', and mark the chunks modified
+    void writeData(const uint8_t *src, size_t pos, size_t nBytes);
+    /*!
+     * Returns the position and size of the first run of modified chunks,
+     * and clears their flags. Returns false if there are no modified chunks.
+     */
+    bool getDirtyRange(size_t& pos, size_t& nBytes);
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_DISKOVL_HPP
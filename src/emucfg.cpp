@@ -368,6 +368,12 @@ namespace Ep128Emu {
                                   floppy_->sectorsPerTrack, int(-1),
                                   *floppyChanged_, -1.0, 240.0);
     }
+    defineConfigurationVariable(*this, "floppy.overlayDirectory",
+                                floppy.overlayDirectory, std::string(""),
+                                diskOverlaySettingsChanged);
+    defineConfigurationVariable(*this, "floppy.turboMode",
+                                floppy.turboMode, false,
+                                floppyTurboModeChanged);
     // ----------------
     defineConfigurationVariable(*this, "ide.imageFile0",
                                 ide.imageFile0, std::string(""),
@@ -421,6 +427,9 @@ namespace Ep128Emu {
     defineConfigurationVariable(*this, "tape.forceMotorOn",
                                 tape.forceMotorOn, false,
                                 tapeSettingsChanged);
+    defineConfigurationVariable(*this, "tape.loaderTraps",
+                                tape.loaderTraps, false,
+                                tapeSettingsChanged);
     // ----------------
     defineConfigurationVariable(*this, "fileio.workingDirectory",
                                 fileio.workingDirectory, std::string("."),
@@ -711,6 +720,15 @@ namespace Ep128Emu {
     }
     if (mouseSettingsChanged)
       mouseSettingsChanged = false;
+    if (diskOverlaySettingsChanged) {
+      // only affects the disk images opened after this
+      vm_.setDiskOverlayDirectory(floppy.overlayDirectory);
+      diskOverlaySettingsChanged = false;
+    }
+    if (floppyTurboModeChanged) {
+      vm_.setFloppyTurboMode(floppy.turboMode);
+      floppyTurboModeChanged = false;
+    }
     for (int i = 0; i < 4; i++) {
       FloppyDriveSettings&  cfg = (i == 0 ? floppy.a :
                                    (i == 1 ? floppy.b :
@@ -767,6 +785,7 @@ namespace Ep128Emu {
     if (tapeSettingsChanged) {
       vm_.setDefaultTapeSampleRate(tape.defaultSampleRate);
       vm_.setForceTapeMotorOn(tape.forceMotorOn);
+      vm_.setEnableTapeLoaderTraps(tape.loaderTraps);
       tapeSettingsChanged = false;
     }
     if (tapeFileChanged) {
@@ -178,12 +178,19 @@ namespace Ep128Emu {
       FloppyDriveSettings b;
       FloppyDriveSettings c;
       FloppyDriveSettings d;
+      // directory of copy-on-write delta files for floppy and IDE images,
+      // empty: write to the image files
+      std::string overlayDirectory;
+      // skip floppy disk controller delays if the disk is not copy protected
+      bool        turboMode;
     };
     FloppyConfiguration_  floppy;
     bool          floppyAChanged;
     bool          floppyBChanged;
     bool          floppyCChanged;
     bool          floppyDChanged;
+    bool          diskOverlaySettingsChanged;
+    bool          floppyTurboModeChanged;
     // --------
     struct IDEConfiguration_ {
       std::string imageFile0;
@@ -212,6 +219,7 @@ namespace Ep128Emu {
       int         soundFileChannel;
       bool        enableSoundFileFilter;
       bool        forceMotorOn;
+      bool        loaderTraps;
       double      soundFileFilterMinFreq;
       double      soundFileFilterMaxFreq;
     };
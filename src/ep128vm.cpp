@@ -30,6 +30,7 @@
 #include "debuglib.hpp"
 #include "videorec.hpp"
 #include "ide.hpp"
+#include "profiler.hpp"
 #ifdef ENABLE_SDEXT
 #  include "sdext.hpp"
 #endif
@@ -793,12 +794,9 @@ namespace Ep128 {
     do {
       nick.runOneSlot();
       nickCyclesRemainingH--;
-      Ep128VMCallback   *p = firstCallback;
-      while (p) {
-        Ep128VMCallback *nxt = p->nxt;
-        p->func(p->userData);
-        p = nxt;
-      }
+      if (EP128EMU_UNLIKELY(callbackTime >= nextCallbackTime))
+        runCallbacks();
+      callbackTime++;
       daveCyclesRemaining += daveCyclesPerNickCycle;
       if (daveCyclesRemaining >= 0L) {
         do {
@@ -1228,20 +1226,21 @@ namespace Ep128 {
 
 #endif
 
-  void Ep128VM::mouseTimerCallback(void *userData)
+  uint32_t Ep128VM::mouseTimerCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     if (EP128EMU_EXPECT(vm.mouseTimer > 1U)) {
       vm.mouseTimer--;
-      return;
+      return 1U;
     }
     vm.mouseTimer = 0U;
     vm.mouseData = 0ULL;
     vm.setCallback(&mouseTimerCallback, userData, false);
     vm.dave.clearMouseInput();
+    return 1U;
   }
 
-  void Ep128VM::tapeCallback(void *userData)
+  uint32_t Ep128VM::tapeCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     vm.tapeSamplesRemaining += vm.tapeSamplesPerNickCycle;
@@ -1251,9 +1250,17 @@ namespace Ep128 {
       int   daveTapeInput = vm.runTape(int(vm.soundOutputSignal & 0xFFFFU));
       vm.dave.setTapeInput(daveTapeInput, daveTapeInput);
     }
+    // skip the cycles until the next tape sample is due
+    if (vm.tapeSamplesPerNickCycle < 1)
+      return 1U;
+    int64_t n = (-vm.tapeSamplesRemaining) / vm.tapeSamplesPerNickCycle;
+    if (n < 1)
+      return 1U;
+    vm.tapeSamplesRemaining += (n * vm.tapeSamplesPerNickCycle);
+    return uint32_t(n + 1);
   }
 
-  void Ep128VM::demoPlayCallback(void *userData)
+  uint32_t Ep128VM::demoPlayCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     while (!vm.demoTimeCnt) {
@@ -1299,23 +1306,26 @@ namespace Ep128 {
     }
     if (vm.demoTimeCnt)
       vm.demoTimeCnt--;
+    return 1U;
   }
 
-  void Ep128VM::demoRecordCallback(void *userData)
+  uint32_t Ep128VM::demoRecordCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     vm.demoTimeCnt++;
+    return 1U;
   }
 
-  void Ep128VM::videoCaptureCallback(void *userData)
+  uint32_t Ep128VM::videoCaptureCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     vm.videoCapture->runOneCycle(vm.soundOutputSignal + vm.externalDACOutput);
+    return 1U;
   }
 
 #ifdef ENABLE_RESID
 
-  void Ep128VM::sidCallback(void *userData)
+  uint32_t Ep128VM::sidCallback(void *userData)
   {
     Ep128VM&  vm = *(reinterpret_cast<Ep128VM *>(userData));
     int64_t   tmp = vm.daveCyclesRemaining + vm.daveCyclesPerNickCycle;
@@ -1337,6 +1347,7 @@ namespace Ep128 {
         vm.externalDACOutput = uint32_t((outL >> 15) | ((outR >> 15) << 16));
       } while (EP128EMU_UNLIKELY(tmp >= 0L));
     }
+    return 1U;
   }
 
 #endif
@@ -1480,7 +1491,7 @@ namespace Ep128 {
     }
   }
 
-  void Ep128VM::setCallback(void (*func)(void *userData), void *userData_,
+  void Ep128VM::setCallback(uint32_t (*func)(void *userData), void *userData_,
                             bool isEnabled)
   {
     if (!func)
@@ -1508,7 +1519,7 @@ namespace Ep128 {
         p = p->nxt;
       }
       if (!isEnabled) {
-        callbacks[ndx].func = (void (*)(void *)) 0;
+        callbacks[ndx].func = (uint32_t (*)(void *)) 0;
         callbacks[ndx].userData = (void *) 0;
         callbacks[ndx].nxt = (Ep128VMCallback *) 0;
       }
@@ -1517,7 +1528,7 @@ namespace Ep128 {
       return;
     if (ndx < 0) {
       for (size_t i = 0; i < maxCallbacks; i++) {
-        if (callbacks[i].func == (void (*)(void *)) 0) {
+        if (callbacks[i].func == (uint32_t (*)(void *)) 0) {
           ndx = int(i);
           break;
         }
@@ -1528,6 +1539,9 @@ namespace Ep128 {
     callbacks[ndx].func = func;
     callbacks[ndx].userData = userData_;
     callbacks[ndx].nxt = (Ep128VMCallback *) 0;
+    callbacks[ndx].nextTime = callbackTime;
+    if (callbackTime < nextCallbackTime)
+      nextCallbackTime = callbackTime;
     if (isEnabled) {
       Ep128VMCallback   *prv = (Ep128VMCallback *) 0;
       Ep128VMCallback   *p = firstCallback;
@@ -1543,6 +1557,25 @@ namespace Ep128 {
     }
   }
 
+  EP128EMU_REGPARM1 void Ep128VM::runCallbacks()
+  {
+    uint64_t  t = callbackTime;
+    uint64_t  nextTime = ~(uint64_t(0));
+    nextCallbackTime = nextTime;
+    Ep128VMCallback *p = firstCallback;
+    while (p) {
+      Ep128VMCallback *nxt = p->nxt;
+      if (p->nextTime <= t)
+        p->nextTime = t + p->func(p->userData);
+      if (p->nextTime < nextTime)
+        nextTime = p->nextTime;
+      p = nxt;
+    }
+    // setCallback() may have also changed nextCallbackTime
+    if (nextTime < nextCallbackTime)
+      nextCallbackTime = nextTime;
+  }
+
   // --------------------------------------------------------------------------
 
   Ep128VM::Ep128VM(Ep128Emu::VideoDisplay& display_,
@@ -1581,6 +1614,8 @@ namespace Ep128 {
       spectrumEmulatorEnabled(false),
       prvRTCTime(-1L),
       firstCallback((Ep128VMCallback *) 0),
+      callbackTime(0U),
+      nextCallbackTime(~(uint64_t(0))),
       videoCapture((Ep128Emu::VideoCapture *) 0),
       nickCyclesPerCPUCycleD2(0U),
       videoMemoryWaitMult(0U),
@@ -1625,7 +1660,7 @@ namespace Ep128 {
     memory.setSDExtPtr(&sdext);
 #endif
     for (size_t i = 0; i < (sizeof(callbacks) / sizeof(Ep128VMCallback)); i++) {
-      callbacks[i].func = (void (*)(void *)) 0;
+      callbacks[i].func = (uint32_t (*)(void *)) 0;
       callbacks[i].userData = (void *) 0;
       callbacks[i].nxt = (Ep128VMCallback *) 0;
     }
@@ -1723,6 +1758,7 @@ namespace Ep128 {
 
   void Ep128VM::run(size_t microseconds)
   {
+    EP128EMU_PROFILE_SCOPE(PROFILER_VM_RUN);
     Ep128Emu::VirtualMachine::run(microseconds);
     if (snapshotLoadFlag) {
       snapshotLoadFlag = false;
@@ -1752,12 +1788,9 @@ namespace Ep128 {
     if (EP128EMU_UNLIKELY(nickCyclesRemainingH < 1))
       return;
     do {
-      Ep128VMCallback   *p = firstCallback;
-      while (p) {
-        Ep128VMCallback *nxt = p->nxt;
-        p->func(p->userData);
-        p = nxt;
-      }
+      if (EP128EMU_UNLIKELY(callbackTime >= nextCallbackTime))
+        runCallbacks();
+      callbackTime++;
       daveCyclesRemaining += daveCyclesPerNickCycle;
       if (daveCyclesRemaining >= 0L) {
         do {
@@ -1774,6 +1807,7 @@ namespace Ep128 {
         z80.executeInstruction();
       nick.runOneSlot();
     } while (EP128EMU_EXPECT(--nickCyclesRemainingH > 0));
+    flushAudioOutput();
   }
 
   void Ep128VM::reset(bool isColdReset)
@@ -1982,6 +2016,7 @@ namespace Ep128 {
   void Ep128VM::getVMStatus(VMStatus& vmStatus_)
   {
     vmStatus_.tapeReadOnly = getIsTapeReadOnly();
+    vmStatus_.tapeMotorOn = (getIsTapeMotorOn() && getTapeButtonState() != 0);
     vmStatus_.tapePosition = getTapePosition();
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
@@ -2174,6 +2209,13 @@ namespace Ep128 {
     }
   }
 
+  void Ep128VM::setDiskOverlayDirectory(const std::string& dirName)
+  {
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].setOverlayDirectory(dirName);
+    ideInterface->setOverlayDirectory(dirName);
+  }
+
   uint32_t Ep128VM::getFloppyDriveLEDState()
   {
     uint32_t  n = 0U;
@@ -2514,3 +2556,10 @@ namespace Ep128 {
 
 }       // namespace Ep128
 
+
+// The Z80 instruction decoder is instantiated here, so that it can call the
+// memory and I/O functions of Ep128VM::Z80_ directly.
+
+#include "z80core.hpp"
+
+template class Ep128::Z80Core<Ep128::Ep128VM::Z80_>;
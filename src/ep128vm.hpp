@@ -130,7 +130,7 @@ namespace Ep128 {
       virtual void vsyncStateChange(bool newState, unsigned int currentSlot_);
     };
     // ----------------
-    Z80_      z80;
+    Z80Core<Z80_>  z80;
     Memory_   memory;
     IOPorts_  ioPorts;
     Dave_     dave;
@@ -190,12 +190,16 @@ namespace Ep128 {
     uint8_t   cmosMemory[64];
     int64_t   prvRTCTime;
     struct Ep128VMCallback {
-      void      (*func)(void *);
+      uint32_t  (*func)(void *);
       void      *userData;
       Ep128VMCallback *nxt;
+      uint64_t  nextTime;
     };
     Ep128VMCallback   callbacks[16];
     Ep128VMCallback   *firstCallback;
+    // current NICK cycle, and the earliest time a callback is due
+    uint64_t  callbackTime;
+    uint64_t  nextCallbackTime;
     Ep128Emu::VideoCapture  *videoCapture;
     uint8_t   externalDACIOPorts[4];
     uint32_t  nickCyclesPerCPUCycleD2;  // in 2^-31 NICK cycle units
@@ -288,16 +292,25 @@ namespace Ep128 {
                                      uint16_t addr, uint8_t value);
     static uint8_t sidPortDebugReadCallback(void *userData, uint16_t addr);
 #endif
-    static void mouseTimerCallback(void *userData);
-    static void tapeCallback(void *userData);
-    static void demoPlayCallback(void *userData);
-    static void demoRecordCallback(void *userData);
-    static void videoCaptureCallback(void *userData);
+    static uint32_t mouseTimerCallback(void *userData);
+    static uint32_t tapeCallback(void *userData);
+    static uint32_t demoPlayCallback(void *userData);
+    static uint32_t demoRecordCallback(void *userData);
+    static uint32_t videoCaptureCallback(void *userData);
 #ifdef ENABLE_RESID
-    static void sidCallback(void *userData);
+    static uint32_t sidCallback(void *userData);
 #endif
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
+    // write the state of the machine that is not stored by the components
+    void saveVMState(Ep128Emu::File::Buffer& buf);
+    // if 'isDelta' is true, only the changed memory blocks are stored
+    void saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    void restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    // state that is only stored in checkpoints: the time remaining from
+    // the last run() call, and the tape and disk drive emulation
+    void saveDeviceCheckpoint_();
+    void restoreDeviceCheckpoint_();
     uint8_t checkSingleStepModeBreak();
     void spectrumEmulatorNMI_AttrWrite(uint32_t addr, uint8_t value);
     void updateRTC();
@@ -305,8 +318,12 @@ namespace Ep128 {
     void resetFloppyDrives(bool isColdReset);
     // Set function to be called at every NICK cycle. The functions are called
     // in the order of being registered; up to 16 callbacks can be set.
-    void setCallback(void (*func)(void *userData), void *userData_,
+    // Each function returns the number of NICK cycles after which it is to
+    // be called again (1 = next cycle).
+    void setCallback(uint32_t (*func)(void *userData), void *userData_,
                      bool isEnabled);
+    // call the functions that are due at the current NICK cycle
+    EP128EMU_REGPARM1 void runCallbacks();
    public:
     Ep128VM(Ep128Emu::VideoDisplay&, Ep128Emu::AudioOutput&);
     virtual ~Ep128VM();
@@ -441,6 +458,7 @@ namespace Ep128 {
     virtual void setDiskImageFile(int n, const std::string& fileName_,
                                   int nTracks_ = -1, int nSides_ = 2,
                                   int nSectorsPerTrack_ = 9);
+    virtual void setDiskOverlayDirectory(const std::string& dirName);
     /*!
      * Returns the current state of the disk drive LEDs, which is the sum
      * of any of the following values:
@@ -657,6 +675,15 @@ namespace Ep128 {
      * playing a demo.
      */
     virtual bool getIsPlayingDemo() const;
+    /*!
+     * Save or restore a checkpoint of the virtual machine state for
+     * run-ahead (see Ep128Emu::VirtualMachine::saveCheckpoint()).
+     */
+    virtual void saveCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void clearMemoryDirtyBlocks();
+    virtual void saveDeltaCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreDeltaCheckpoint(Ep128Emu::File::Buffer&);
     // ----------------
     virtual void loadState(Ep128Emu::File::Buffer&);
     virtual void loadMachineConfiguration(Ep128Emu::File::Buffer&);
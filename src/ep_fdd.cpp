@@ -189,6 +189,8 @@ namespace Ep128Emu {
   FloppyDrive::FloppyDrive()
     : imageFileName(""),
       imageFile((std::FILE *) 0),
+      overlayDirectory(""),
+      overlay((DiskImageOverlay *) 0),
       nTracks(0),
       nSides(0),
       nSectorsPerTrack(0),
@@ -240,6 +242,12 @@ namespace Ep128Emu {
     if (!imageFile)
       return;
     (void) flushTrack();                // FIXME: errors are ignored here
+    (void) writeImageFile();
+    imageCache.clear();
+    if (overlay) {
+      delete overlay;
+      overlay = (DiskImageOverlay *) 0;
+    }
     std::fclose(imageFile);
     imageFile = (std::FILE *) 0;
     nTracks = 0;
@@ -255,6 +263,28 @@ namespace Ep128Emu {
     buf_.resize(0);
   }
 
+  bool FloppyDrive::writeImageFile()
+  {
+    bool    errorFlag = false;
+    size_t  filePos = 0;
+    size_t  nBytes = 0;
+    while (imageCache.getDirtyRange(filePos, nBytes)) {
+      const uint8_t *buf = imageCache.getData() + filePos;
+      if (overlay) {
+        if (!overlay->writeData(buf, uint64_t(filePos), nBytes))
+          errorFlag = true;
+      }
+      else if (std::fseek(imageFile, long(filePos), SEEK_SET) < 0) {
+        errorFlag = true;
+      }
+      else if (std::fwrite(buf, sizeof(uint8_t), nBytes, imageFile)
+               != nBytes) {
+        errorFlag = true;
+      }
+    }
+    return (!errorFlag);
+  }
+
   void FloppyDrive::setDiskImageFile(const std::string& fileName_,
                                      int nTracks_, int nSides_,
                                      int nSectorsPerTrack_)
@@ -278,10 +308,15 @@ namespace Ep128Emu {
                 (nSectorsPerTrack_ >= 1 && nSectorsPerTrack_ <= 240);
     bool    disableFATCheck =
         (nTracksValid && nSidesValid && nSectorsPerTrackValid);
+    // real floppy disks are always accessed directly
+    bool    isImageFile = true;
+    bool    useOverlay = !overlayDirectory.empty();
     {
       int     diskType = checkFloppyDisk(fileName_.c_str(),
                                          nTracks_, nSides_, nSectorsPerTrack_);
       if (diskType > 0) {
+        isImageFile = false;
+        useOverlay = false;
         writeProtectFlag = (diskType == 1);
         nTracksValid = true;
         nSidesValid = true;
@@ -296,12 +331,12 @@ namespace Ep128Emu {
       }
     }
     try {
-      if (!writeProtectFlag)
+      if (!(writeProtectFlag || useOverlay))
         imageFile = std::fopen(fileName_.c_str(), "r+b");
       if (!imageFile) {
         imageFile = std::fopen(fileName_.c_str(), "rb");
         if (imageFile)
-          writeProtectFlag = true;
+          writeProtectFlag = !useOverlay;
         else
           throw Exception("FDD: error opening disk image file");
       }
@@ -391,6 +426,26 @@ namespace Ep128Emu {
                         "disk image size parameters");
       }
       std::fseek(imageFile, 0L, SEEK_SET);
+      if (useOverlay) {
+        // all writes are whole sectors, so the image is not read by the
+        // overlay (which would not work with the file handles on Windows)
+        overlay = new DiskImageOverlay(overlayDirectory, fileName_,
+                                       (std::FILE *) 0, uint64_t(fileSize));
+      }
+      if (isImageFile) {
+        // read the whole image, so that changing tracks does no file I/O
+        imageCache.resize(size_t(fileSize));
+        if (std::fread(imageCache.getData(), sizeof(uint8_t),
+                       size_t(fileSize), imageFile) != size_t(fileSize)) {
+          throw Exception("FDD: error reading disk image file");
+        }
+        if (overlay) {
+          if (!overlay->patchData(imageCache.getData(), 0U,
+                                  size_t(fileSize))) {
+            throw Exception("FDD: error reading disk image overlay file");
+          }
+        }
+      }
       imageFileName = fileName_;
       buf_.resize(size_t(nSectorsPerTrack_) * 257);
     }
@@ -419,6 +474,54 @@ namespace Ep128Emu {
     bufPos = -1L;
   }
 
+  void FloppyDrive::saveState(File::Buffer& buf)
+  {
+    buf.writeByte(currentTrack);
+    buf.writeByte(currentSide);
+    buf.writeBoolean(diskChangeFlag);
+    buf.writeByte(bufferedTrack);
+    buf.writeByte(bufferedSide);
+    buf.writeBoolean(motorOnInput);
+    buf.writeBoolean(isMotorOn);
+    buf.writeUInt32(ledStateCounter);
+    buf.writeInt32(int32_t(bufPos));
+    buf.writeBoolean(trackDirtyFlag);
+    // track buffer followed by the sector flags
+    uint8_t nSectors = (trackBuffer ? nSectorsPerTrack : uint8_t(0));
+    buf.writeByte(nSectors);
+    buf.writeData(trackBuffer, size_t(nSectors) * 513);
+  }
+
+  void FloppyDrive::loadState(File::Buffer& buf)
+  {
+    currentTrack = buf.readByte();
+    currentSide = buf.readByte();
+    diskChangeFlag = buf.readBoolean();
+    bufferedTrack = buf.readByte();
+    bufferedSide = buf.readByte();
+    motorOnInput = buf.readBoolean();
+    isMotorOn = buf.readBoolean();
+    ledStateCounter = buf.readUInt32();
+    bufPos = long(buf.readInt32());
+    trackDirtyFlag = buf.readBoolean();
+    uint8_t nSectors = buf.readByte();
+    size_t  nBytes = size_t(nSectors) * 513;
+    if (trackBuffer && nSectors == nSectorsPerTrack) {
+      buf.readData(trackBuffer, nBytes);
+      return;
+    }
+    if (nBytes > (buf.getDataSize() - buf.getPosition()))
+      throw Exception("unexpected end of data chunk");
+    buf.setPosition(buf.getPosition() + nBytes);
+    // the buffer is not valid for the current disk
+    bufferedTrack = 0xFF;
+    bufferedSide = 0xFF;
+    bufPos = -1L;
+    if (trackBuffer)
+      clearFlagsBuffer();
+    trackDirtyFlag = false;
+  }
+
   void FloppyDrive::copySector(int n)
   {
     if (n < 1 || n > int(nSectorsPerTrack) || flagsBuffer[n - 1] != 0x00)
@@ -498,7 +601,11 @@ namespace Ep128Emu {
       long    filePos = (long(currentTrack) * long(nSides) + long(currentSide))
                         * long(nSectorsPerTrack);
       filePos = (filePos * 512L) + long(offs);
-      if (std::fseek(imageFile, filePos, SEEK_SET) < 0) {
+      if (!imageCache.empty()) {
+        std::memcpy(&(tmpBuffer[offs]), imageCache.getData() + filePos,
+                    nBytes);
+      }
+      else if (std::fseek(imageFile, filePos, SEEK_SET) < 0) {
         errorFlag = true;
       }
       else {
@@ -547,7 +654,11 @@ namespace Ep128Emu {
           (long(bufferedTrack) * long(nSides) + long(bufferedSide))
           * (long(nSectorsPerTrack) * 512L)
           + long(offs);
-      if (std::fseek(imageFile, filePos, SEEK_SET) < 0) {
+      if (!imageCache.empty()) {
+        // written to the file later by writeImageFile()
+        imageCache.writeData(&(trackBuffer[offs]), size_t(filePos), nBytes);
+      }
+      else if (std::fseek(imageFile, filePos, SEEK_SET) < 0) {
         errorFlag = true;
       }
       else {
@@ -565,13 +676,14 @@ namespace Ep128Emu {
     if (EP128EMU_UNLIKELY(ledStateCounter == 0U))
       return 0x00;
     if (ledStateCounter > ledStateCount1) {
-      if (!trackDirtyFlag) {
+      if (!(trackDirtyFlag || imageCache.isDirty())) {
         ledStateCounter = 0U;
         return 0x00;
       }
       if (--ledStateCounter == ledStateCount1) {
         ledStateCounter++;
         (void) flushTrack();            // FIXME: errors are ignored here
+        (void) writeImageFile();
         ledStateCounter = 0U;
         return 0x00;
       }
@@ -583,7 +695,7 @@ namespace Ep128Emu {
     }
     else if (--ledStateCounter == 0U) {
       isMotorOn = false;
-      if (trackDirtyFlag) {
+      if (trackDirtyFlag || imageCache.isDirty()) {
         ledStateCounter = ledStateCount2;
         return 0x01;
       }
@@ -595,6 +707,7 @@ namespace Ep128Emu {
   void FloppyDrive::reset()
   {
     (void) flushTrack();                // FIXME: errors are ignored here
+    (void) writeImageFile();
     currentTrack = 0;
     currentSide = 0;
     bufferedTrack = 0xFF;
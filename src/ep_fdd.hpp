@@ -21,6 +21,7 @@
 #define EP128EMU_EP_FDD_HPP
 
 #include "ep128emu.hpp"
+#include "diskovl.hpp"
 #include <vector>
 
 namespace Ep128Emu {
@@ -45,6 +46,10 @@ namespace Ep128Emu {
     static const uint32_t ledStateCount2 = 528U;        // 1056 ms
     std::string imageFileName;
     std::FILE   *imageFile;
+    std::string overlayDirectory;
+    DiskImageOverlay  *overlay;         // NULL if writing to the image file
+    // copy of the image in memory, empty for real floppy disks
+    DiskImageCache    imageCache;
     uint8_t     nTracks;
     uint8_t     nSides;
     uint8_t     nSectorsPerTrack;
@@ -67,6 +72,8 @@ namespace Ep128Emu {
     bool        trackDirtyFlag;
     // ----------------
     void closeDiskImage();
+    // write the sectors modified in imageCache to the file or overlay
+    bool writeImageFile();
     uint8_t getLEDState_();
    public:
     FloppyDrive();
@@ -75,6 +82,12 @@ namespace Ep128Emu {
                                   int nTracks_ = -1,
                                   int nSides_ = 2,
                                   int nSectorsPerTrack_ = 9);
+    // if 'dirName' is not empty, disk image files opened later are not
+    // modified, written sectors are stored in a delta file in 'dirName'
+    inline void setOverlayDirectory(const std::string& dirName)
+    {
+      overlayDirectory = dirName;
+    }
     inline void setDiskChangeFlag(bool isChanged)
     {
       diskChangeFlag = isChanged;
@@ -180,6 +193,11 @@ namespace Ep128Emu {
     // pad the rest of the current sector with zero bytes
     // called when a write command is aborted
     void padSector();
+    // save and restore the drive state for virtual machine checkpoints,
+    // the disk image is not included; buffered track data is discarded if
+    // a different disk is inserted when the state is restored
+    void saveState(File::Buffer& buf);
+    void loadState(File::Buffer& buf);
    private:
     void copySector(int n);
     void clearDirtyFlag();
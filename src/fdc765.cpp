@@ -160,7 +160,10 @@ namespace CPC464 {
       fdcState = 2;
       dataDirectionIsRead = !(cmdParams.commandCode & 0x01);
       dataIsNotReady = true;
-      headLoadTimer = (headUnloadTimer > 0 ? uint8_t(0) : headLoadTime);
+      fastTransfer = isTurboDrive(cmdParams.unitNumber);
+      dataAccessed = false;
+      headLoadTimer = (headUnloadTimer > 0 || fastTransfer ?
+                       uint8_t(0) : headLoadTime);
       headUnloadTimer = 0;
       indexPulsesRemaining = 2;
       if ((cmdParams.commandCode & 0x80) != 0 &&
@@ -190,7 +193,8 @@ namespace CPC464 {
       }
       else {
         recalibrateSteps[cmdParams.unitNumber] = 77;
-        seekTimers[cmdParams.unitNumber] = stepRate;
+        seekTimers[cmdParams.unitNumber] =
+            (isTurboDrive(cmdParams.unitNumber) ? uint8_t(0) : stepRate);
       }
       fdcState = 0;
       break;
@@ -210,7 +214,8 @@ namespace CPC464 {
         seekComplete(cmdParams.unitNumber, false, false);
       }
       else {
-        seekTimers[cmdParams.unitNumber] = stepRate;
+        seekTimers[cmdParams.unitNumber] =
+            (isTurboDrive(cmdParams.unitNumber) ? uint8_t(0) : stepRate);
       }
       fdcState = 0;
       break;
@@ -439,6 +444,24 @@ namespace CPC464 {
     }
   }
 
+  void FDC765::nextDataByte()
+  {
+    if (EP128EMU_UNLIKELY(!dataIsNotReady)) {
+      statusRegister1 = statusRegister1 | 0x10;         // overrun
+      if ((cmdParams.commandCode & 0x13) == 0x01)
+        sectorBuf[totalDataBytes - dataBytesRemaining] = 0x00;
+    }
+    dataBytesRemaining--;
+    if (EP128EMU_UNLIKELY(dataBytesRemaining < 1U)) {
+      // data transfer complete, next sector or result phase after data CRC
+      sectorDelay = 2;
+    }
+    else {
+      // continue with next byte
+      dataIsNotReady = false;
+    }
+  }
+
   EP128EMU_REGPARM1 void FDC765::runExecutionPhase()
   {
     if (indexPulsesRemaining > 0) {
@@ -475,6 +498,24 @@ namespace CPC464 {
         sectorDelay = (sectorDelay >= 0 ?
                        (sectorDelay + 4 + 4 + 2)
                        : (sectorDelay + CPCDISK_TRACK_SIZE + 4 + 4 + 2));
+        if (fastTransfer) {
+          // turbo mode: rotate the disk to the sector ID immediately,
+          // but still count the index pulses passed
+          int     indexDelay = (CPCDISK_TRACK_SIZE - (80 + 12 + 4 + 50 + 12))
+                               - rotationAngles[cmdParams.unitNumber];
+          if (indexDelay <= 0)
+            indexDelay += CPCDISK_TRACK_SIZE;
+          for ( ; indexDelay <= sectorDelay; indexDelay += CPCDISK_TRACK_SIZE) {
+            if (--indexPulsesRemaining < 1) {
+              startResultPhase(CPCDISK_ERROR_SECTOR_NOT_FOUND);
+              return;
+            }
+          }
+          rotationAngles[cmdParams.unitNumber] =
+              (rotationAngles[cmdParams.unitNumber] + sectorDelay)
+              % CPCDISK_TRACK_SIZE;
+          sectorDelay = 0;
+        }
       }
       if (sectorDelay > 0) {
         // head position is not yet at the ID address mark of the next sector
@@ -482,6 +523,16 @@ namespace CPC464 {
       }
       // found a sector, check its ID
       checkSectorHeader();
+      if (fastTransfer && fdcState == 2 && indexPulsesRemaining < 1) {
+        // turbo mode: the data is available now, and the disk is rotated
+        // to the end of the sector
+        rotationAngles[cmdParams.unitNumber] =
+            (rotationAngles[cmdParams.unitNumber] + sectorDelay
+             + int(totalDataBytes) + 2) % CPCDISK_TRACK_SIZE;
+        sectorDelay = 0;
+        dataIsNotReady = false;
+        dataAccessed = false;
+      }
     }
     else if (dataBytesRemaining > 0U) {
       if (EP128EMU_UNLIKELY(sectorDelay > 0)) {
@@ -489,21 +540,15 @@ namespace CPC464 {
           dataIsNotReady = false;
         return;
       }
-      // sector data transfer to/from CPU
-      if (EP128EMU_UNLIKELY(!dataIsNotReady)) {
-        statusRegister1 = statusRegister1 | 0x10;       // overrun
-        if ((cmdParams.commandCode & 0x13) == 0x01)
-          sectorBuf[totalDataBytes - dataBytesRemaining] = 0x00;
-      }
-      dataBytesRemaining--;
-      if (EP128EMU_UNLIKELY(dataBytesRemaining < 1U)) {
-        // data transfer complete, next sector or result phase after data CRC
-        sectorDelay = 2;
-      }
-      else {
-        // continue with next byte
-        dataIsNotReady = false;
+      if (fastTransfer && dataAccessed) {
+        // turbo mode: the CPU is transferring data, the next byte is made
+        // available by the data register access; the overrun timing is
+        // only used if the CPU stops polling
+        dataAccessed = false;
+        return;
       }
+      // sector data transfer to/from CPU
+      nextDataByte();
     }
     else {
       if (sectorDelay > 0) {
@@ -550,6 +595,7 @@ namespace CPC464 {
         if (motorSpeed <= 1) {
           motorSpeed = 0;
           motorStateChanging = false;
+          motorStopped();
         }
         else if (--motorSpeed == 99) {
           updateDriveReadyStatus();
@@ -575,7 +621,7 @@ namespace CPC464 {
         else if (seekTimers[i] > 1) {
           seekTimers[i]--;
         }
-        else if (stepRate < 1) {
+        else if (stepRate < 1 || isTurboDrive(i)) {
           // no seek time emulation
           stepOut(i, recalibrateSteps[i]);
           seekComplete(i, true, false);
@@ -597,7 +643,7 @@ namespace CPC464 {
         else if (seekTimers[i] > 1) {
           seekTimers[i]--;
         }
-        else if (stepRate < 1) {
+        else if (stepRate < 1 || isTurboDrive(i)) {
           // no seek time emulation
           stepIn(i,
                  int(newCylinderNumbers[i]) - int(presentCylinderNumbers[i]));
@@ -622,6 +668,10 @@ namespace CPC464 {
     timeCounter2ms = 63;
   }
 
+  void FDC765::motorStopped()
+  {
+  }
+
   // --------------------------------------------------------------------------
 
   FDC765::FDC765()
@@ -645,7 +695,10 @@ namespace CPC464 {
       statusRegister2(0x00),
       sectorDelay(-1),
       physicalSector(0),
-      sectorBuf((uint8_t *) 0)
+      sectorBuf((uint8_t *) 0),
+      turboMode(false),
+      fastTransfer(false),
+      dataAccessed(false)
   {
     std::memset(&cmdParams, 0x00, sizeof(FDCCommandParams));
     for (int i = 0; i < 4; i++) {
@@ -689,6 +742,8 @@ namespace CPC464 {
     statusRegister2 = 0x00;
     sectorDelay = -1;
     physicalSector = 0;
+    fastTransfer = false;
+    dataAccessed = false;
     for (int i = 0; i < 4; i++) {
       newCylinderNumbers[i] = presentCylinderNumbers[i];
       recalibrateSteps[i] = 0;
@@ -697,6 +752,113 @@ namespace CPC464 {
     }
   }
 
+  void FDC765::saveState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.writeByte(cmdParams.commandCode);
+    buf.writeByte(cmdParams.unitNumber);
+    buf.writeByte(cmdParams.physicalSide);
+    buf.writeByte(cmdParams.cylinderID);
+    buf.writeByte(cmdParams.headID);
+    buf.writeByte(cmdParams.sectorID);
+    buf.writeByte(cmdParams.sectorSizeCode);
+    buf.writeByte(cmdParams.lastSectorID);
+    buf.writeByte(cmdParams.gapLen);
+    buf.writeByte(cmdParams.sectorDataLength);
+    buf.writeByte(cmdParams.sectorCnt);
+    buf.writeByte(cmdParams.fillerByte);
+    buf.writeUInt32(totalDataBytes);
+    buf.writeUInt32(dataBytesRemaining);
+    buf.writeByte(fdcState);
+    buf.writeBoolean(dataDirectionIsRead);
+    buf.writeBoolean(dataIsNotReady);
+    buf.writeBoolean(motorOn);
+    buf.writeByte(timeCounter2ms);
+    buf.writeByte(motorSpeed);
+    buf.writeBoolean(motorStateChanging);
+    buf.writeByte(stepRate);
+    buf.writeByte(headUnloadTime);
+    buf.writeByte(headLoadTime);
+    buf.writeByte(headUnloadTimer);
+    buf.writeByte(headLoadTimer);
+    buf.writeByte(indexPulsesRemaining);
+    buf.writeBoolean(multiTrackFlag);
+    buf.writeByte(statusRegister1);
+    buf.writeByte(statusRegister2);
+    buf.writeInt32(int32_t(sectorDelay));
+    buf.writeByte(physicalSector);
+    for (int i = 0; i < 4; i++) {
+      buf.writeByte(presentCylinderNumbers[i]);
+      buf.writeByte(newCylinderNumbers[i]);
+      buf.writeByte(recalibrateSteps[i]);
+      buf.writeByte(seekTimers[i]);
+      buf.writeBoolean(driveReady[i]);
+      buf.writeByte(interruptStatus[i]);
+      buf.writeInt32(int32_t(rotationAngles[i]));
+    }
+    buf.writeBoolean(fastTransfer);
+    buf.writeBoolean(dataAccessed);
+    // sector buffer, only the part used by the current command
+    uint32_t  nBytes = (totalDataBytes < 0x4000U ? totalDataBytes : 0x4000U);
+    if (fdcState == 0)
+      nBytes = 0U;
+    buf.writeUInt32(nBytes);
+    buf.writeData(sectorBuf, nBytes);
+  }
+
+  void FDC765::loadState(Ep128Emu::File::Buffer& buf)
+  {
+    cmdParams.commandCode = buf.readByte();
+    cmdParams.unitNumber = buf.readByte() & 3;
+    cmdParams.physicalSide = buf.readByte();
+    cmdParams.cylinderID = buf.readByte();
+    cmdParams.headID = buf.readByte();
+    cmdParams.sectorID = buf.readByte();
+    cmdParams.sectorSizeCode = buf.readByte();
+    cmdParams.lastSectorID = buf.readByte();
+    cmdParams.gapLen = buf.readByte();
+    cmdParams.sectorDataLength = buf.readByte();
+    cmdParams.sectorCnt = buf.readByte();
+    cmdParams.fillerByte = buf.readByte();
+    totalDataBytes = buf.readUInt32();
+    dataBytesRemaining = buf.readUInt32();
+    if (dataBytesRemaining > totalDataBytes || totalDataBytes > 0x4000U)
+      throw Ep128Emu::Exception("invalid FDC data size in checkpoint");
+    fdcState = buf.readByte() & 3;
+    dataDirectionIsRead = buf.readBoolean();
+    dataIsNotReady = buf.readBoolean();
+    motorOn = buf.readBoolean();
+    timeCounter2ms = buf.readByte();
+    motorSpeed = buf.readByte();
+    motorStateChanging = buf.readBoolean();
+    stepRate = buf.readByte();
+    headUnloadTime = buf.readByte();
+    headLoadTime = buf.readByte();
+    headUnloadTimer = buf.readByte();
+    headLoadTimer = buf.readByte();
+    indexPulsesRemaining = buf.readByte();
+    multiTrackFlag = buf.readBoolean();
+    statusRegister1 = buf.readByte();
+    statusRegister2 = buf.readByte();
+    sectorDelay = int(buf.readInt32());
+    physicalSector = buf.readByte();
+    for (int i = 0; i < 4; i++) {
+      presentCylinderNumbers[i] = buf.readByte();
+      newCylinderNumbers[i] = buf.readByte();
+      recalibrateSteps[i] = buf.readByte();
+      seekTimers[i] = buf.readByte();
+      driveReady[i] = buf.readBoolean();
+      interruptStatus[i] = buf.readByte();
+      int32_t tmp = buf.readInt32();
+      rotationAngles[i] = (tmp >= 0 && tmp < CPCDISK_TRACK_SIZE ? int(tmp) : 0);
+    }
+    fastTransfer = buf.readBoolean();
+    dataAccessed = buf.readBoolean();
+    uint32_t  nBytes = buf.readUInt32();
+    if (nBytes > 0x4000U)
+      throw Ep128Emu::Exception("invalid FDC data size in checkpoint");
+    buf.readData(sectorBuf, nBytes);
+  }
+
   uint8_t FDC765::readMainStatusRegister() const
   {
     uint8_t retval = (uint8_t(fdcState != 0) << 4)
@@ -721,6 +883,10 @@ namespace CPC464 {
         retval = sectorBuf[totalDataBytes - dataBytesRemaining];
         if (fdcState == 2) {            // execution phase of R/W command
           dataIsNotReady = true;
+          if (fastTransfer) {           // turbo mode: next byte is ready now
+            dataAccessed = true;
+            nextDataByte();
+          }
           return retval;
         }
         dataBytesRemaining--;
@@ -905,6 +1071,10 @@ namespace CPC464 {
           (*dataPtr) = n;
         }
         dataIsNotReady = true;
+        if (fastTransfer) {             // turbo mode: next byte is ready now
+          dataAccessed = true;
+          nextDataByte();
+        }
       }
     }
   }
@@ -103,6 +103,9 @@ namespace CPC464 {
     bool      driveReady[4];
     uint8_t   interruptStatus[4];
     int       rotationAngles[4];        // 0 to CPCDISK_TRACK_SIZE-1
+    bool      turboMode;                // skip delays if not copy protected
+    bool      fastTransfer;             // turbo mode for the current command
+    bool      dataAccessed;             // CPU access since the last byte time
     // ----------------
     void startResultPhase(CPCDiskError errorCode);
     void processFDCCommand();
@@ -110,12 +113,23 @@ namespace CPC464 {
     void seekComplete(int driveNum, bool isRecalibrate, bool isNotReady);
     bool incrementSectorID();
     void checkSectorHeader();
+    void nextDataByte();
+    inline bool isTurboDrive(int driveNum) const
+    {
+      return (turboMode && !getIsCopyProtected(driveNum));
+    }
     EP128EMU_REGPARM1 void runExecutionPhase();
     EP128EMU_REGPARM1 void updateDrives();
+    // called when the motor has stopped, can be used for writing any
+    // cached data to the disk images
+    virtual void motorStopped();
    public:
     FDC765();
     virtual ~FDC765();
     virtual void reset();
+    // save and restore the controller state for virtual machine checkpoints
+    virtual void saveState(Ep128Emu::File::Buffer& buf);
+    virtual void loadState(Ep128Emu::File::Buffer& buf);
     // run floppy drive emulation (should be called at a rate of 31250 Hz)
     EP128EMU_INLINE void runOneByte()
     {
@@ -146,6 +160,16 @@ namespace CPC464 {
         motorStateChanging = true;
       }
     }
+    /*!
+     * If enabled, data bytes of read/write commands are available as soon
+     * as the previous one has been transferred by the CPU, and head load,
+     * seek and rotational delays are skipped. Drives with a disk that has
+     * copy protection features still use accurate timing.
+     */
+    inline void setTurboMode(bool isEnabled)
+    {
+      turboMode = isEnabled;
+    }
     virtual uint8_t readMainStatusRegister() const;
     virtual uint8_t readDataRegister();
     virtual void writeDataRegister(uint8_t n);
@@ -163,6 +187,7 @@ namespace CPC464 {
     virtual bool haveDisk(int driveNum) const = 0;
     virtual bool getIsTrack0(int driveNum) const = 0;
     virtual bool getIsWriteProtected(int driveNum) const = 0;
+    virtual bool getIsCopyProtected(int driveNum) const = 0;
     virtual uint8_t getPhysicalTrackSectors(int c) const = 0;
     virtual uint8_t getCurrentTrackSectors() const = 0;
     // returns the ID (C, H, R, N) of the physical sector specified by c, s
@@ -212,8 +212,8 @@ namespace Ep128Emu {
       size_t        newSize = ((allocSize + (allocSize >> 3)) | 255) + 1;
       unsigned char *newBuf = new unsigned char[newSize];
       if (buf) {
-        for (size_t i = 0; i < dataSize; i++)
-          newBuf[i] = buf[i];
+        if (dataSize)
+          std::memcpy(newBuf, buf, dataSize);
         delete[] buf;
       }
       buf = newBuf;
@@ -354,19 +354,29 @@ namespace Ep128Emu {
       } while (newSize < (curPos + nBytes));
       unsigned char *newBuf = new unsigned char[newSize];
       if (buf) {
-        for (size_t i = 0; i < dataSize; i++)
-          newBuf[i] = buf[i];
+        if (dataSize)
+          std::memcpy(newBuf, buf, dataSize);
         delete[] buf;
       }
       buf = newBuf;
       allocSize = newSize;
     }
-    for (size_t i = 0; i < nBytes; i++)
-      buf[curPos++] = buf_[i] & 0xFF;
+    if (nBytes)
+      std::memcpy(&(buf[curPos]), buf_, nBytes);
+    curPos += nBytes;
     if (curPos > dataSize)
       dataSize = curPos;
   }
 
+  void File::Buffer::readData(unsigned char *buf_, size_t nBytes)
+  {
+    if (nBytes > (dataSize - curPos))
+      throw Exception("unexpected end of data chunk");
+    if (nBytes)
+      std::memcpy(buf_, &(buf[curPos]), nBytes);
+    curPos += nBytes;
+  }
+
   void File::Buffer::setPosition(size_t pos)
   {
     if (pos > dataSize) {
@@ -377,8 +387,8 @@ namespace Ep128Emu {
         } while (newSize < pos);
         unsigned char *newBuf = new unsigned char[newSize];
         if (buf) {
-          for (size_t i = 0; i < dataSize; i++)
-            newBuf[i] = buf[i];
+          if (dataSize)
+            std::memcpy(newBuf, buf, dataSize);
           delete[] buf;
         }
         buf = newBuf;
@@ -401,6 +411,12 @@ namespace Ep128Emu {
     allocSize = 0;
   }
 
+  void File::Buffer::truncate()
+  {
+    curPos = 0;
+    dataSize = 0;
+  }
+
   // --------------------------------------------------------------------------
 
   void File::loadZXSnapshotFile(std::FILE *f, const char *fileName)
@@ -581,10 +597,8 @@ namespace Ep128Emu {
   File::File(unsigned char * data, size_t size)
   {
     // Copy contents to buffer directly. Header is ignored.
-    for (size_t i = 16; i < size; i++)
-    {
-      buf.writeByte((unsigned char) (data[i] & 0xFF));
-    }
+    if (size > 16)
+      buf.writeData(data + 16, size - 16);
     buf.setPosition(0);
   }
 
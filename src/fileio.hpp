@@ -43,6 +43,7 @@ namespace Ep128Emu {
       uint64_t readUIntVLen();
       double readFloat();
       std::string readString();
+      void readData(unsigned char *buf_, size_t nBytes);
       void writeByte(unsigned char n);
       void writeBoolean(bool n);
       void writeInt16(int16_t n);
@@ -57,6 +58,8 @@ namespace Ep128Emu {
       void writeData(const unsigned char *buf_, size_t nBytes);
       void setPosition(size_t pos);
       void clear();
+      // like clear(), but keeps the allocated memory for reuse
+      void truncate();
       inline size_t getPosition() const
       {
         return curPos;
@@ -19,6 +19,8 @@
 
 #include "ep128emu.hpp"
 #include "ide.hpp"
+#include "ideimage.hpp"
+#include "diskovl.hpp"
 #include "system.hpp"
 
 namespace Ep128 {
@@ -41,26 +43,26 @@ namespace Ep128 {
         }
       }
     }
-    if (std::fseek(imageFile, 0L, SEEK_END) < 0)
+    int64_t fileSize_ = Ep128Emu::getImageFileSize(imageFile);
+    if (fileSize_ < 0)
       throw Ep128Emu::Exception("error seeking IDE disk image");
-    size_t  fileSize = size_t(std::ftell(imageFile));
-    if (std::fseek(imageFile, 0L, SEEK_SET) < 0)
-      throw Ep128Emu::Exception("error seeking IDE disk image");
-    if (!(fileSize >= 0x000A0000 && fileSize <= 0x7FFFFE00))
+    uint64_t  fileSize = uint64_t(fileSize_);
+    // up to 2^28 sectors (128 GB) can be addressed in LBA mode
+    if (!(fileSize >= 0x000A0000U && fileSize <= 0x1FFFFFFE00ULL))
       throw Ep128Emu::Exception("IDE disk image size is out of range");
     if ((fileSize & 0x01FF) != 0 && ((fileSize + 1) & 0x01FF) != 0) {
       throw Ep128Emu::Exception("invalid IDE disk image size "
                                 "- must be an integer multiple of 512");
     }
-    uint32_t  nSectors = uint32_t((fileSize + 511UL) >> 9);
+    uint32_t  nSectors = uint32_t((fileSize + 511U) >> 9);
     if (vhdExtension || (fileSize & 0x03FF) != 0) {
       uint8_t buf[512];
       // check if the image file is in VHD format
-      if (std::fseek(imageFile, long((nSectors - 1U) << 9), SEEK_SET) < 0)
+      if (!Ep128Emu::seekImageFile(imageFile, uint64_t(nSectors - 1U) << 9))
         throw Ep128Emu::Exception("error seeking IDE disk image");
       if (std::fread(buf, sizeof(uint8_t), 511, imageFile) != 511)
         throw Ep128Emu::Exception("error reading IDE disk image");
-      if (std::fseek(imageFile, 0L, SEEK_SET) < 0)
+      if (!Ep128Emu::seekImageFile(imageFile, 0U))
         throw Ep128Emu::Exception("error seeking IDE disk image");
       do {
         // check cookie (needed ?)
@@ -147,7 +149,9 @@ namespace Ep128 {
       s = 63;
       ch = nSectors / s;
     }
-    c = uint16_t(ch / h);
+    // the number of cylinders is limited to 16383 for large disks,
+    // the remaining sectors are only accessible in LBA mode
+    c = uint16_t(ch / h < 16383U ? ch / h : 16383U);
     return nSectors;
   }
 
@@ -206,16 +210,10 @@ namespace Ep128 {
       blockSize = tmp;
     }
     if (blockSize > 0) {
-      if (std::fseek(imageFile, long(currentSector << 9), SEEK_SET) < 0) {
-        // error seeking disk image
-        ideController.errorRegister |= uint8_t(0x10);
-      }
-      else {
-        bytesRead = std::fread(buf, sizeof(uint8_t), blockSize << 9, imageFile);
-        if (bytesRead < (blockSize << 9)) {
-          // read error
-          ideController.errorRegister |= uint8_t(0x40);
-        }
+      bytesRead = imageFile->readSectors(buf, currentSector, blockSize) << 9;
+      if (bytesRead < (blockSize << 9)) {
+        // read error
+        ideController.errorRegister |= uint8_t(0x40);
       }
     }
     if (bytesRead < (blockSize << 9))
@@ -245,39 +243,16 @@ namespace Ep128 {
       blockSize = size_t(nSectors - currentSector);
     }
     if (blockSize > 0) {
-      if (std::fseek(imageFile, long(currentSector << 9), SEEK_SET) < 0) {
-        // error seeking disk image
-        ideController.errorRegister |= uint8_t(0x10);
+      bytesWritten = imageFile->writeSectors(buf, currentSector, blockSize) << 9;
+      if (bytesWritten < (blockSize << 9)) {
+        // write error
+        ideController.errorRegister |= uint8_t(0x40);
       }
-      else {
-        bytesWritten = std::fwrite(buf, sizeof(uint8_t), blockSize << 9,
-                                   imageFile);
-        if (bytesWritten < (blockSize << 9)) {
-          // write error
+      else if (ideController.commandRegister == 0x3C) {     // WRITE VERIFY
+        if (!imageFile->verifySectors(buf, currentSector, blockSize)) {
+          // read error
           ideController.errorRegister |= uint8_t(0x40);
         }
-        else if (ideController.commandRegister == 0x3C) {   // WRITE VERIFY
-          if (std::fseek(imageFile, long(currentSector << 9), SEEK_SET) < 0) {
-            // error seeking disk image
-            ideController.errorRegister |= uint8_t(0x50);
-          }
-          else {
-            uint8_t tmpBuf[512];
-            for (size_t i = 0; i < blockSize; i++) {
-              if (std::fread(&(tmpBuf[0]), sizeof(uint8_t), 512, imageFile)
-                  != 512) {
-                // read error
-                ideController.errorRegister |= uint8_t(0x40);
-                break;
-              }
-              if (std::memcmp(&(tmpBuf[0]), buf, 512) != 0) {
-                // read error
-                ideController.errorRegister |= uint8_t(0x40);
-                break;
-              }
-            }
-          }
-        }
       }
     }
     currentSector += uint32_t(bytesWritten >> 9);
@@ -565,7 +540,7 @@ namespace Ep128 {
 
   IDEInterface::IDEController::IDEDrive::IDEDrive(IDEController& ideController_)
     : ideController(ideController_),
-      imageFile((std::FILE *) 0),
+      imageFile((IDEDiskImage *) 0),
       buf((uint8_t *) 0),
       nSectors(0U),
       nCylinders(0),
@@ -591,7 +566,7 @@ namespace Ep128 {
 
   IDEInterface::IDEController::IDEDrive::~IDEDrive()
   {
-    setImageFile((char *) 0);
+    setImageFile((char *) 0, std::string(""));
   }
 
   void IDEInterface::IDEController::IDEDrive::reset(int resetType)
@@ -613,12 +588,14 @@ namespace Ep128 {
     bufPos = 0;
   }
 
-  void IDEInterface::IDEController::IDEDrive::setImageFile(const char *fileName)
+  void IDEInterface::IDEController::IDEDrive::setImageFile(
+      const char *fileName, const std::string& overlayDir)
   {
     if (!fileName || fileName[0] == '\0') {
       if (imageFile) {
-        std::fclose(imageFile);
-        imageFile = (std::FILE *) 0;
+        // any cached sectors are written by the destructor
+        delete imageFile;
+        imageFile = (IDEDiskImage *) 0;
       }
       nSectors = 0U;
       defaultCylinders = 0;
@@ -629,20 +606,33 @@ namespace Ep128 {
       this->reset(3);
       return;
     }
-    setImageFile((char *) 0);   // close any previously opened image file first
+    // close any previously opened image file first
+    setImageFile((char *) 0, overlayDir);
+    std::FILE *f = (std::FILE *) 0;
+    Ep128Emu::DiskImageOverlay  *overlay = (Ep128Emu::DiskImageOverlay *) 0;
     try {
-      imageFile = Ep128Emu::fileOpen(fileName, "r+b");
-      if (!imageFile) {
-        imageFile = Ep128Emu::fileOpen(fileName, "rb");
-        if (!imageFile)
+      if (overlayDir.empty())
+        f = Ep128Emu::fileOpen(fileName, "r+b");
+      if (!f) {
+        f = Ep128Emu::fileOpen(fileName, "rb");
+        if (!f)
           throw Ep128Emu::Exception("error opening IDE disk image");
       }
       else {
         readOnlyMode = false;
       }
-      (void) std::setvbuf(imageFile, (char *) 0, _IONBF, 0);
-      nSectors = checkVHDImage(imageFile, fileName, defaultCylinders,
+      (void) std::setvbuf(f, (char *) 0, _IONBF, 0);
+      nSectors = checkVHDImage(f, fileName, defaultCylinders,
                                defaultHeads, defaultSectorsPerTrack);
+      if (!overlayDir.empty()) {
+        overlay = new Ep128Emu::DiskImageOverlay(
+                          overlayDir, fileName, f,
+                          uint64_t(Ep128Emu::getImageFileSize(f)));
+        readOnlyMode = false;
+      }
+      imageFile = new IDEDiskImage(f, nSectors, overlay);
+      f = (std::FILE *) 0;
+      overlay = (Ep128Emu::DiskImageOverlay *) 0;
       vhdFormat = bool(defaultSectorsPerTrack & 0x8000);
       defaultSectorsPerTrack = defaultSectorsPerTrack & 0x7FFF;
       nCylinders = defaultCylinders;
@@ -651,11 +641,23 @@ namespace Ep128 {
       this->reset(3);
     }
     catch (...) {
-      setImageFile((char *) 0);
+      if (overlay)
+        delete overlay;
+      if (f)
+        std::fclose(f);
+      setImageFile((char *) 0, overlayDir);
       throw;
     }
   }
 
+  void IDEInterface::IDEController::IDEDrive::flushImageFile()
+  {
+    if (imageFile) {
+      if (!imageFile->flush())
+        throw Ep128Emu::Exception("error writing IDE disk image");
+    }
+  }
+
   uint16_t IDEInterface::IDEController::IDEDrive::readWord()
   {
     uint16_t  retval = uint16_t(buf[bufPos]) | (uint16_t(buf[bufPos + 1]) << 8);
@@ -778,6 +780,40 @@ namespace Ep128 {
         (ideController.statusRegister & 0x50) | uint8_t(bool(errorCode));
   }
 
+  void IDEInterface::IDEController::IDEDrive::saveState(
+      Ep128Emu::File::Buffer& buf)
+  {
+    buf.writeUInt16(nCylinders);
+    buf.writeUInt16(nHeads);
+    buf.writeUInt16(nSectorsPerTrack);
+    buf.writeUInt16(multSectCnt);
+    buf.writeUInt32(currentSector);
+    buf.writeUInt16(readWordCnt);
+    buf.writeUInt16(writeWordCnt);
+    buf.writeUInt16(sectorCnt);
+    buf.writeByte(ledStateCounter);
+    buf.writeBoolean(interruptFlag);
+    buf.writeBoolean(diskChangeFlag);
+    buf.writeUInt16(bufPos);
+  }
+
+  void IDEInterface::IDEController::IDEDrive::loadState(
+      Ep128Emu::File::Buffer& buf)
+  {
+    nCylinders = buf.readUInt16();
+    nHeads = buf.readUInt16();
+    nSectorsPerTrack = buf.readUInt16();
+    multSectCnt = buf.readUInt16();
+    currentSector = buf.readUInt32();
+    readWordCnt = buf.readUInt16();
+    writeWordCnt = buf.readUInt16();
+    sectorCnt = buf.readUInt16();
+    ledStateCounter = buf.readByte();
+    interruptFlag = buf.readBoolean();
+    diskChangeFlag = buf.readBoolean();
+    bufPos = buf.readUInt16();
+  }
+
   // --------------------------------------------------------------------------
 
   void IDEInterface::IDEController::softwareReset()
@@ -837,13 +873,66 @@ namespace Ep128 {
     currentDevice = &ideDrive0;
   }
 
-  void IDEInterface::IDEController::setImageFile(int n, const char *fileName)
+  void IDEInterface::IDEController::saveState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.writeUInt16(dataPort);
+    buf.writeByte(commandPort);
+    buf.writeByte(statusRegister);
+    buf.writeUInt16(dataRegister);
+    buf.writeByte(errorRegister);
+    buf.writeByte(featuresRegister);
+    buf.writeByte(sectorCountRegister);
+    buf.writeByte(sectorRegister);
+    buf.writeUInt16(cylinderRegister);
+    buf.writeByte(headRegister);
+    buf.writeBoolean(lbaMode);
+    buf.writeByte(commandRegister);
+    buf.writeByte(deviceControlRegister);
+    buf.writeBoolean(currentDevice == &ideDrive1);
+    ideDrive0.saveState(buf);
+    ideDrive1.saveState(buf);
+    // only the data of the current block is needed for continuing a transfer
+    size_t  nBytes = 0;
+    if (currentDevice->isReadCommand() || currentDevice->isWriteCommand()) {
+      nBytes = currentDevice->getTransferSize();
+      nBytes = (nBytes < 65536 ? nBytes : 65536);
+    }
+    buf.writeUInt32(uint32_t(nBytes));
+    buf.writeData(this->buf, nBytes);
+  }
+
+  void IDEInterface::IDEController::loadState(Ep128Emu::File::Buffer& buf)
+  {
+    dataPort = buf.readUInt16();
+    commandPort = buf.readByte();
+    statusRegister = buf.readByte();
+    dataRegister = buf.readUInt16();
+    errorRegister = buf.readByte();
+    featuresRegister = buf.readByte();
+    sectorCountRegister = buf.readByte();
+    sectorRegister = buf.readByte();
+    cylinderRegister = buf.readUInt16();
+    headRegister = buf.readByte();
+    lbaMode = buf.readBoolean();
+    commandRegister = buf.readByte();
+    deviceControlRegister = buf.readByte();
+    currentDevice = (buf.readBoolean() ? &ideDrive1 : &ideDrive0);
+    ideDrive0.loadState(buf);
+    ideDrive1.loadState(buf);
+    size_t  nBytes = buf.readUInt32();
+    if (nBytes > 65536)
+      throw Ep128Emu::Exception("invalid IDE buffer size in checkpoint");
+    buf.readData(this->buf, nBytes);
+  }
+
+  void IDEInterface::IDEController::setImageFile(
+      int n, const char *fileName, const std::string& overlayDir)
   {
     try {
       if ((n & 1) == 0)
-        ideDrive0.setImageFile(fileName);
+        ideDrive0.setImageFile(fileName, overlayDir);
       else
-        ideDrive1.setImageFile(fileName);
+        ideDrive1.setImageFile(fileName, overlayDir);
     }
     catch (...) {
       if (int((headRegister & 0x10) >> 4) == (n & 1))
@@ -854,6 +943,12 @@ namespace Ep128 {
       this->reset(3);
   }
 
+  void IDEInterface::IDEController::flushImageFiles()
+  {
+    ideDrive0.flushImageFile();
+    ideDrive1.flushImageFile();
+  }
+
   void IDEInterface::IDEController::readRegister()
   {
     if ((commandPort & 0x10) != 0) {
@@ -986,7 +1081,8 @@ namespace Ep128 {
     : idePort0(),
       idePort1(),
       dataPort(0x0000),
-      ledFlashCnt(0x00)
+      ledFlashCnt(0x00),
+      overlayDirectory("")
   {
   }
 
@@ -1001,12 +1097,39 @@ namespace Ep128 {
     idePort1.reset(resetType);
   }
 
+  void IDEInterface::saveState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.writeUInt16(dataPort);
+    buf.writeByte(ledFlashCnt);
+    idePort0.saveState(buf);
+    idePort1.saveState(buf);
+  }
+
+  void IDEInterface::loadState(Ep128Emu::File::Buffer& buf)
+  {
+    dataPort = buf.readUInt16();
+    ledFlashCnt = buf.readByte();
+    idePort0.loadState(buf);
+    idePort1.loadState(buf);
+  }
+
   void IDEInterface::setImageFile(int n, const char *fileName)
   {
     if ((n & 2) == 0)
-      idePort0.setImageFile(n, fileName);
+      idePort0.setImageFile(n, fileName, overlayDirectory);
     else
-      idePort1.setImageFile(n, fileName);
+      idePort1.setImageFile(n, fileName, overlayDirectory);
+  }
+
+  void IDEInterface::setOverlayDirectory(const std::string& dirName)
+  {
+    overlayDirectory = dirName;
+  }
+
+  void IDEInterface::flushImageFiles()
+  {
+    idePort0.flushImageFiles();
+    idePort1.flushImageFiles();
   }
 
   uint8_t IDEInterface::readPort(uint16_t addr)
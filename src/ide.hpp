@@ -24,6 +24,8 @@
 
 namespace Ep128 {
 
+  class IDEDiskImage;
+
   // returns the number of sectors that can be addressed in LBA mode,
   // this may be greater than c*h*s; bit 15 of 's' is set if the file
   // is in VHD format
@@ -37,7 +39,7 @@ namespace Ep128 {
       class IDEDrive {
        protected:
         IDEController&  ideController;
-        std::FILE *imageFile;
+        IDEDiskImage  *imageFile;
         uint8_t   *buf;         // 65536 bytes, pointer is set by ideController
         uint32_t  nSectors;     // LBA sector count
         uint16_t  nCylinders;
@@ -83,11 +85,17 @@ namespace Ep128 {
         IDEDrive(IDEController& ideController_);
         virtual ~IDEDrive();
         void reset(int resetType);
-        void setImageFile(const char *fileName);
+        // if 'overlayDir' is not empty, the image is opened read-only, and
+        // written sectors are stored in a delta file in that directory
+        void setImageFile(const char *fileName, const std::string& overlayDir);
+        // write any cached sectors to the image file
+        void flushImageFile();
         uint16_t readWord();
         void writeWord();
         void processCommand();
         void commandDone(uint8_t errorCode);
+        void saveState(Ep128Emu::File::Buffer& buf);
+        void loadState(Ep128Emu::File::Buffer& buf);
         // set pointer to 64K I/O buffer
         inline void setBuffer(uint8_t *buf_)
         {
@@ -100,7 +108,7 @@ namespace Ep128 {
         }
         inline bool haveImageFile() const
         {
-          return (imageFile != (std::FILE *) 0);
+          return (imageFile != (IDEDiskImage *) 0);
         }
         inline bool isReadCommand() const
         {
@@ -110,6 +118,12 @@ namespace Ep128 {
         {
           return (writeWordCnt > 0);
         }
+        // number of bytes of the I/O buffer used by the current transfer
+        inline size_t getTransferSize() const
+        {
+          return (size_t(bufPos)
+                  + (size_t(readWordCnt) << 1) + (size_t(writeWordCnt) << 1));
+        }
       };
       // --------
       IDEDrive  ideDrive0;
@@ -141,7 +155,12 @@ namespace Ep128 {
       IDEController();
       virtual ~IDEController();
       void reset(int resetType);
-      void setImageFile(int n, const char *fileName);
+      void setImageFile(int n, const char *fileName,
+                        const std::string& overlayDir);
+      void flushImageFiles();
+      // the I/O buffer is saved only while a data transfer is in progress
+      void saveState(Ep128Emu::File::Buffer& buf);
+      void loadState(Ep128Emu::File::Buffer& buf);
       void readRegister();
       void writeRegister();
       inline IDEDrive& getCurrentDevice()
@@ -175,6 +194,7 @@ namespace Ep128 {
     IDEController idePort1;     // secondary controller at EEh
     uint16_t  dataPort;
     uint8_t   ledFlashCnt;
+    std::string overlayDirectory;
     // --------
     uint32_t getLEDState_();
    public:
@@ -186,6 +206,15 @@ namespace Ep128 {
     // 3: reset interface and parameters, and set disk change flag
     void reset(int resetType);
     void setImageFile(int n, const char *fileName);
+    // set the directory of copy-on-write overlay files for the disk images
+    // opened later, or disable overlays if 'dirName' is empty
+    void setOverlayDirectory(const std::string& dirName);
+    // write any cached data of the disk images (on unload or snapshot save)
+    void flushImageFiles();
+    // save and restore the controller and drive registers for virtual
+    // machine checkpoints, the disk image contents are not included
+    void saveState(Ep128Emu::File::Buffer& buf);
+    void loadState(Ep128Emu::File::Buffer& buf);
     uint8_t readPort(uint16_t addr);
     void writePort(uint16_t addr, uint8_t value);
     inline uint32_t getLEDState()
@@ -0,0 +1,354 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "ideimage.hpp"
+#include "system.hpp"
+
+namespace Ep128 {
+
+  IDEDiskImage::IDEDiskImage(std::FILE *f, uint32_t nSectors_,
+                             Ep128Emu::DiskImageOverlay *overlay_)
+    : Ep128Emu::Thread(),
+      imageFile(f),
+      overlay(overlay_),
+      nSectors(nSectors_),
+      useCounter(0U),
+      nextReadSector(0U),
+      readAheadBlock(0xFFFFFFFFU),
+      cacheBuf((uint8_t *) 0),
+      syncBuf((uint8_t *) 0),
+      workerBuf((uint8_t *) 0),
+      workerLock(false),
+      loadDoneLock(false),
+      exitFlag(false),
+      writeError(false)
+  {
+    size_t  blockBytes = size_t(512) << blockSizeShift;
+    cacheBuf = new uint8_t[blockBytes * (nCacheBlocks + 2U)];
+    syncBuf = cacheBuf + (blockBytes * nCacheBlocks);
+    workerBuf = syncBuf + blockBytes;
+    for (unsigned int i = 0U; i < nCacheBlocks; i++) {
+      cacheBlocks[i].blockNum = 0xFFFFFFFFU;
+      cacheBlocks[i].lastUsed = 0U;
+      cacheBlocks[i].validMask = 0U;
+      cacheBlocks[i].dirtyMask = 0U;
+      cacheBlocks[i].isLoading = false;
+      cacheBlocks[i].buf = cacheBuf + (blockBytes * i);
+    }
+    this->start();
+  }
+
+  IDEDiskImage::~IDEDiskImage()
+  {
+    exitFlag = true;
+    workerLock.notify();
+    this->join();
+    (void) flush();
+    if (overlay)
+      delete overlay;
+    std::fclose(imageFile);
+    delete[] cacheBuf;
+  }
+
+  size_t IDEDiskImage::readFile_(uint8_t *buf, uint32_t sectorNum, size_t n)
+  {
+    size_t  nSectorsRead = 0;
+    if (Ep128Emu::seekImageFile(imageFile, uint64_t(sectorNum) << 9)) {
+      nSectorsRead =
+          std::fread(buf, sizeof(uint8_t), n << 9, imageFile) >> 9;
+    }
+    if (overlay && nSectorsRead > 0) {
+      if (!overlay->patchData(buf, uint64_t(sectorNum) << 9,
+                              nSectorsRead << 9)) {
+        nSectorsRead = 0;
+      }
+    }
+    return nSectorsRead;
+  }
+
+  bool IDEDiskImage::writeFile_(const uint8_t *buf, uint32_t sectorNum,
+                                size_t n)
+  {
+    if (overlay)
+      return overlay->writeData(buf, uint64_t(sectorNum) << 9, n << 9);
+    return (Ep128Emu::seekImageFile(imageFile, uint64_t(sectorNum) << 9) &&
+            std::fwrite(buf, sizeof(uint8_t), n << 9, imageFile) == (n << 9));
+  }
+
+  int IDEDiskImage::findBlock_(uint32_t blockNum) const
+  {
+    for (unsigned int i = 0U; i < nCacheBlocks; i++) {
+      if (cacheBlocks[i].blockNum == blockNum)
+        return int(i);
+    }
+    return -1;
+  }
+
+  int IDEDiskImage::allocateBlock_(uint32_t blockNum)
+  {
+    // replace the least recently used block that can be discarded
+    int     n = -1;
+    for (unsigned int i = 0U; i < nCacheBlocks; i++) {
+      const CacheBlock& b = cacheBlocks[i];
+      if (b.isLoading || b.dirtyMask != 0U)
+        continue;
+      if (b.blockNum == 0xFFFFFFFFU) {
+        n = int(i);
+        break;
+      }
+      if (n < 0 || (useCounter - b.lastUsed)
+                   > (useCounter - cacheBlocks[n].lastUsed)) {
+        n = int(i);
+      }
+    }
+    if (n >= 0) {
+      CacheBlock& b = cacheBlocks[n];
+      b.blockNum = blockNum;
+      b.lastUsed = useCounter;
+      b.validMask = 0U;
+      b.dirtyMask = 0U;
+    }
+    return n;
+  }
+
+  uint64_t IDEDiskImage::loadBlock_(int n, uint8_t *tmpBuf)
+  {
+    CacheBlock& b = cacheBlocks[n];
+    uint32_t  firstSector = b.blockNum << blockSizeShift;
+    size_t  nSectorsToRead = size_t(1) << blockSizeShift;
+    if ((nSectors - firstSector) < uint32_t(nSectorsToRead))
+      nSectorsToRead = size_t(nSectors - firstSector);
+    fileMutex.lock();
+    size_t  nSectorsRead = readFile_(tmpBuf, firstSector, nSectorsToRead);
+    fileMutex.unlock();
+    uint64_t  loadedMask =
+        (nSectorsRead < 64 ? ((uint64_t(1) << nSectorsRead) - 1U)
+                           : ~(uint64_t(0)));
+    cacheMutex.lock();
+    // sectors written while the block was loading are newer than the file
+    uint64_t  newMask = loadedMask & (~(b.validMask));
+    for (size_t i = 0; i < nSectorsRead; i++) {
+      if (newMask & (uint64_t(1) << i))
+        std::memcpy(b.buf + (i << 9), tmpBuf + (i << 9), 512);
+    }
+    b.validMask |= loadedMask;
+    b.isLoading = false;
+    cacheMutex.unlock();
+    loadDoneLock.notify();
+    return loadedMask;
+  }
+
+  void IDEDiskImage::writeDirtyBlocks_(uint8_t *tmpBuf)
+  {
+    // fileMutex is held until the data is written, so that a block cannot
+    // be reloaded from the file before the write is complete
+    fileMutex.lock();
+    for (unsigned int i = 0U; i < nCacheBlocks; i++) {
+      cacheMutex.lock();
+      CacheBlock& b = cacheBlocks[i];
+      uint64_t  dirtyMask = b.dirtyMask;
+      if (!dirtyMask) {
+        cacheMutex.unlock();
+        continue;
+      }
+      uint32_t  firstSector = b.blockNum << blockSizeShift;
+      for (size_t j = 0; j < 64 && dirtyMask; j++) {
+        if (dirtyMask & (uint64_t(1) << j))
+          std::memcpy(tmpBuf + (j << 9), b.buf + (j << 9), 512);
+      }
+      b.dirtyMask = 0U;
+      cacheMutex.unlock();
+      // write runs of consecutive modified sectors
+      size_t  j = 0;
+      while (dirtyMask >> j) {
+        if (!((dirtyMask >> j) & 1U)) {
+          j++;
+          continue;
+        }
+        size_t  k = j;
+        while (k < 64 && ((dirtyMask >> k) & 1U))
+          k++;
+        if (!writeFile_(tmpBuf + (j << 9), firstSector + uint32_t(j), k - j))
+          writeError = true;
+        if (k >= 64)
+          break;
+        j = k;
+      }
+    }
+    fileMutex.unlock();
+  }
+
+  bool IDEDiskImage::readSector_(uint8_t *buf, uint32_t sectorNum)
+  {
+    uint32_t  blockNum = sectorNum >> blockSizeShift;
+    uint64_t  sectorMask =
+        uint64_t(1) << (sectorNum & ((1U << blockSizeShift) - 1U));
+    size_t    offs = size_t(sectorNum & ((1U << blockSizeShift) - 1U)) << 9;
+    cacheMutex.lock();
+    while (true) {
+      int     n = findBlock_(blockNum);
+      if (n >= 0) {
+        CacheBlock& b = cacheBlocks[n];
+        if (b.validMask & sectorMask) {
+          std::memcpy(buf, b.buf + offs, 512);
+          b.lastUsed = ++useCounter;
+          cacheMutex.unlock();
+          return true;
+        }
+        if (b.isLoading) {
+          // wait for the worker thread to finish reading this block
+          cacheMutex.unlock();
+          loadDoneLock.wait(10);
+          cacheMutex.lock();
+          continue;
+        }
+      }
+      else {
+        n = allocateBlock_(blockNum);
+        if (n < 0) {
+          // all blocks have unwritten data
+          cacheMutex.unlock();
+          writeDirtyBlocks_(syncBuf);
+          cacheMutex.lock();
+          continue;
+        }
+      }
+      // cache miss, read the block on this thread
+      cacheBlocks[n].isLoading = true;
+      cacheMutex.unlock();
+      if (!(loadBlock_(n, syncBuf) & sectorMask))
+        return false;
+      cacheMutex.lock();
+    }
+  }
+
+  size_t IDEDiskImage::readSectors(uint8_t *buf, uint32_t sectorNum, size_t n)
+  {
+    size_t  i = 0;
+    for ( ; i < n; i++) {
+      if ((sectorNum + uint32_t(i)) >= nSectors)
+        break;
+      if (!readSector_(buf + (i << 9), sectorNum + uint32_t(i)))
+        break;
+    }
+    // request loading the blocks following a sequential read
+    bool    isSequential = (sectorNum == nextReadSector);
+    nextReadSector = sectorNum + uint32_t(i);
+    if (isSequential && i == n) {
+      uint32_t  nextBlock = (nextReadSector >> blockSizeShift);
+      if ((nextReadSector & ((1U << blockSizeShift) - 1U)) != 0U)
+        nextBlock++;
+      if ((nextBlock << blockSizeShift) < nSectors) {
+        cacheMutex.lock();
+        readAheadBlock = nextBlock;
+        cacheMutex.unlock();
+        workerLock.notify();
+      }
+    }
+    return i;
+  }
+
+  size_t IDEDiskImage::writeSectors(const uint8_t *buf, uint32_t sectorNum,
+                                    size_t n)
+  {
+    if (writeError)
+      return 0;
+    size_t  i = 0;
+    cacheMutex.lock();
+    while (i < n && (sectorNum + uint32_t(i)) < nSectors) {
+      uint32_t  s = sectorNum + uint32_t(i);
+      uint32_t  blockNum = s >> blockSizeShift;
+      int     blk = findBlock_(blockNum);
+      if (blk < 0)
+        blk = allocateBlock_(blockNum);
+      if (blk < 0) {
+        cacheMutex.unlock();
+        writeDirtyBlocks_(syncBuf);
+        cacheMutex.lock();
+        continue;
+      }
+      CacheBlock& b = cacheBlocks[blk];
+      uint64_t  sectorMask =
+          uint64_t(1) << (s & ((1U << blockSizeShift) - 1U));
+      std::memcpy(b.buf + (size_t(s & ((1U << blockSizeShift) - 1U)) << 9),
+                  buf + (i << 9), 512);
+      b.validMask |= sectorMask;
+      b.dirtyMask |= sectorMask;
+      b.lastUsed = ++useCounter;
+      i++;
+    }
+    cacheMutex.unlock();
+    workerLock.notify();
+    return i;
+  }
+
+  bool IDEDiskImage::verifySectors(const uint8_t *buf, uint32_t sectorNum,
+                                   size_t n)
+  {
+    if (!flush())
+      return false;
+    bool    retval = true;
+    fileMutex.lock();
+    for (size_t i = 0; i < n; i++) {
+      if (readFile_(syncBuf, sectorNum + uint32_t(i), 1) != 1 ||
+          std::memcmp(syncBuf, buf + (i << 9), 512) != 0) {
+        retval = false;
+        break;
+      }
+    }
+    fileMutex.unlock();
+    return retval;
+  }
+
+  bool IDEDiskImage::flush()
+  {
+    writeDirtyBlocks_(syncBuf);
+    return !writeError;
+  }
+
+  void IDEDiskImage::run()
+  {
+    while (!exitFlag) {
+      workerLock.wait(100);
+      if (exitFlag)
+        break;
+      // write-behind of modified sectors
+      writeDirtyBlocks_(workerBuf);
+      // read-ahead
+      cacheMutex.lock();
+      uint32_t  blockNum = readAheadBlock;
+      readAheadBlock = 0xFFFFFFFFU;
+      for (unsigned int i = 0U; i < readAheadBlocks; i++, blockNum++) {
+        if (blockNum == 0xFFFFFFFFU || (blockNum << blockSizeShift) >= nSectors)
+          break;
+        if (findBlock_(blockNum) >= 0)
+          continue;
+        int     n = allocateBlock_(blockNum);
+        if (n < 0)
+          break;
+        cacheBlocks[n].isLoading = true;
+        cacheMutex.unlock();
+        (void) loadBlock_(n, workerBuf);
+        cacheMutex.lock();
+      }
+      cacheMutex.unlock();
+    }
+  }
+
+}       // namespace Ep128
@@ -0,0 +1,113 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_IDEIMAGE_HPP
+#define EP128EMU_IDEIMAGE_HPP
+
+#include "ep128emu.hpp"
+#include "system.hpp"
+#include "diskovl.hpp"
+
+namespace Ep128 {
+
+  /*!
+   * Sector cache for an IDE disk image file. Sequential reads are served
+   * from blocks loaded ahead by a worker thread, and written sectors are
+   * only stored in the cache and written to the file later by the same
+   * thread, so that the emulation thread normally does no file I/O.
+   * If an overlay is used, the image file is only read, and modified
+   * sectors are stored by the overlay instead.
+   */
+  class IDEDiskImage : private Ep128Emu::Thread {
+   protected:
+    static const unsigned int blockSizeShift = 6;       // 64 sectors (32K)
+    static const unsigned int nCacheBlocks = 32;        // 1 MB
+    static const unsigned int readAheadBlocks = 2;
+    struct CacheBlock {
+      uint32_t  blockNum;       // 0xFFFFFFFF if the block is unused
+      uint32_t  lastUsed;
+      uint64_t  validMask;      // sectors that have been read or written
+      uint64_t  dirtyMask;      // sectors not written to the file yet
+      bool      isLoading;
+      uint8_t   *buf;
+    };
+    std::FILE   *imageFile;
+    Ep128Emu::DiskImageOverlay  *overlay;       // NULL if not used
+    uint32_t    nSectors;
+    uint32_t    useCounter;
+    // sector following the last read, for detecting sequential access
+    uint32_t    nextReadSector;
+    // first block to be loaded by the worker thread, 0xFFFFFFFF if none
+    uint32_t    readAheadBlock;
+    CacheBlock  cacheBlocks[nCacheBlocks];
+    uint8_t     *cacheBuf;
+    // block sized buffers for file I/O by the emulation and worker threads
+    uint8_t     *syncBuf;
+    uint8_t     *workerBuf;
+    // cacheMutex protects cacheBlocks and readAheadBlock, fileMutex is held
+    // during file I/O; cacheMutex is never locked before fileMutex
+    Ep128Emu::Mutex       cacheMutex;
+    Ep128Emu::Mutex       fileMutex;
+    Ep128Emu::ThreadLock  workerLock;
+    Ep128Emu::ThreadLock  loadDoneLock;
+    volatile bool exitFlag;
+    volatile bool writeError;
+    // --------
+    // file I/O with fileMutex held; returns the number of sectors read
+    size_t readFile_(uint8_t *buf, uint32_t sectorNum, size_t n);
+    bool writeFile_(const uint8_t *buf, uint32_t sectorNum, size_t n);
+    int findBlock_(uint32_t blockNum) const;
+    // returns -1 if all blocks are loading or have unwritten data
+    int allocateBlock_(uint32_t blockNum);
+    // 'n' is a block marked as loading; returns the mask of sectors read
+    uint64_t loadBlock_(int n, uint8_t *tmpBuf);
+    void writeDirtyBlocks_(uint8_t *tmpBuf);
+    bool readSector_(uint8_t *buf, uint32_t sectorNum);
+    virtual void run();
+   public:
+    // 'f' is closed and 'overlay_' (may be NULL) is deleted by the destructor
+    IDEDiskImage(std::FILE *f, uint32_t nSectors_,
+                 Ep128Emu::DiskImageOverlay *overlay_ =
+                     (Ep128Emu::DiskImageOverlay *) 0);
+    virtual ~IDEDiskImage();
+    /*!
+     * Read 'n' sectors starting from 'sectorNum' to 'buf'.
+     * Returns the number of sectors read successfully.
+     */
+    size_t readSectors(uint8_t *buf, uint32_t sectorNum, size_t n);
+    /*!
+     * Write 'n' sectors starting from 'sectorNum' from 'buf'. The data is
+     * written to the file later, or by flush(). Returns the number of
+     * sectors stored, which is zero if a previous write has failed.
+     */
+    size_t writeSectors(const uint8_t *buf, uint32_t sectorNum, size_t n);
+    /*!
+     * Write any cached data to the file, and compare 'n' sectors starting
+     * from 'sectorNum' with 'buf'. Returns false on error or mismatch.
+     */
+    bool verifySectors(const uint8_t *buf, uint32_t sectorNum, size_t n);
+    /*!
+     * Write all modified sectors to the file. Returns false if any write
+     * has failed since the image was opened.
+     */
+    bool flush();
+  };
+
+}       // namespace Ep128
+
+#endif  // EP128EMU_IDEIMAGE_HPP
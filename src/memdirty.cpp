@@ -0,0 +1,78 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "fileio.hpp"
+#include "memdirty.hpp"
+
+namespace Ep128Emu {
+
+  MemoryDirtyMap::MemoryDirtyMap()
+  {
+    setAllDirty();
+  }
+
+  void MemoryDirtyMap::clear()
+  {
+    for (int i = 0; i < 256; i++)
+      dirtyFlags[i] = 0;
+  }
+
+  void MemoryDirtyMap::setAllDirty()
+  {
+    for (int i = 0; i < 256; i++)
+      dirtyFlags[i] = 0xFFFF;
+  }
+
+  void MemoryDirtyMap::saveDelta(File::Buffer& buf,
+                                 uint8_t * const *segmentTable,
+                                 const bool *segmentROMTable) const
+  {
+    for (int i = 0; i < 256; i++) {
+      uint16_t  n = dirtyFlags[i];
+      if (!n || !segmentTable[i] || segmentROMTable[i])
+        continue;
+      buf.writeByte(uint8_t(i));
+      buf.writeUInt16(n);
+      for (int j = 0; j < 16; j++) {
+        if (n & (1U << j))
+          buf.writeData(segmentTable[i] + (j << 10), 1024);
+      }
+    }
+  }
+
+  void MemoryDirtyMap::loadDelta(File::Buffer& buf,
+                                 uint8_t * const *segmentTable,
+                                 const bool *segmentROMTable)
+  {
+    while (buf.getPosition() < buf.getDataSize()) {
+      uint8_t   segment = buf.readByte();
+      uint16_t  n = buf.readUInt16();
+      if (!segmentTable[segment] || segmentROMTable[segment]) {
+        buf.setPosition(buf.getDataSize());
+        throw Exception("memory delta state does not match the base state");
+      }
+      for (int j = 0; j < 16; j++) {
+        if (n & (1U << j))
+          buf.readData(segmentTable[segment] + (j << 10), 1024);
+      }
+      dirtyFlags[segment] |= n;
+    }
+  }
+
+}       // namespace Ep128Emu
@@ -0,0 +1,69 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_MEMDIRTY_HPP
+#define EP128EMU_MEMDIRTY_HPP
+
+#include "ep128emu.hpp"
+#include "fileio.hpp"
+
+namespace Ep128Emu {
+
+  /*!
+   * Records which 1K blocks of the 256 memory segments (16K each) have been
+   * written since the last call of clear(), so that a delta state with only
+   * the changed blocks can be saved relative to a base state.
+   */
+  class MemoryDirtyMap {
+   private:
+    uint16_t  dirtyFlags[256];          // bit N is set if block N changed
+   public:
+    MemoryDirtyMap();
+    // 'addr' is the offset in the segment, or a CPU address
+    inline void setDirty(uint8_t segment, uint16_t addr)
+    {
+      dirtyFlags[segment] |= uint16_t(1U << ((addr >> 10) & 15));
+    }
+    inline void setSegmentDirty(uint8_t segment)
+    {
+      dirtyFlags[segment] = 0xFFFF;
+    }
+    inline uint16_t getDirtyBlocks(uint8_t segment) const
+    {
+      return dirtyFlags[segment];
+    }
+    void clear();
+    void setAllDirty();
+    /*!
+     * Append the changed blocks of the RAM segments in 'segmentTable' to
+     * 'buf'.
+     */
+    void saveDelta(File::Buffer& buf, uint8_t * const *segmentTable,
+                   const bool *segmentROMTable) const;
+    /*!
+     * Read blocks written by saveDelta() from 'buf' until the end of the
+     * data, and store them in the segments in 'segmentTable', which should
+     * contain the base state. The loaded blocks are marked as changed.
+     */
+    void loadDelta(File::Buffer& buf, uint8_t * const *segmentTable,
+                   const bool *segmentROMTable);
+  };
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_MEMDIRTY_HPP
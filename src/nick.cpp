@@ -21,6 +21,7 @@
 #include "memory.hpp"
 #include "nick.hpp"
 #include "system.hpp"
+#include "profiler.hpp"
 
 namespace Ep128 {
 
@@ -857,6 +858,7 @@ namespace Ep128 {
 
   EP128EMU_REGPARM1 void Nick::runOneSlot()
   {
+    EP128EMU_PROFILE_SCOPE(PROFILER_NICK);
     if (EP128EMU_UNLIKELY(currentSlot == lpb.rightMargin)) {
       displayEnabled = false;
       setRenderer();
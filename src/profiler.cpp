@@ -0,0 +1,66 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include "ep128emu.hpp"
+#include "profiler.hpp"
+
+#ifdef EP128EMU_ENABLE_PROFILING
+
+#include "system.hpp"
+
+namespace Ep128Emu {
+
+  ProfilerCounter profilerCounters[PROFILER_COUNTER_CNT];
+
+  static const char *profilerCounterNames[PROFILER_COUNTER_CNT] = {
+    "run", "nick", "dave", "audio", "draw", "decode", "serialize"
+  };
+
+  // reference point for converting the time stamp counter to seconds
+  static const uint64_t profilerStartTicks = getProfilerTicks();
+  static Timer          profilerStartTimer;
+
+  ProfilerStatus::ProfilerStatus()
+  {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    uint64_t  ticks = getProfilerTicks() - profilerStartTicks;
+    double    t = profilerStartTimer.getRealTime();
+    double    ticksPerSecond = 1.0e9;
+    if (t > 0.01)
+      ticksPerSecond = double(ticks) / t;
+#else
+    const double  ticksPerSecond = 1.0e9;
+#endif
+    for (int i = 0; i < int(PROFILER_COUNTER_CNT); i++) {
+      calls[i] = profilerCounters[i].calls.load(std::memory_order_relaxed);
+      seconds[i] =
+          double(profilerCounters[i].ticks.load(std::memory_order_relaxed))
+          / ticksPerSecond;
+    }
+  }
+
+  const char * ProfilerStatus::getCounterName(int n)
+  {
+    if (n < 0 || n >= int(PROFILER_COUNTER_CNT))
+      return "";
+    return profilerCounterNames[n];
+  }
+
+}       // namespace Ep128Emu
+
+#endif  // EP128EMU_ENABLE_PROFILING
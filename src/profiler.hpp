@@ -0,0 +1,117 @@
+// ep128emu-core -- libretro core version of the ep128emu emulator
+// Copyright (C) 2022 Zoltan Balogh
+// https://github.com/zoltanvb/ep128emu-core
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef EP128EMU_PROFILER_HPP
+#define EP128EMU_PROFILER_HPP
+
+#include "ep128emu.hpp"
+
+// Optional profiling counters for the hot paths of the emulation. These are
+// only compiled in if EP128EMU_ENABLE_PROFILING is defined (make
+// PROFILING=1), otherwise EP128EMU_PROFILE_SCOPE() expands to nothing.
+
+#ifdef EP128EMU_ENABLE_PROFILING
+
+#include <atomic>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#  include <x86intrin.h>
+#else
+#  include <chrono>
+#endif
+
+namespace Ep128Emu {
+
+  enum ProfilerCounterID {
+    PROFILER_VM_RUN = 0,        // VirtualMachine::run() (all chips + Z80)
+    PROFILER_NICK,              // Nick::runOneSlot()
+    PROFILER_DAVE,              // Dave::runOneCycle()
+    PROFILER_AUDIO_CONVERTER,   // AudioConverter::sendInputSignals()
+    PROFILER_DISPLAY_DRAW,      // LibretroDisplay::draw()
+    PROFILER_DISPLAY_DECODE,    // LibretroDisplay::decodeLine()
+    PROFILER_SERIALIZE,         // retro_serialize()
+    PROFILER_COUNTER_CNT
+  };
+
+  struct ProfilerCounter {
+    // each counter is only updated by one thread, so relaxed loads and
+    // stores are enough, and cheaper than atomic increments
+    std::atomic< uint64_t > calls;
+    std::atomic< uint64_t > ticks;
+    inline void add(uint64_t t)
+    {
+      calls.store(calls.load(std::memory_order_relaxed) + 1U,
+                  std::memory_order_relaxed);
+      ticks.store(ticks.load(std::memory_order_relaxed) + t,
+                  std::memory_order_relaxed);
+    }
+  };
+
+  extern ProfilerCounter  profilerCounters[PROFILER_COUNTER_CNT];
+
+  static inline uint64_t getProfilerTicks()
+  {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    return uint64_t(__rdtsc());
+#else
+    return uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+#endif
+  }
+
+  class ProfilerScope {
+   private:
+    ProfilerCounter&  counter;
+    uint64_t          startTicks;
+   public:
+    inline ProfilerScope(ProfilerCounterID id)
+      : counter(profilerCounters[id]),
+        startTicks(getProfilerTicks())
+    {
+    }
+    inline ~ProfilerScope()
+    {
+      counter.add(getProfilerTicks() - startTicks);
+    }
+  };
+
+  /*!
+   * Snapshot of the profiling counters, with the times converted to
+   * seconds. The difference of two snapshots gives the statistics for the
+   * time between them.
+   */
+  struct ProfilerStatus {
+    uint64_t  calls[PROFILER_COUNTER_CNT];
+    double    seconds[PROFILER_COUNTER_CNT];
+    // --------
+    ProfilerStatus();
+    static const char *getCounterName(int n);
+  };
+
+}       // namespace Ep128Emu
+
+#define EP128EMU_PROFILE_SCOPE(id) \
+    Ep128Emu::ProfilerScope ep128emuProfilerScope_(Ep128Emu::id)
+
+#else   // !EP128EMU_ENABLE_PROFILING
+
+#define EP128EMU_PROFILE_SCOPE(id)
+
+#endif  // EP128EMU_ENABLE_PROFILING
+
+#endif  // EP128EMU_PROFILER_HPP
@@ -37,6 +37,8 @@ namespace Ep128 {
 
   void Ep128VM::saveState(Ep128Emu::File& f)
   {
+    // the snapshot may be used together with the current disk images
+    ideInterface->flushImageFiles();
     ioPorts.saveState(f);
     memory.saveState(f);
     nick.saveState(f);
@@ -51,52 +53,231 @@ namespace Ep128 {
 #endif
     {
       Ep128Emu::File::Buffer  buf;
-      buf.setPosition(0);
-      {
-        uint32_t  v = 0x01000005;       // version number
+      saveVMState(buf);
+      f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_VM_STATE, buf);
+    }
+  }
+
+  void Ep128VM::saveVMState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    {
+      uint32_t  v = 0x01000005;         // version number
+#ifdef ENABLE_SDEXT
+      v = v | 0x00010000;               // bit 16 is set if SDExt is included
+#endif
+#ifdef ENABLE_RESID
+      if (sidModel)
+        v = v | 0x00020000;             // bit 17 is set if reSID is included
+#endif
+      buf.writeUInt32(v);
+    }
+    buf.writeByte(memory.getPage(0));
+    buf.writeByte(memory.getPage(1));
+    buf.writeByte(memory.getPage(2));
+    buf.writeByte(memory.getPage(3));
+    buf.writeByte(memoryWaitMode & 3);
+    buf.writeUInt32(uint32_t(cpuFrequency));
+    buf.writeUInt32(uint32_t(daveFrequency));
+    buf.writeUInt32(uint32_t(nickFrequency));
+    buf.writeUInt32(uint32_t(waitCycleCnt));
+    buf.writeUInt32(uint32_t(videoMemoryLatency));
+    buf.writeUInt32(uint32_t(videoMemoryLatency_M1));
+    buf.writeUInt32(uint32_t(videoMemoryLatency_IO));
+    buf.writeBoolean(memoryTimingEnabled);
+    buf.writeInt64(cpuCyclesRemaining + 1L);  // +1 for compatibility
+    buf.writeInt64(daveCyclesRemaining + 1L);
+    buf.writeBoolean(spectrumEmulatorEnabled);
+    for (int i = 0; i < 4; i++)
+      buf.writeByte(spectrumEmulatorIOPorts[i]);
+    buf.writeByte(cmosMemoryRegisterSelect);
+    buf.writeInt64(prvRTCTime);
+    for (int i = 0; i < 64; i++)
+      buf.writeByte(cmosMemory[i]);
+    buf.writeBoolean(mouseEmulationEnabled);
+    buf.writeByte(prvB7PortState);
+    buf.writeUInt32(mouseTimer);
+    buf.writeUInt64(mouseData);
+#ifdef ENABLE_RESID
+    if (sidModel) {
+      buf.writeBoolean(sidEnabled);
+      buf.writeByte(sidAddressRegister);
+    }
+#endif
+  }
+
+  void Ep128VM::saveDeviceCheckpoint_()
+  {
+    checkpointBuf.writeUInt32(0x01000000);      // version number
+    checkpointBuf.writeUInt32(nickCyclesRemainingL);
+    checkpointBuf.writeInt32(nickCyclesRemainingH);
+    // floppy drives, and the one selected on the WD177x
+    uint8_t   selectedDrive = 0xFF;
+    for (int i = 0; i < 4; i++) {
+      floppyDrives[i].saveState(checkpointBuf);
+      if (&(wd177x.getFloppyDrive()) == &(floppyDrives[i]))
+        selectedDrive = uint8_t(i);
+    }
+    checkpointBuf.writeByte(selectedDrive);
+    wd177x.saveState(checkpointBuf);
+    ideInterface->saveState(checkpointBuf);
+    // time until the next tape sample
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(Ep128VMCallback);
+    uint32_t  tapeCallbackDelay = 0U;
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback &&
+          callbacks[i].nextTime > callbackTime) {
+        tapeCallbackDelay = uint32_t(callbacks[i].nextTime - callbackTime);
+      }
+    }
+    checkpointBuf.writeBoolean(tapeCallbackFlag);
+    checkpointBuf.writeUInt32(tapeCallbackDelay);
+    checkpointBuf.writeInt64(tapeSamplesRemaining);
+    // stored last, as it is not read if the tape has been removed
+    saveTapeCheckpoint();
+  }
+
+  void Ep128VM::restoreDeviceCheckpoint_()
+  {
+    // check version number
+    unsigned int  version = checkpointBuf.readUInt32();
+    if (version != 0x01000000) {
+      checkpointBuf.setPosition(checkpointBuf.getDataSize());
+      throw Ep128Emu::Exception("incompatible ep128 checkpoint version");
+    }
+    nickCyclesRemainingL = checkpointBuf.readUInt32();
+    nickCyclesRemainingH = checkpointBuf.readInt32();
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].loadState(checkpointBuf);
+    uint8_t   selectedDrive = checkpointBuf.readByte();
+    wd177x.loadState(checkpointBuf,
+                     (selectedDrive < 4 ?
+                      &(floppyDrives[selectedDrive])
+                      : (Ep128Emu::FloppyDrive *) 0));
+    ideInterface->loadState(checkpointBuf);
+    bool      tapeCallbackFlag_ = checkpointBuf.readBoolean();
+    uint32_t  tapeCallbackDelay = checkpointBuf.readUInt32();
+    tapeSamplesRemaining = checkpointBuf.readInt64();
+    restoreTapeCheckpoint();
+    if (tapeCallbackFlag_ != tapeCallbackFlag) {
+      tapeCallbackFlag = tapeCallbackFlag_;
+      if (!tapeCallbackFlag)
+        dave.setTapeInput(0, 0);
+      setCallback(&tapeCallback, this, tapeCallbackFlag);
+    }
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(Ep128VMCallback);
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback) {
+        callbacks[i].nextTime = callbackTime + tapeCallbackDelay;
+        if (callbacks[i].nextTime < nextCallbackTime)
+          nextCallbackTime = callbacks[i].nextTime;
+      }
+    }
+  }
+
+  void Ep128VM::saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.truncate();
+    ioPorts.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    if (isDelta)
+      memory.saveDeltaState(checkpointBuf);
+    else
+      memory.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    nick.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    dave.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    z80.saveState(checkpointBuf);
+    writeCheckpointData(buf);
 #ifdef ENABLE_SDEXT
-        v = v | 0x00010000;             // bit 16 is set if SDExt is included
+    sdext.saveState(checkpointBuf);
+    writeCheckpointData(buf);
 #endif
 #ifdef ENABLE_RESID
-        if (sidModel)
-          v = v | 0x00020000;           // bit 17 is set if reSID is included
+    if (sidModel) {
+      sid->saveState(checkpointBuf);
+      writeCheckpointData(buf);
+    }
 #endif
-        buf.writeUInt32(v);
+    saveVMState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveDeviceCheckpoint_();
+    writeCheckpointData(buf);
+  }
+
+  void Ep128VM::restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.setPosition(0);
+    restoringCheckpoint = true;
+    try {
+      readCheckpointData(buf);
+      ioPorts.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      if (isDelta)
+        memory.loadDeltaState(checkpointBuf);
+      else
+        memory.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      nick.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      {
+        // keep the current keyboard state when restoring a checkpoint
+        bool    keyState[128];
+        for (int i = 0; i < 128; i++)
+          keyState[i] = dave.getKeyboardState(i);
+        dave.loadState(checkpointBuf);
+        for (int i = 0; i < 128; i++)
+          dave.setKeyboardState(i, int(keyState[i]));
       }
-      buf.writeByte(memory.getPage(0));
-      buf.writeByte(memory.getPage(1));
-      buf.writeByte(memory.getPage(2));
-      buf.writeByte(memory.getPage(3));
-      buf.writeByte(memoryWaitMode & 3);
-      buf.writeUInt32(uint32_t(cpuFrequency));
-      buf.writeUInt32(uint32_t(daveFrequency));
-      buf.writeUInt32(uint32_t(nickFrequency));
-      buf.writeUInt32(uint32_t(waitCycleCnt));
-      buf.writeUInt32(uint32_t(videoMemoryLatency));
-      buf.writeUInt32(uint32_t(videoMemoryLatency_M1));
-      buf.writeUInt32(uint32_t(videoMemoryLatency_IO));
-      buf.writeBoolean(memoryTimingEnabled);
-      buf.writeInt64(cpuCyclesRemaining + 1L);  // +1 for compatibility
-      buf.writeInt64(daveCyclesRemaining + 1L);
-      buf.writeBoolean(spectrumEmulatorEnabled);
-      for (int i = 0; i < 4; i++)
-        buf.writeByte(spectrumEmulatorIOPorts[i]);
-      buf.writeByte(cmosMemoryRegisterSelect);
-      buf.writeInt64(prvRTCTime);
-      for (int i = 0; i < 64; i++)
-        buf.writeByte(cmosMemory[i]);
-      buf.writeBoolean(mouseEmulationEnabled);
-      buf.writeByte(prvB7PortState);
-      buf.writeUInt32(mouseTimer);
-      buf.writeUInt64(mouseData);
+      readCheckpointData(buf);
+      z80.loadState(checkpointBuf);
+#ifdef ENABLE_SDEXT
+      readCheckpointData(buf);
+      sdext.loadState(checkpointBuf);
+#endif
 #ifdef ENABLE_RESID
       if (sidModel) {
-        buf.writeBoolean(sidEnabled);
-        buf.writeByte(sidAddressRegister);
+        readCheckpointData(buf);
+        sid->loadState(checkpointBuf);
       }
 #endif
-      f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_VM_STATE, buf);
+      readCheckpointData(buf);
+      this->loadState(checkpointBuf);
+      readCheckpointData(buf);
+      restoreDeviceCheckpoint_();
     }
+    catch (...) {
+      restoringCheckpoint = false;
+      throw;
+    }
+    restoringCheckpoint = false;
+  }
+
+  void Ep128VM::saveCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, false);
+  }
+
+  void Ep128VM::restoreCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, false);
+  }
+
+  void Ep128VM::clearMemoryDirtyBlocks()
+  {
+    memory.clearDirtyBlocks();
+  }
+
+  void Ep128VM::saveDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, true);
+  }
+
+  void Ep128VM::restoreDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, true);
   }
 
   void Ep128VM::saveMachineConfiguration(Ep128Emu::File& f)
@@ -181,17 +362,19 @@ namespace Ep128 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible ep128 snapshot version");
     }
-    remoteControlState = 0x00;
-    setTapeMotorState(false);
-    stopDemo();
-    snapshotLoadFlag = true;
-    // reset floppy and IDE emulation, as the state of these is not saved
-    resetFloppyDrives(true);
-    ideInterface->reset(3);
-    z80.closeAllFiles();
+    if (!restoringCheckpoint) {
+      remoteControlState = 0x00;
+      setTapeMotorState(false);
+      stopDemo();
+      snapshotLoadFlag = true;
+      // reset floppy and IDE emulation, as the state of these is not saved
+      resetFloppyDrives(true);
+      ideInterface->reset(3);
+      z80.closeAllFiles();
 #ifdef ENABLE_MIDI_PORT
-    midiPortWriteCallback((void *) this, 0xF6, 0x00);
+      midiPortWriteCallback((void *) this, 0xF6, 0x00);
 #endif
+    }
     try {
 #ifdef ENABLE_SDEXT
       if (!(version & 0x00010000)) {
@@ -19,6 +19,7 @@
 
 #include "ep128emu.hpp"
 #include "snd_conv.hpp"
+#include "profiler.hpp"
 #include <cmath>
 
 namespace Ep128Emu {
@@ -188,6 +189,12 @@ namespace Ep128Emu {
   {
   }
 
+  void AudioConverter::sendInputSignals(const uint32_t *buf, size_t nSamples)
+  {
+    for (size_t i = 0; i < nSamples; i++)
+      this->sendInputSignal(buf[i]);
+  }
+
   void AudioConverter::setInputSampleRate(float sampleRate_)
   {
     inputSampleRate = sampleRate_;
@@ -224,7 +231,7 @@ namespace Ep128Emu {
       ampScale = 0.0117f;
   }
 
-  void AudioConverterLowQuality::sendInputSignal(uint32_t audioInput)
+  inline void AudioConverterLowQuality::processInputSignal(uint32_t audioInput)
   {
     float   left = float(int(audioInput & 0xFFFF));
     float   right = float(int(audioInput >> 16));
@@ -253,6 +260,19 @@ namespace Ep128Emu {
     prvInputR = right;
   }
 
+  void AudioConverterLowQuality::sendInputSignal(uint32_t audioInput)
+  {
+    processInputSignal(audioInput);
+  }
+
+  void AudioConverterLowQuality::sendInputSignals(const uint32_t *buf,
+                                                  size_t nSamples)
+  {
+    EP128EMU_PROFILE_SCOPE(PROFILER_AUDIO_CONVERTER);
+    for (size_t i = 0; i < nSamples; i++)
+      processInputSignal(buf[i]);
+  }
+
   void AudioConverterLowQuality::sendMonoInputSignal(int32_t audioInput)
   {
     float   left = float(audioInput);
@@ -371,7 +391,7 @@ namespace Ep128Emu {
 
   AudioConverterHighQuality::ResampleWindow AudioConverterHighQuality::window;
 
-  void AudioConverterHighQuality::sendInputSignal(uint32_t audioInput)
+  inline void AudioConverterHighQuality::processInputSignal(uint32_t audioInput)
   {
     float   left = float(int(audioInput & 0xFFFF));
     float   right = float(int(audioInput >> 16));
@@ -394,6 +414,19 @@ namespace Ep128Emu {
     }
   }
 
+  void AudioConverterHighQuality::sendInputSignal(uint32_t audioInput)
+  {
+    processInputSignal(audioInput);
+  }
+
+  void AudioConverterHighQuality::sendInputSignals(const uint32_t *buf,
+                                                   size_t nSamples)
+  {
+    EP128EMU_PROFILE_SCOPE(PROFILER_AUDIO_CONVERTER);
+    for (size_t i = 0; i < nSamples; i++)
+      processInputSignal(buf[i]);
+  }
+
   void AudioConverterHighQuality::sendMonoInputSignal(int32_t audioInput)
   {
     float   left = float(audioInput);
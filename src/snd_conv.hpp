@@ -62,6 +62,11 @@ namespace Ep128Emu {
     virtual ~AudioConverter();
     virtual void sendInputSignal(uint32_t audioInput) = 0;
     virtual void sendMonoInputSignal(int32_t audioInput) = 0;
+    /*!
+     * Convert a block of 'nSamples' input samples (in the same format as
+     * the parameter of sendInputSignal()).
+     */
+    virtual void sendInputSignals(const uint32_t *buf, size_t nSamples);
     virtual void setInputSampleRate(float sampleRate_);
     virtual void setOutputSampleRate(float sampleRate_);
     void setDCBlockFilters(float frq1, float frq2);
@@ -78,6 +83,7 @@ namespace Ep128Emu {
     float   phs, nxtPhs;
     float   downsampleRatio;
     float   outLeft, outRight;
+    inline void processInputSignal(uint32_t audioInput);
    public:
     AudioConverterLowQuality(float inputSampleRate_,
                              float outputSampleRate_,
@@ -88,6 +94,7 @@ namespace Ep128Emu {
     virtual ~AudioConverterLowQuality();
     virtual void sendInputSignal(uint32_t audioInput);
     virtual void sendMonoInputSignal(int32_t audioInput);
+    virtual void sendInputSignals(const uint32_t *buf, size_t nSamples);
     virtual void setInputSampleRate(float sampleRate_);
     virtual void setOutputSampleRate(float sampleRate_);
   };
@@ -114,6 +121,7 @@ namespace Ep128Emu {
     float   resampleRatio;
     bool    forceMono;
     // ----------------
+    inline void processInputSignal(uint32_t audioInput);
    public:
     AudioConverterHighQuality(float inputSampleRate_,
                               float outputSampleRate_,
@@ -124,6 +132,7 @@ namespace Ep128Emu {
     virtual ~AudioConverterHighQuality();
     virtual void sendInputSignal(uint32_t audioInput);
     virtual void sendMonoInputSignal(int32_t audioInput);
+    virtual void sendInputSignals(const uint32_t *buf, size_t nSamples);
     virtual void setInputSampleRate(float sampleRate_);
     virtual void setOutputSampleRate(float sampleRate_);
   };
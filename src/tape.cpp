@@ -22,6 +22,7 @@
 #include "system.hpp"
 
 #include <cmath>
+#include <algorithm>
 #ifndef EXCLUDE_SOUND_LIBS
 #include <sndfile.h>
 #endif // EXCLUDE_SOUND_LIBS
@@ -53,7 +54,13 @@ namespace Ep128Emu {
       tapeLength(0),
       tapePosition(0),
       inputState(0),
-      outputState(0)
+      outputState(0),
+      isPreloaded(false),
+      nextEdge(0),
+      nextStop(0),
+      nextEdgePosition(~(size_t(0))),
+      nextStopPosition(~(size_t(0))),
+      isPreloading(false)
   {
     if (!(requestedBitsPerSample == 1 || requestedBitsPerSample == 2 ||
           requestedBitsPerSample == 4 || requestedBitsPerSample == 8))
@@ -102,6 +109,167 @@ namespace Ep128Emu {
   {
   }
 
+  void Tape::saveState(File::Buffer& buf)
+  {
+    buf.writeUInt32(0x01000000);        // version number
+    buf.writeUInt32(uint32_t(tapePosition));
+    buf.writeBoolean(isPlaybackOn);
+    buf.writeBoolean(isRecordOn);
+    buf.writeBoolean(isMotorOn);
+    buf.writeByte(uint8_t(inputState));
+    buf.writeByte(uint8_t(outputState));
+  }
+
+  void Tape::loadState(File::Buffer& buf)
+  {
+    // check version number
+    unsigned int  version = buf.readUInt32();
+    if (version != 0x01000000) {
+      buf.setPosition(buf.getDataSize());
+      throw Exception("incompatible tape state version");
+    }
+    size_t  pos = buf.readUInt32();
+    bool    playbackFlag = buf.readBoolean();
+    bool    recordFlag = buf.readBoolean();
+    bool    motorFlag = buf.readBoolean();
+    int     inputState_ = buf.readByte();
+    int     outputState_ = buf.readByte();
+    if (!playbackFlag)
+      this->stop();
+    else if (recordFlag)
+      record();
+    else
+      play();
+    this->setIsMotorOn(motorFlag);
+    if (pos != tapePosition) {
+      if (isPreloaded) {
+        tapePosition = (pos < tapeLength ? pos : tapeLength);
+        updateNextEdge_();
+      }
+      else {
+        this->seek(double(pos) / double(sampleRate));
+      }
+    }
+    inputState = inputState_;
+    outputState = outputState_;
+  }
+
+  bool Tape::readDataBlock(std::vector< uint8_t >& buf)
+  {
+    buf.clear();
+    return false;
+  }
+
+  bool Tape::preloadTape_()
+  {
+    // limit the decoded length to one hour, and the table size to 16M edges
+    size_t  maxSamples = size_t(sampleRate) * 3600;
+    size_t  maxEdges = 0x01000000;
+    edgePositions.clear();
+    edgeLevels.clear();
+    stopPositions.clear();
+    dataBlocks.clear();
+    bool    savedPlaybackState = isPlaybackOn;
+    int     initialOutputState = outputState;
+    int     prvOutputState = outputState;
+    size_t  n = 0;
+    size_t  endPos = 0;
+    bool    endOfTape = false;
+    try {
+      isPlaybackOn = true;
+      isPreloading = true;
+      while (true) {
+        // one more sample after the end, for the final output level
+        if (getIsEndOfTape()) {
+          endOfTape = true;
+          endPos = n;
+        }
+        runOneSample_();
+        n++;
+        if (outputState != prvOutputState) {
+          prvOutputState = outputState;
+          edgePositions.push_back(uint32_t(n));
+          edgeLevels.push_back(uint8_t(outputState));
+        }
+        if (!isPlaybackOn) {
+          stopPositions.push_back(uint32_t(n));
+          isPlaybackOn = true;
+        }
+        if (endOfTape)
+          break;
+        if (n >= maxSamples || edgePositions.size() >= maxEdges)
+          throw Exception("tape is too long to be preloaded");
+      }
+    }
+    catch (...) {
+      edgePositions.clear();
+      edgeLevels.clear();
+      stopPositions.clear();
+      dataBlocks.clear();
+      isPreloading = false;
+      isPlaybackOn = savedPlaybackState;
+      outputState = initialOutputState;
+      return false;
+    }
+    isPreloading = false;
+    isPlaybackOn = savedPlaybackState;
+    isPreloaded = true;
+    // the length is the last position, as in the streaming path; move an
+    // edge or stop from the extra sample back onto it
+    tapeLength = endPos;
+    if (!edgePositions.empty() && edgePositions.back() > uint32_t(endPos)) {
+      uint8_t finalLevel = edgeLevels.back();
+      edgePositions.pop_back();
+      edgeLevels.pop_back();
+      if (!edgePositions.empty() && edgePositions.back() == uint32_t(endPos)) {
+        edgeLevels.back() = finalLevel;
+      }
+      else {
+        edgePositions.push_back(uint32_t(endPos));
+        edgeLevels.push_back(finalLevel);
+      }
+    }
+    if (!stopPositions.empty() && stopPositions.back() > uint32_t(endPos))
+      stopPositions.pop_back();
+    seekPreloaded_(0.0);
+    outputState = initialOutputState;
+    return true;
+  }
+
+  void Tape::seekPreloaded_(double t)
+  {
+    double  pos = t * double(sampleRate) + 0.5;
+    tapePosition = (pos > 0.0 ? size_t(pos) : 0);
+    tapePosition = (tapePosition < tapeLength ? tapePosition : tapeLength);
+    updateNextEdge_();
+  }
+
+  void Tape::updateNextEdge_()
+  {
+    // find the first edge and stop position after the current position
+    uint32_t  pos = uint32_t(tapePosition);
+    nextEdge = size_t(std::upper_bound(edgePositions.begin(),
+                                       edgePositions.end(), pos)
+                      - edgePositions.begin());
+    outputState = (nextEdge > 0 ? int(edgeLevels[nextEdge - 1]) : 0);
+    nextEdgePosition = (nextEdge < edgePositions.size() ?
+                        size_t(edgePositions[nextEdge]) : ~(size_t(0)));
+    nextStop = size_t(std::upper_bound(stopPositions.begin(),
+                                       stopPositions.end(), pos)
+                      - stopPositions.begin());
+    nextStopPosition = (nextStop < stopPositions.size() ?
+                        size_t(stopPositions[nextStop]) : ~(size_t(0)));
+  }
+
+  void Tape::endPreload_()
+  {
+    isPreloaded = false;
+    edgePositions.clear();
+    edgeLevels.clear();
+    stopPositions.clear();
+    dataBlocks.clear();
+  }
+
   // --------------------------------------------------------------------------
 
   bool Tape_Ep128Emu::findCuePoint_(size_t& ndx_, size_t pos_)
@@ -252,6 +420,11 @@ namespace Ep128Emu {
   {
     // clamp position to tape length
     size_t  pos = (pos_ < tapeLength ? pos_ : tapeLength);
+    if (isPreloaded) {
+      tapePosition = pos;
+      updateNextEdge_();
+      return;
+    }
     size_t  oldBlockNum = (tapePosition >> 12);
     size_t  newBlockNum = (pos >> 12);
 
@@ -408,6 +581,11 @@ namespace Ep128Emu {
         // fill buffer
         readBuffer_();
         unpackSamples_();
+        if (!preloadTape_()) {
+          tapePosition = 0;
+          readBuffer_();
+          unpackSamples_();
+        }
       }
     }
     catch (...) {
@@ -421,6 +599,15 @@ namespace Ep128Emu {
     }
   }
 
+  void Tape_Ep128Emu::endPreload_()
+  {
+    Tape::endPreload_();
+    // reload the buffer at the current position, which may have been left
+    // at the end of the tape by preloadTape_()
+    readBuffer_();
+    unpackSamples_();
+  }
+
   Tape_Ep128Emu::~Tape_Ep128Emu()
   {
     // flush any pending file changes, and close file
@@ -703,6 +890,11 @@ namespace Ep128Emu {
         // fill buffer
         readBuffer_();
         unpackSamples_();
+        if (!preloadTape_()) {
+          tapePosition = 0;
+          readBuffer_();
+          unpackSamples_();
+        }
       }
     }
     catch (...) {
@@ -754,6 +946,10 @@ namespace Ep128Emu {
 
   void Tape_WAV::seek(double t)
   {
+    if (isPreloaded) {
+      seekPreloaded_(t);
+      return;
+    }
     if (t <= 0.0) {
       tapeLength = 0;
       tapePosition = 0;
@@ -891,6 +1087,8 @@ namespace Ep128Emu {
       }
     }
     this->seek(0.0);
+    if (!preloadTape_())
+      this->seek(0.0);
   }
 
   Tape_EPTE::~Tape_EPTE()
@@ -988,6 +1186,10 @@ namespace Ep128Emu {
 
   void Tape_EPTE::seek(double t)
   {
+    if (isPreloaded) {
+      seekPreloaded_(t);
+      return;
+    }
     if (t <= 0.0) {
       tapeLength = 0;
       tapePosition = 0;
@@ -1084,6 +1286,8 @@ namespace Ep128Emu {
     }
     sampleRate = (isTAPFile ? 53030L : 109375L);        // 3500000 / 66 or 32
     this->seek(0.0);
+    if (!preloadTape_())
+      this->seek(0.0);
   }
 
   Tape_TZX::~Tape_TZX()
@@ -1237,6 +1441,7 @@ namespace Ep128Emu {
           return;
         dataBlockBytesLeft = tmp;
       }
+      addDataBlock_();
       currentMode = 0x00;
       pulseTimer = pilotPulseLength;
       pulseLength = pilotPulseLength;
@@ -1304,6 +1509,7 @@ namespace Ep128Emu {
           if (!readUInt24(dataBlockBytesLeft))
             return;
         }
+        addDataBlock_();
         currentMode = 0x00;
         pulseTimer = pilotPulseLength;
         pulseLength = pilotPulseLength;
@@ -1361,6 +1567,7 @@ namespace Ep128Emu {
           return;
         if (dataBlockBytesLeft < 1U && pauseLength < 1U)
           continue;
+        addDataBlock_();
         currentMode = 0x03;
         shiftReg = 0x80;
         dataBlockNextBit();
@@ -1614,11 +1821,16 @@ namespace Ep128Emu {
                      | uint8_t(1 << (8 - lastByteBits));
         }
       }
-      else if (pauseLength > 0U) {
-        setPauseMode();
-        return;
-      }
       else {
+        // end of data: record the position for ROM loader traps
+        if (isPreloading && dataBlocks.size() > 0) {
+          if (dataBlocks.back().endPosition == 0xFFFFFFFFU)
+            dataBlocks.back().endPosition = uint32_t(tapePosition);
+        }
+        if (pauseLength > 0U) {
+          setPauseMode();
+          return;
+        }
         readNextTZXBlock();
         return;
       }
@@ -1634,6 +1846,44 @@ namespace Ep128Emu {
     pulseTimer = pulseLength;
   }
 
+  void Tape_TZX::addDataBlock_()
+  {
+    if (!isPreloading || dataBlockBytesLeft < 1U)
+      return;
+    DataBlockInfo tmp;
+    tmp.startPosition = uint32_t(tapePosition);
+    tmp.endPosition = 0xFFFFFFFFU;
+    tmp.filePosition = std::ftell(f);
+    tmp.nBytes = dataBlockBytesLeft;
+    dataBlocks.push_back(tmp);
+  }
+
+  bool Tape_TZX::readDataBlock(std::vector< uint8_t >& buf)
+  {
+    buf.clear();
+    if (!isPreloaded)
+      return false;
+    size_t  i = 0;
+    while (i < dataBlocks.size() &&
+           size_t(dataBlocks[i].endPosition) <= tapePosition) {
+      i++;
+    }
+    if (i >= dataBlocks.size())
+      return false;
+    const DataBlockInfo&  b = dataBlocks[i];
+    buf.resize(b.nBytes);
+    if (std::fseek(f, b.filePosition, SEEK_SET) < 0 ||
+        std::fread(&(buf.front()), sizeof(uint8_t), buf.size(), f)
+        != buf.size()) {
+      buf.clear();
+      return false;
+    }
+    tapePosition = (size_t(b.endPosition) < tapeLength ?
+                    size_t(b.endPosition) : tapeLength);
+    updateNextEdge_();
+    return true;
+  }
+
   void Tape_TZX::runOneSample_()
   {
     if (endOfTape) {
@@ -1713,6 +1963,10 @@ namespace Ep128Emu {
 
   void Tape_TZX::seek(double t)
   {
+    if (isPreloaded) {
+      seekPreloaded_(t);
+      return;
+    }
     if (t <= 0.0) {
       tapeReset();
       tapePosition = 0;
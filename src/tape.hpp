@@ -42,7 +42,60 @@ namespace Ep128Emu {
     size_t    tapePosition;     // current read/write position (in samples)
     int       inputState;
     int       outputState;
+    // read-only tape images are decoded at load time to a table of the
+    // sample positions where the output changes, and the new output levels
+    bool      isPreloaded;
+    std::vector< uint32_t > edgePositions;
+    std::vector< uint8_t >  edgeLevels;
+    // sample positions where the tape stops itself (TZX pause 0 block)
+    std::vector< uint32_t > stopPositions;
+    size_t    nextEdge;         // index of next entry in 'edgePositions'
+    size_t    nextStop;         // index of next entry in 'stopPositions'
+    size_t    nextEdgePosition;
+    size_t    nextStopPosition;
+    // data blocks found while preloading the tape, for ROM loader traps
+    struct DataBlockInfo {
+      uint32_t  startPosition;  // tape position at the start of the block
+      uint32_t  endPosition;    // tape position after the last data bit
+      long      filePosition;   // offset of the data bytes in the file
+      uint32_t  nBytes;
+    };
+    std::vector< DataBlockInfo >  dataBlocks;
+    bool      isPreloading;
     Tape(int bitsPerSample = 1);
+    /*!
+     * Decode the tape image by calling runOneSample_() up to the end of the
+     * tape, and store the output as a list of edges. On success, the tape is
+     * rewound, and further playback does not use runOneSample_(). Returns
+     * false if the tape is too long, the caller should then rewind the tape.
+     */
+    bool preloadTape_();
+    void seekPreloaded_(double t);
+    void updateNextEdge_();
+    /*!
+     * Discard the preloaded edge table, and continue from the current
+     * position using runOneSample_(). This is called when recording to a
+     * tape file that was preloaded.
+     */
+    virtual void endPreload_();
+    inline void runPreloadedSample_()
+    {
+      if (tapePosition >= tapeLength)
+        return;
+      tapePosition++;
+      if (tapePosition == nextEdgePosition) {
+        outputState = int(edgeLevels[nextEdge]);
+        nextEdge++;
+        nextEdgePosition = (nextEdge < edgePositions.size() ?
+                            size_t(edgePositions[nextEdge]) : ~(size_t(0)));
+      }
+      if (EP128EMU_UNLIKELY(tapePosition == nextStopPosition)) {
+        isPlaybackOn = false;
+        nextStop++;
+        nextStopPosition = (nextStop < stopPositions.size() ?
+                            size_t(stopPositions[nextStop]) : ~(size_t(0)));
+      }
+    }
    public:
     virtual ~Tape();
     /*!
@@ -74,8 +127,12 @@ namespace Ep128Emu {
      */
     inline void runOneSample()
     {
-      if (isPlaybackOn && isMotorOn)
-        runOneSample_();
+      if (isPlaybackOn && isMotorOn) {
+        if (isPreloaded)
+          runPreloadedSample_();
+        else
+          runOneSample_();
+      }
     }
     /*!
      * Turn motor on (newState = true) or off (newState = false).
@@ -104,6 +161,8 @@ namespace Ep128Emu {
      */
     inline void record()
     {
+      if (isPreloaded && !isReadOnly)
+        endPreload_();
       isPlaybackOn = true;
       isRecordOn = !isReadOnly;
     }
@@ -143,6 +202,13 @@ namespace Ep128Emu {
     {
       return (double(uint32_t(tapeLength)) / double(sampleRate));
     }
+    /*!
+     * Read the bytes of the next data block (the one being played, or the
+     * first one after the current position) to 'buf', and seek to the end
+     * of the block. Returns false if no data block is found, or the format
+     * does not store data blocks.
+     */
+    virtual bool readDataBlock(std::vector< uint8_t >& buf);
     /*!
      * Returns true if the current position is at the end of the tape;
      * should be used only when reading a tape file.
@@ -171,6 +237,18 @@ namespace Ep128Emu {
      * Delete all cue points. Has no effect if the file is read-only.
      */
     virtual void deleteAllCuePoints();
+    /*!
+     * Save the playback state (position, buttons, motor and signal levels)
+     * to 'buf'. This is used by virtual machine checkpoints, and does not
+     * include the tape data.
+     */
+    virtual void saveState(File::Buffer& buf);
+    /*!
+     * Restore the playback state saved by saveState(). The position is
+     * exact for preloaded and ep128emu format tapes, other formats use
+     * seek() with the nearest time.
+     */
+    virtual void loadState(File::Buffer& buf);
   };
 
   class Tape_Ep128Emu : public Tape {
@@ -202,6 +280,8 @@ namespace Ep128Emu {
     void unpackSamples_();
     bool writeHeader_();
     void flushBuffer_();
+   protected:
+    virtual void endPreload_();
    public:
     /*!
      * Open tape file 'fileName'. If the file does not exist yet, it may be
@@ -437,8 +517,14 @@ namespace Ep128Emu {
     void readNextTZXBlock();
     void directRecordingNextBit();
     void dataBlockNextBit();
+    void addDataBlock_();
     virtual void runOneSample_();
    public:
+    /*!
+     * Read the bytes of the next data block (standard speed, turbo or pure
+     * data block) to 'buf', and seek to the end of the block.
+     */
+    virtual bool readDataBlock(std::vector< uint8_t >& buf);
     /*!
      * Turn motor on (newState = true) or off (newState = false).
      */
@@ -29,6 +29,7 @@
 #include "tvc64vm.hpp"
 #include "debuglib.hpp"
 #include "videorec.hpp"
+#include "profiler.hpp"
 #include "roms/roms.hpp"
 #ifdef ENABLE_SDEXT
 #  include "sdext.hpp"
@@ -154,12 +155,9 @@ namespace TVC64 {
             updateSndIntState(cursorState);
         }
       }
-      TVC64VMCallback *p = firstCallback;
-      while (EP128EMU_UNLIKELY(bool(p))) {
-        TVC64VMCallback *nxt = p->nxt;
-        p->func(p->userData);
-        p = nxt;
-      }
+      if (EP128EMU_UNLIKELY(callbackTime >= nextCallbackTime))
+        runCallbacks();
+      callbackTime++;
       m++;
       if (EP128EMU_UNLIKELY(!(m & 3))) {
         uint32_t  tmp = uint32_t(tapeInputSignal + tapeOutputSignal) << 12;
@@ -1060,7 +1058,7 @@ namespace TVC64 {
     vm.videoRenderer.crtcVSyncStateChange(newState);
   }
 
-  void TVC64VM::tapeCallback(void *userData)
+  uint32_t TVC64VM::tapeCallback(void *userData)
   {
     TVC64VM&  vm = *(reinterpret_cast<TVC64VM *>(userData));
     vm.tapeSamplesRemaining += vm.tapeSamplesPerCRTCCycle;
@@ -1069,9 +1067,17 @@ namespace TVC64 {
       vm.tapeSamplesRemaining -= (int64_t(1) << 32);
       vm.tapeInputSignal = uint8_t(vm.runTape(vm.tapeOutputSignal));
     }
+    // skip the cycles until the next tape sample is due
+    if (vm.tapeSamplesPerCRTCCycle < 1)
+      return 1U;
+    int64_t n = (-vm.tapeSamplesRemaining - 1) / vm.tapeSamplesPerCRTCCycle;
+    if (n < 1)
+      return 1U;
+    vm.tapeSamplesRemaining += (n * vm.tapeSamplesPerCRTCCycle);
+    return uint32_t(n + 1);
   }
 
-  void TVC64VM::demoPlayCallback(void *userData)
+  uint32_t TVC64VM::demoPlayCallback(void *userData)
   {
     TVC64VM&  vm = *(reinterpret_cast<TVC64VM *>(userData));
     while (!vm.demoTimeCnt) {
@@ -1115,18 +1121,21 @@ namespace TVC64 {
     }
     if (vm.demoTimeCnt)
       vm.demoTimeCnt--;
+    return 1U;
   }
 
-  void TVC64VM::demoRecordCallback(void *userData)
+  uint32_t TVC64VM::demoRecordCallback(void *userData)
   {
     TVC64VM&  vm = *(reinterpret_cast<TVC64VM *>(userData));
     vm.demoTimeCnt++;
+    return 1U;
   }
 
-  void TVC64VM::videoCaptureCallback(void *userData)
+  uint32_t TVC64VM::videoCaptureCallback(void *userData)
   {
     TVC64VM&  vm = *(reinterpret_cast<TVC64VM *>(userData));
     vm.videoCapture->runOneCycle(vm.soundOutputSignal);
+    return 1U;
   }
 
   uint8_t TVC64VM::checkSingleStepModeBreak()
@@ -1234,7 +1243,7 @@ namespace TVC64 {
     }
   }
 
-  void TVC64VM::setCallback(void (*func)(void *userData), void *userData_,
+  void TVC64VM::setCallback(uint32_t (*func)(void *userData), void *userData_,
                             bool isEnabled)
   {
     if (!func)
@@ -1262,7 +1271,7 @@ namespace TVC64 {
         p = p->nxt;
       }
       if (!isEnabled) {
-        callbacks[ndx].func = (void (*)(void *)) 0;
+        callbacks[ndx].func = (uint32_t (*)(void *)) 0;
         callbacks[ndx].userData = (void *) 0;
         callbacks[ndx].nxt = (TVC64VMCallback *) 0;
       }
@@ -1271,7 +1280,7 @@ namespace TVC64 {
       return;
     if (ndx < 0) {
       for (size_t i = 0; i < maxCallbacks; i++) {
-        if (callbacks[i].func == (void (*)(void *)) 0) {
+        if (callbacks[i].func == (uint32_t (*)(void *)) 0) {
           ndx = int(i);
           break;
         }
@@ -1282,6 +1291,9 @@ namespace TVC64 {
     callbacks[ndx].func = func;
     callbacks[ndx].userData = userData_;
     callbacks[ndx].nxt = (TVC64VMCallback *) 0;
+    callbacks[ndx].nextTime = callbackTime;
+    if (callbackTime < nextCallbackTime)
+      nextCallbackTime = callbackTime;
     if (isEnabled) {
       TVC64VMCallback   *prv = (TVC64VMCallback *) 0;
       TVC64VMCallback   *p = firstCallback;
@@ -1297,6 +1309,25 @@ namespace TVC64 {
     }
   }
 
+  EP128EMU_REGPARM1 void TVC64VM::runCallbacks()
+  {
+    uint64_t  t = callbackTime;
+    uint64_t  nextTime = ~(uint64_t(0));
+    nextCallbackTime = nextTime;
+    TVC64VMCallback *p = firstCallback;
+    while (p) {
+      TVC64VMCallback *nxt = p->nxt;
+      if (p->nextTime <= t)
+        p->nextTime = t + p->func(p->userData);
+      if (p->nextTime < nextTime)
+        nextTime = p->nextTime;
+      p = nxt;
+    }
+    // setCallback() may have also changed nextCallbackTime
+    if (nextTime < nextCallbackTime)
+      nextCallbackTime = nextTime;
+  }
+
   // --------------------------------------------------------------------------
 
   TVC64VM::TVC64VM(Ep128Emu::VideoDisplay& display_,
@@ -1337,6 +1368,8 @@ namespace TVC64 {
       vtdosROMPage(0),
       breakPointPriorityThreshold(0),
       firstCallback((TVC64VMCallback *) 0),
+      callbackTime(0U),
+      nextCallbackTime(~(uint64_t(0))),
       videoCapture((Ep128Emu::VideoCapture *) 0),
       tapeSamplesPerCRTCCycle(0L),
       tapeSamplesRemaining(-1L),
@@ -1345,7 +1378,7 @@ namespace TVC64 {
     for (size_t i = 0;
          i < (sizeof(callbacks) / sizeof(TVC64VMCallback));
          i++) {
-      callbacks[i].func = (void (*)(void *)) 0;
+      callbacks[i].func = (uint32_t (*)(void *)) 0;
       callbacks[i].userData = (void *) 0;
       callbacks[i].nxt = (TVC64VMCallback *) 0;
     }
@@ -1388,6 +1421,7 @@ namespace TVC64 {
 
   void TVC64VM::run(size_t microseconds)
   {
+    EP128EMU_PROFILE_SCOPE(PROFILER_VM_RUN);
     Ep128Emu::VirtualMachine::run(microseconds);
     if (snapshotLoadFlag) {
       snapshotLoadFlag = false;
@@ -1420,6 +1454,7 @@ namespace TVC64 {
       if ((z80HalfCycleCnt - machineHalfCycleCnt) & 0xFE)
         runDevices();
     }
+    flushAudioOutput();
   }
 
   void TVC64VM::reset(bool isColdReset)
@@ -1578,6 +1613,7 @@ namespace TVC64 {
   void TVC64VM::getVMStatus(VMStatus& vmStatus_)
   {
     vmStatus_.tapeReadOnly = getIsTapeReadOnly();
+    vmStatus_.tapeMotorOn = (getIsTapeMotorOn() && getTapeButtonState() != 0);
     vmStatus_.tapePosition = getTapePosition();
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
@@ -1665,6 +1701,12 @@ namespace TVC64 {
 #endif
   }
 
+  void TVC64VM::setDiskOverlayDirectory(const std::string& dirName)
+  {
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].setOverlayDirectory(dirName);
+  }
+
   uint32_t TVC64VM::getFloppyDriveLEDState()
   {
     uint32_t  n = 0U;
@@ -1996,3 +2038,10 @@ namespace TVC64 {
 
 }       // namespace TVC64
 
+
+// The Z80 instruction decoder is instantiated here, so that it can call the
+// memory and I/O functions of TVC64VM::Z80_ directly.
+
+#include "z80core.hpp"
+
+template class Ep128::Z80Core<TVC64::TVC64VM::Z80_>;
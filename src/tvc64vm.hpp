@@ -112,7 +112,7 @@ namespace TVC64 {
       virtual void vsyncStateChange(bool newState, unsigned int currentSlot_);
     };
     // ----------------
-    Z80_      z80;
+    Ep128::Z80Core<Z80_>  z80;
     Memory_   memory;
     IOPorts_  ioPorts;
     CPC464::CRTC6845  crtc;
@@ -169,12 +169,16 @@ namespace TVC64 {
     uint8_t   vtdosROMPage;             // 0 to 3
     uint8_t   breakPointPriorityThreshold;
     struct TVC64VMCallback {
-      void      (*func)(void *);
+      uint32_t  (*func)(void *);
       void      *userData;
       TVC64VMCallback  *nxt;
+      uint64_t  nextTime;
     };
     TVC64VMCallback  callbacks[16];
     TVC64VMCallback  *firstCallback;
+    // current CRTC cycle, and the earliest time a callback is due
+    uint64_t  callbackTime;
+    uint64_t  nextCallbackTime;
     Ep128Emu::VideoCapture  *videoCapture;
     int64_t   tapeSamplesPerCRTCCycle;
     int64_t   tapeSamplesRemaining;
@@ -200,20 +204,33 @@ namespace TVC64 {
                                                            bool newState);
     static EP128EMU_REGPARM2 void vSyncStateChangeCallback(void *userData,
                                                            bool newState);
-    static void tapeCallback(void *userData);
-    static void demoPlayCallback(void *userData);
-    static void demoRecordCallback(void *userData);
-    static void videoCaptureCallback(void *userData);
+    static uint32_t tapeCallback(void *userData);
+    static uint32_t demoPlayCallback(void *userData);
+    static uint32_t demoRecordCallback(void *userData);
+    static uint32_t videoCaptureCallback(void *userData);
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
+    // write the state of the machine that is not stored by the components
+    void saveVMState(Ep128Emu::File::Buffer& buf);
+    // if 'isDelta' is true, only the changed memory blocks are stored
+    void saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    void restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    // state that is only stored in checkpoints: the time remaining from
+    // the last run() call, and the tape and disk drive emulation
+    void saveDeviceCheckpoint_();
+    void restoreDeviceCheckpoint_();
     uint8_t checkSingleStepModeBreak();
     void convertKeyboardState();
     void resetKeyboard();
     void resetFloppyDrives(bool isColdReset);
     // Set function to be called at every CRTC cycle. The functions are called
     // in the order of being registered; up to 16 callbacks can be set.
-    void setCallback(void (*func)(void *userData), void *userData_,
+    // Each function returns the number of CRTC cycles after which it is to
+    // be called again (1 = next cycle).
+    void setCallback(uint32_t (*func)(void *userData), void *userData_,
                      bool isEnabled);
+    // call the functions that are due at the current CRTC cycle
+    EP128EMU_REGPARM1 void runCallbacks();
    public:
     TVC64VM(Ep128Emu::VideoDisplay&, Ep128Emu::AudioOutput&);
     virtual ~TVC64VM();
@@ -289,6 +306,7 @@ namespace TVC64 {
     virtual void setDiskImageFile(int n, const std::string& fileName_,
                                   int nTracks_ = -1, int nSides_ = 2,
                                   int nSectorsPerTrack_ = 9);
+    virtual void setDiskOverlayDirectory(const std::string& dirName);
     /*!
      * Returns the current state of the disk drive LEDs, which is the sum
      * of any of the following values:
@@ -515,6 +533,15 @@ namespace TVC64 {
      * playing a demo.
      */
     virtual bool getIsPlayingDemo() const;
+    /*!
+     * Save or restore a checkpoint of the virtual machine state for
+     * run-ahead (see Ep128Emu::VirtualMachine::saveCheckpoint()).
+     */
+    virtual void saveCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void clearMemoryDirtyBlocks();
+    virtual void saveDeltaCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreDeltaCheckpoint(Ep128Emu::File::Buffer&);
     // ----------------
     virtual void loadState(Ep128Emu::File::Buffer&);
     virtual void loadMachineConfiguration(Ep128Emu::File::Buffer&);
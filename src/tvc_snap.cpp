@@ -36,36 +36,191 @@ namespace TVC64 {
 #endif
     {
       Ep128Emu::File::Buffer  buf;
-      buf.setPosition(0);
+      saveVMState(buf);
+      f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_TVCVM_STATE, buf);
+    }
+  }
+
+  void TVC64VM::saveVMState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
 #ifndef ENABLE_SDEXT
-      buf.writeUInt32(0x01000002);      // version number
+    buf.writeUInt32(0x01000002);        // version number
 #else
-      buf.writeUInt32(0x01010002);      // bit 16 is set if SDExt is included
+    buf.writeUInt32(0x01010002);        // bit 16 is set if SDExt is included
 #endif
-      for (uint8_t i = 0; i <= 4; i++)
-        buf.writeByte(videoRenderer.getColor(i));
-      buf.writeByte(videoRenderer.getVideoMode());
-      buf.writeByte(z80HalfCycleCnt);
-      buf.writeByte(machineHalfCycleCnt);
-      buf.writeByte(tapeOutputSignal);
-      buf.writeByte(crtcRegisterSelected);
-      buf.writeByte(irqState);
-      buf.writeByte(irqEnableMask);
-      buf.writeByte(keyboardRow);
-      buf.writeBoolean(prvSndIntState);
-      buf.writeUInt32(toneGenCnt1);
-      buf.writeUInt32(toneGenFreq);
-      buf.writeByte(toneGenCnt2);
-      buf.writeBoolean(toneGenEnabled);
-      buf.writeByte(audioOutputLevel);
-      buf.writeByte(vtdosROMPage);
-      buf.writeUInt32(uint32_t(crtcFrequency));
-      for (int i = 0; i < 16; i++)
-        buf.writeByte(keyboardState[i]);
-      f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_TVCVM_STATE, buf);
+    for (uint8_t i = 0; i <= 4; i++)
+      buf.writeByte(videoRenderer.getColor(i));
+    buf.writeByte(videoRenderer.getVideoMode());
+    buf.writeByte(z80HalfCycleCnt);
+    buf.writeByte(machineHalfCycleCnt);
+    buf.writeByte(tapeOutputSignal);
+    buf.writeByte(crtcRegisterSelected);
+    buf.writeByte(irqState);
+    buf.writeByte(irqEnableMask);
+    buf.writeByte(keyboardRow);
+    buf.writeBoolean(prvSndIntState);
+    buf.writeUInt32(toneGenCnt1);
+    buf.writeUInt32(toneGenFreq);
+    buf.writeByte(toneGenCnt2);
+    buf.writeBoolean(toneGenEnabled);
+    buf.writeByte(audioOutputLevel);
+    buf.writeByte(vtdosROMPage);
+    buf.writeUInt32(uint32_t(crtcFrequency));
+    for (int i = 0; i < 16; i++)
+      buf.writeByte(keyboardState[i]);
+  }
+
+  void TVC64VM::saveDeviceCheckpoint_()
+  {
+    checkpointBuf.writeUInt32(0x01000000);      // version number
+    checkpointBuf.writeUInt32(crtcCyclesRemainingL);
+    checkpointBuf.writeInt32(crtcCyclesRemainingH);
+    // floppy drives, and the one selected on the WD177x
+    uint8_t   selectedDrive = 0xFF;
+    for (int i = 0; i < 4; i++) {
+      floppyDrives[i].saveState(checkpointBuf);
+      if (&(wd177x.getFloppyDrive()) == &(floppyDrives[i]))
+        selectedDrive = uint8_t(i);
+    }
+    checkpointBuf.writeByte(selectedDrive);
+    wd177x.saveState(checkpointBuf);
+    // time until the next tape sample
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(TVC64VMCallback);
+    uint32_t  tapeCallbackDelay = 0U;
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback &&
+          callbacks[i].nextTime > callbackTime) {
+        tapeCallbackDelay = uint32_t(callbacks[i].nextTime - callbackTime);
+      }
+    }
+    checkpointBuf.writeBoolean(tapeCallbackFlag);
+    checkpointBuf.writeBoolean(prvTapeCallbackFlag);
+    checkpointBuf.writeByte(tapeInputSignal);
+    checkpointBuf.writeUInt32(tapeCallbackDelay);
+    checkpointBuf.writeInt64(tapeSamplesRemaining);
+    // stored last, as it is not read if the tape has been removed
+    saveTapeCheckpoint();
+  }
+
+  void TVC64VM::restoreDeviceCheckpoint_()
+  {
+    // check version number
+    unsigned int  version = checkpointBuf.readUInt32();
+    if (version != 0x01000000) {
+      checkpointBuf.setPosition(checkpointBuf.getDataSize());
+      throw Ep128Emu::Exception("incompatible TVC checkpoint version");
+    }
+    crtcCyclesRemainingL = checkpointBuf.readUInt32();
+    crtcCyclesRemainingH = checkpointBuf.readInt32();
+    for (int i = 0; i < 4; i++)
+      floppyDrives[i].loadState(checkpointBuf);
+    uint8_t   selectedDrive = checkpointBuf.readByte();
+    wd177x.loadState(checkpointBuf,
+                     (selectedDrive < 4 ?
+                      &(floppyDrives[selectedDrive])
+                      : (Ep128Emu::FloppyDrive *) 0));
+    bool      tapeCallbackFlag_ = checkpointBuf.readBoolean();
+    prvTapeCallbackFlag = checkpointBuf.readBoolean();
+    tapeInputSignal = checkpointBuf.readByte() & 0x01;
+    uint32_t  tapeCallbackDelay = checkpointBuf.readUInt32();
+    tapeSamplesRemaining = checkpointBuf.readInt64();
+    restoreTapeCheckpoint();
+    if (tapeCallbackFlag_ != tapeCallbackFlag) {
+      tapeCallbackFlag = tapeCallbackFlag_;
+      setCallback(&tapeCallback, this, tapeCallbackFlag);
+    }
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(TVC64VMCallback);
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback) {
+        callbacks[i].nextTime = callbackTime + tapeCallbackDelay;
+        if (callbacks[i].nextTime < nextCallbackTime)
+          nextCallbackTime = callbacks[i].nextTime;
+      }
     }
   }
 
+  void TVC64VM::saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.truncate();
+    if (isDelta)
+      memory.saveDeltaState(checkpointBuf);
+    else
+      memory.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    ioPorts.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    crtc.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    z80.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+#ifdef ENABLE_SDEXT
+    sdext.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+#endif
+    saveVMState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveDeviceCheckpoint_();
+    writeCheckpointData(buf);
+  }
+
+  void TVC64VM::restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.setPosition(0);
+    restoringCheckpoint = true;
+    try {
+      readCheckpointData(buf);
+      if (isDelta)
+        memory.loadDeltaState(checkpointBuf);
+      else
+        memory.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      ioPorts.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      crtc.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      z80.loadState(checkpointBuf);
+#ifdef ENABLE_SDEXT
+      readCheckpointData(buf);
+      sdext.loadState(checkpointBuf);
+#endif
+      readCheckpointData(buf);
+      this->loadState(checkpointBuf);
+      readCheckpointData(buf);
+      restoreDeviceCheckpoint_();
+    }
+    catch (...) {
+      restoringCheckpoint = false;
+      throw;
+    }
+    restoringCheckpoint = false;
+  }
+
+  void TVC64VM::saveCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, false);
+  }
+
+  void TVC64VM::restoreCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, false);
+  }
+
+  void TVC64VM::clearMemoryDirtyBlocks()
+  {
+    memory.clearDirtyBlocks();
+  }
+
+  void TVC64VM::saveDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, true);
+  }
+
+  void TVC64VM::restoreDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, true);
+  }
+
   void TVC64VM::saveMachineConfiguration(Ep128Emu::File& f)
   {
     Ep128Emu::File::Buffer  buf;
@@ -132,11 +287,13 @@ namespace TVC64 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible TVC snapshot version");
     }
-    stopDemo();
-    snapshotLoadFlag = true;
-    // reset floppy and SD card emulation, as the state of these is not saved
-    resetFloppyDrives(true);
-    z80.closeFile();
+    if (!restoringCheckpoint) {
+      stopDemo();
+      snapshotLoadFlag = true;
+      // reset floppy and SD card emulation, as the state of these is not saved
+      resetFloppyDrives(true);
+      z80.closeFile();
+    }
     try {
       z80.triggerInterrupt();
       videoRenderer.setVideoMemory(memory.getVideoMemory());
@@ -177,9 +334,16 @@ namespace TVC64 {
       vtdosROMPage = buf.readByte() & 0x03;
       setTapeMotorState(bool(ioPorts.getLastValueWritten(0x05) & 0xC0));
       (void) buf.readUInt32();          // crtcFrequency (ignored)
-      for (int i = 0; i < 16; i++)
-        keyboardState[i] = buf.readByte();
-      convertKeyboardState();
+      if (!restoringCheckpoint) {
+        for (int i = 0; i < 16; i++)
+          keyboardState[i] = buf.readByte();
+        convertKeyboardState();
+      }
+      else {
+        // keep the current keyboard state when restoring a checkpoint
+        for (int i = 0; i < 16; i++)
+          (void) buf.readByte();
+      }
       if (buf.getPosition() != buf.getDataSize())
         throw Ep128Emu::Exception("trailing garbage at end of "
                                   "TVC snapshot data");
@@ -31,6 +31,7 @@ namespace TVC64 {
     if (segmentTable[n] == (uint8_t *) 0)
       segmentTable[n] = new uint8_t[16384];
     segmentROMTable[n] = isROM;
+    dirtyMap.setSegmentDirty(n);
     setPaging(currentPaging);
   }
 
@@ -363,6 +364,7 @@ namespace TVC64 {
       delete[] segmentTable[segment];
     segmentTable[segment] = (uint8_t*) 0;
     segmentROMTable[segment] = true;
+    dirtyMap.setSegmentDirty(segment);
     setPaging(currentPaging);
   }
 
@@ -470,6 +472,7 @@ namespace TVC64 {
     }
     if (extensionRAM.size() > 0)
       std::memset(&(extensionRAM.front()), 0xFF, extensionRAM.size());
+    dirtyMap.setAllDirty();
   }
 
   Ep128Emu::BreakPointList Memory::getBreakPointList()
@@ -535,8 +538,7 @@ namespace TVC64 {
       if (i == 0xFC && totalRAMSegments < 8)
         i = 0xFF;
       if (segmentTable[i] != (uint8_t *) 0) {
-        for (size_t j = 0; j < 16384; j++)
-          buf.writeByte(segmentTable[i][j]);
+        buf.writeData(segmentTable[i], 16384);
       }
       else {
         for (size_t j = 0; j < 16384; j++)
@@ -544,14 +546,14 @@ namespace TVC64 {
       }
     }
     buf.writeUInt32(uint32_t(extensionRAM.size()));
-    for (size_t i = 0; i < extensionRAM.size(); i++)
-      buf.writeByte(extensionRAM[i]);
+    if (extensionRAM.size() > 0)
+      buf.writeData(&(extensionRAM.front()), extensionRAM.size());
     for (int i = 0x00; i <= 0x04; i++) {
       if (segmentTable[i] != (uint8_t *) 0 &&
           !(i == 0x01 && segment1IsExtension)) {
         buf.writeByte(uint8_t(i));
-        for (size_t j = ((i != 2 && i != 4) ? 0 : 8192); j < 16384; j++)
-          buf.writeByte(segmentTable[i][j]);
+        size_t  offs = ((i != 2 && i != 4) ? 0 : 8192);
+        buf.writeData(segmentTable[i] + offs, 16384 - offs);
       }
     }
   }
@@ -573,6 +575,7 @@ namespace TVC64 {
       throw Ep128Emu::Exception("incompatible TVC memory snapshot format");
     }
     // reset memory
+    dirtyMap.setAllDirty();
     deleteAllSegments();
     try {
       currentPaging = buf.readUInt16();
@@ -590,8 +593,7 @@ namespace TVC64 {
           i = 0xFC;
         if (i == 0xFC && totalRAMSegments < 8)
           i = 0xFF;
-        for (size_t j = 0; j < 16384; j++)
-          segmentTable[i][j] = buf.readByte();
+        buf.readData(segmentTable[i], 16384);
       }
       if (version < 0x01000001) {
         if (extensionRAM.size() > 0)
@@ -601,8 +603,8 @@ namespace TVC64 {
         throw Ep128Emu::Exception("invalid extension RAM size in TVC snapshot");
       }
       else {
-        for (size_t i = 0; i < extensionRAM.size(); i++)
-          extensionRAM[i] = buf.readByte();
+        if (extensionRAM.size() > 0)
+          buf.readData(&(extensionRAM.front()), extensionRAM.size());
       }
       // load ROM segments
       while (buf.getPosition() < buf.getDataSize()) {
@@ -610,11 +612,8 @@ namespace TVC64 {
         if (segment > 0x04)
           throw Ep128Emu::Exception("invalid ROM segment in TVC snapshot");
         allocateSegment(segment, true);
-        for (size_t i = ((segment != 0x02 && segment != 0x04) ? 0 : 8192);
-             i < 16384;
-             i++) {
-          segmentTable[segment][i] = buf.readByte();
-        }
+        size_t  offs = ((segment != 0x02 && segment != 0x04) ? 0 : 8192);
+        buf.readData(segmentTable[segment] + offs, 16384 - offs);
       }
       setPaging(currentPaging);
     }
@@ -627,6 +626,44 @@ namespace TVC64 {
     }
   }
 
+  void Memory::clearDirtyBlocks()
+  {
+    dirtyMap.clear();
+  }
+
+  void Memory::saveDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    buf.writeUInt32(0x02000000);        // delta state version number
+    buf.writeUInt16(currentPaging);
+    buf.writeUInt32(uint32_t(extensionRAM.size()));
+    if (extensionRAM.size() > 0)
+      buf.writeData(&(extensionRAM.front()), extensionRAM.size());
+    dirtyMap.saveDelta(buf, segmentTable, segmentROMTable);
+  }
+
+  void Memory::loadDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    // check version number
+    unsigned int  version = buf.readUInt32();
+    if (version != 0x02000000) {
+      buf.setPosition(buf.getDataSize());
+      throw Ep128Emu::Exception("incompatible TVC memory delta state format");
+    }
+    uint16_t  savedPaging = buf.readUInt16();
+    // extension RAM is not tracked, and is always stored in full
+    if (size_t(buf.readUInt32()) != extensionRAM.size()) {
+      buf.setPosition(buf.getDataSize());
+      throw Ep128Emu::Exception("invalid extension RAM size "
+                                "in TVC delta state");
+    }
+    if (extensionRAM.size() > 0)
+      buf.readData(&(extensionRAM.front()), extensionRAM.size());
+    dirtyMap.loadDelta(buf, segmentTable, segmentROMTable);
+    setPaging(savedPaging);
+  }
+
   void Memory::registerChunkType(Ep128Emu::File& f)
   {
     ChunkType_TVCMemSnapshot  *p;
@@ -22,6 +22,7 @@
 
 #include "ep128emu.hpp"
 #include "bplist.hpp"
+#include "memdirty.hpp"
 
 namespace TVC64 {
 
@@ -47,6 +48,7 @@ namespace TVC64 {
     uint8_t   *dummyMemory; // 2*16K dummy memory for invalid reads and writes
     uint8_t   *pageAddressTableR[8];
     uint8_t   *pageAddressTableW[8];
+    Ep128Emu::MemoryDirtyMap  dirtyMap;
     void allocateSegment(uint8_t n, bool isROM);
     void checkExecuteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkReadBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
@@ -113,6 +115,26 @@ namespace TVC64 {
     void saveState(Ep128Emu::File&);
     void loadState(Ep128Emu::File::Buffer&);
     void registerChunkType(Ep128Emu::File&);
+    /*!
+     * Returns the 1K blocks of 'segment' written since the last call of
+     * clearDirtyBlocks(), bit N is set if block N has changed.
+     * NOTE: writes through getSegmentPtr() are not tracked.
+     */
+    inline uint16_t getDirtyBlocks(uint8_t segment) const;
+    /*!
+     * Use the current memory contents as the base of the next delta state.
+     */
+    void clearDirtyBlocks();
+    /*!
+     * Save the paging and the RAM blocks changed since the last call of
+     * clearDirtyBlocks() to 'buf'.
+     */
+    void saveDeltaState(Ep128Emu::File::Buffer&);
+    /*!
+     * Load a delta state saved by saveDeltaState(). The memory should
+     * already contain the base state the delta was saved relative to.
+     */
+    void loadDeltaState(Ep128Emu::File::Buffer&);
    protected:
     virtual void breakPointCallback(bool isWrite, uint16_t addr, uint8_t value);
     // these functions are used when accessing special memory areas like IOMEM
@@ -179,20 +201,25 @@ namespace TVC64 {
     if (haveBreakPoints)
       checkWriteBreakPoint(addr, page, value);
     pageAddressTableW[page][addr] = value;
+    dirtyMap.setDirty(pageTable[page >> 1], addr);
   }
 
   inline void Memory::writeRaw(uint32_t addr, uint8_t value)
   {
     uint8_t segment = uint8_t(addr >> 14);
-    if (!segmentROMTable[segment])
+    if (!segmentROMTable[segment]) {
       segmentTable[segment][addr & 0x3FFF] = value;
+      dirtyMap.setDirty(segment, uint16_t(addr));
+    }
   }
 
   inline void Memory::writeROM(uint32_t addr, uint8_t value)
   {
     uint8_t segment = uint8_t(addr >> 14);
-    if (segmentTable[segment])
+    if (segmentTable[segment]) {
       segmentTable[segment][addr & 0x3FFF] = value;
+      dirtyMap.setDirty(segment, uint16_t(addr));
+    }
   }
 
   inline uint16_t Memory::getPaging() const
@@ -227,6 +254,11 @@ namespace TVC64 {
     return (segmentTable[segment]);
   }
 
+  inline uint16_t Memory::getDirtyBlocks(uint8_t segment) const
+  {
+    return dirtyMap.getDirtyBlocks(segment);
+  }
+
 }       // namespace TVC64
 
 #endif  // EP128EMU_TVCMEM_HPP
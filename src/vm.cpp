@@ -124,6 +124,7 @@ namespace Ep128Emu {
     : display(display_),
       audioOutput(audioOutput_),
       audioConverter((AudioConverter *) 0),
+      audioInputBufPos(0),
       writingAudioOutput(false),
       audioOutputEnabled(true),
       audioOutputHighQuality(false),
@@ -148,9 +149,11 @@ namespace Ep128Emu {
       tapeEnableSoundFileFilter(false),
       tapeSoundFileFilterMinFreq(500.0f),
       tapeSoundFileFilterMaxFreq(5000.0f),
+      tapeLoaderTrapsEnabled(false),
       breakPointCallback(&defaultBreakPointCallback),
       breakPointCallbackUserData((void *) 0),
       fileIOEnabled(false),
+      restoringCheckpoint(false),
 #ifndef WIN32
       fileIOWorkingDirectory("./"),
 #else
@@ -210,6 +213,68 @@ namespace Ep128Emu {
       stopDemo();
   }
 
+  void VirtualMachine::flushAudioOutput()
+  {
+    if (audioInputBufPos) {
+      if (writingAudioOutput)
+        audioConverter->sendInputSignals(&(audioInputBuf[0]), audioInputBufPos);
+      audioInputBufPos = 0;
+    }
+  }
+
+  void VirtualMachine::writeCheckpointData(File::Buffer& buf)
+  {
+    size_t  nBytes = checkpointBuf.getDataSize();
+    buf.writeUInt32(uint32_t(nBytes));
+    buf.writeData(checkpointBuf.getData(), nBytes);
+    checkpointBuf.truncate();
+  }
+
+  void VirtualMachine::readCheckpointData(File::Buffer& buf)
+  {
+    size_t  nBytes = buf.readUInt32();
+    size_t  pos = buf.getPosition();
+    if (nBytes > (buf.getDataSize() - pos))
+      throw Exception("unexpected end of checkpoint data");
+    checkpointBuf.truncate();
+    checkpointBuf.writeData(buf.getData() + pos, nBytes);
+    checkpointBuf.setPosition(0);
+    buf.setPosition(pos + nBytes);
+  }
+
+  void VirtualMachine::saveTapeCheckpoint()
+  {
+    checkpointBuf.writeBoolean(tapePlaybackOn);
+    checkpointBuf.writeBoolean(tapeRecordOn);
+    checkpointBuf.writeByte(tapeMotorState);
+    checkpointBuf.writeBoolean(tape != (Tape *) 0);
+    if (tape)
+      tape->saveState(checkpointBuf);
+  }
+
+  void VirtualMachine::restoreTapeCheckpoint()
+  {
+    bool    playbackFlag = checkpointBuf.readBoolean();
+    bool    recordFlag = checkpointBuf.readBoolean();
+    uint8_t motorState = checkpointBuf.readByte() & 0x03;
+    bool    haveTapeState = checkpointBuf.readBoolean();
+    if (!tape) {
+      tapePlaybackOn = false;
+      tapeRecordOn = false;
+    }
+    else {
+      tapePlaybackOn = playbackFlag;
+      tapeRecordOn = recordFlag;
+      if (haveTapeState)
+        tape->loadState(checkpointBuf);
+    }
+    // bit 1 (motor forced on) is a user setting, not machine state
+    tapeMotorState = (tapeMotorState & 0x02) | (motorState & 0x01);
+    tapeMotorOn = bool(tapeMotorState);
+    if (tape)
+      tape->setIsMotorOn(tapeMotorOn);
+  }
+
   void VirtualMachine::reset(bool isColdReset)
   {
     (void) isColdReset;
@@ -387,6 +452,7 @@ namespace Ep128Emu {
   void VirtualMachine::getVMStatus(VMStatus& vmStatus_)
   {
     vmStatus_.tapeReadOnly = getIsTapeReadOnly();
+    vmStatus_.tapeMotorOn = (getIsTapeMotorOn() && getTapeButtonState() != 0);
     vmStatus_.tapePosition = getTapePosition();
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
@@ -447,6 +513,16 @@ namespace Ep128Emu {
     (void) nSectorsPerTrack_;
   }
 
+  void VirtualMachine::setDiskOverlayDirectory(const std::string& dirName)
+  {
+    (void) dirName;
+  }
+
+  void VirtualMachine::setFloppyTurboMode(bool isEnabled)
+  {
+    (void) isEnabled;
+  }
+
   uint32_t VirtualMachine::getFloppyDriveLEDState()
   {
     return 0U;
@@ -641,6 +717,11 @@ namespace Ep128Emu {
       tape->setIsMotorOn(tapeMotorOn);
   }
 
+  void VirtualMachine::setEnableTapeLoaderTraps(bool isEnabled)
+  {
+    tapeLoaderTrapsEnabled = isEnabled;
+  }
+
   void VirtualMachine::setBreakPoints(const BreakPointList& bpList)
   {
     for (size_t i = 0; i < bpList.getBreakPointCnt(); i++)
@@ -825,6 +906,34 @@ namespace Ep128Emu {
     return false;
   }
 
+  void VirtualMachine::saveCheckpoint(File::Buffer& buf)
+  {
+    (void) buf;
+    throw Exception("checkpoints are not supported by this machine");
+  }
+
+  void VirtualMachine::restoreCheckpoint(File::Buffer& buf)
+  {
+    (void) buf;
+    throw Exception("checkpoints are not supported by this machine");
+  }
+
+  void VirtualMachine::clearMemoryDirtyBlocks()
+  {
+  }
+
+  void VirtualMachine::saveDeltaCheckpoint(File::Buffer& buf)
+  {
+    (void) buf;
+    throw Exception("checkpoints are not supported by this machine");
+  }
+
+  void VirtualMachine::restoreDeltaCheckpoint(File::Buffer& buf)
+  {
+    (void) buf;
+    throw Exception("checkpoints are not supported by this machine");
+  }
+
   void VirtualMachine::loadState(File::Buffer& buf)
   {
     (void) buf;
@@ -867,6 +976,14 @@ namespace Ep128Emu {
     tape->setIsMotorOn(tapeMotorOn);
   }
 
+  bool VirtualMachine::readTapeDataBlock(std::vector< uint8_t >& buf)
+  {
+    buf.clear();
+    if (!(tapeLoaderTrapsEnabled && tape && tapePlaybackOn) || tapeRecordOn)
+      return false;
+    return tape->readDataBlock(buf);
+  }
+
   void VirtualMachine::setTapeMotorState_(bool newState)
   {
     tapeMotorState = (tapeMotorState & 0x02) | uint8_t(newState);
@@ -40,6 +40,10 @@ namespace Ep128Emu {
    private:
     AudioOutput&    audioOutput;
     AudioConverter  *audioConverter;
+    // raw audio input samples collected during run(), sent to the
+    // audio converter in blocks by flushAudioOutput()
+    uint32_t        audioInputBuf[1024];
+    size_t          audioInputBufPos;
     bool            writingAudioOutput;
     bool            audioOutputEnabled;
     bool            audioOutputHighQuality;
@@ -67,11 +71,17 @@ namespace Ep128Emu {
     bool            tapeEnableSoundFileFilter;
     float           tapeSoundFileFilterMinFreq;
     float           tapeSoundFileFilterMaxFreq;
+    bool            tapeLoaderTrapsEnabled;
    protected:
     void            (*breakPointCallback)(void *userData, int type,
                                           uint16_t addr, uint8_t value);
     void            *breakPointCallbackUserData;
     bool            fileIOEnabled;
+    // temporary buffer for the state of one component, used by
+    // saveCheckpoint() and restoreCheckpoint()
+    File::Buffer    checkpointBuf;
+    // true while restoreCheckpoint() is loading the machine state
+    bool            restoringCheckpoint;
    private:
     std::string     fileIOWorkingDirectory;
     void            (*fileNameCallback)(void *userData, std::string& fileName);
@@ -81,6 +91,8 @@ namespace Ep128Emu {
       bool      isRecordingDemo;
       bool      isPlayingDemo;
       bool      tapeReadOnly;
+      // true if the tape is playing and the motor is on
+      bool      tapeMotorOn;
       double    tapePosition;
       double    tapeLength;
       long      tapeSampleRate;
@@ -288,6 +300,18 @@ namespace Ep128Emu {
     virtual void setDiskImageFile(int n, const std::string& fileName_,
                                   int nTracks_ = -1, int nSides_ = 2,
                                   int nSectorsPerTrack_ = 9);
+    /*!
+     * Set the directory of copy-on-write overlay files for the disk images
+     * loaded later. If not empty, image files are opened read-only, and the
+     * written sectors are stored in delta files in this directory.
+     */
+    virtual void setDiskOverlayDirectory(const std::string& dirName);
+    /*!
+     * If enabled, the floppy disk controller transfers data at the speed
+     * of the CPU, and seek and rotational delays are skipped. Disks with
+     * copy protection are still emulated with accurate timing.
+     */
+    virtual void setFloppyTurboMode(bool isEnabled);
     /*!
      * Returns the current state of the disk drive LEDs, which is the sum
      * of any of the following values:
@@ -418,6 +442,12 @@ namespace Ep128Emu {
      * control from the emulated machine.
      */
     virtual void setForceTapeMotorOn(bool isEnabled);
+    /*!
+     * If enabled, then data blocks are read directly from the tape image
+     * when the ROM tape loader routine of the emulated machine is called,
+     * instead of playing the tape in real time.
+     */
+    virtual void setEnableTapeLoaderTraps(bool isEnabled);
     // ------------------------------ DEBUGGING -------------------------------
     /*!
      * Add breakpoints from the specified breakpoint list (see also
@@ -635,6 +665,42 @@ namespace Ep128Emu {
      * playing a demo.
      */
     virtual bool getIsPlayingDemo() const;
+    /*!
+     * Save a checkpoint of the virtual machine state to 'buf', for use by
+     * restoreCheckpoint(). Checkpoints are faster to create and restore than
+     * snapshots, but are only valid in the same instance of the emulator,
+     * and restoring them does not reset the tape, disk, and keyboard state.
+     * The tape position and the floppy and IDE controller state are
+     * included, but the disk image contents are not, so data written to a
+     * disk after saving the checkpoint is not undone.
+     * This is intended to be used for run-ahead.
+     */
+    virtual void saveCheckpoint(File::Buffer& buf);
+    /*!
+     * Restore virtual machine state from a checkpoint created by
+     * saveCheckpoint(). On error, an exception is thrown.
+     */
+    virtual void restoreCheckpoint(File::Buffer& buf);
+    /*!
+     * Use the current memory contents as the base of the checkpoints saved
+     * by saveDeltaCheckpoint(). Restoring a checkpoint or snapshot marks
+     * all memory as changed, so this needs to be called again after the
+     * base state is restored.
+     */
+    virtual void clearMemoryDirtyBlocks();
+    /*!
+     * Save a checkpoint like saveCheckpoint(), but with only the memory
+     * blocks written since the last call of clearMemoryDirtyBlocks(). This
+     * is intended to be used for rewind, where a full checkpoint is followed
+     * by a series of smaller delta checkpoints.
+     */
+    virtual void saveDeltaCheckpoint(File::Buffer& buf);
+    /*!
+     * Restore a checkpoint created by saveDeltaCheckpoint(). The memory
+     * needs to be in the base state the delta was saved relative to, for
+     * example by restoring the full checkpoint saved at that time first.
+     */
+    virtual void restoreDeltaCheckpoint(File::Buffer& buf);
     // ----------------
     virtual void loadState(File::Buffer& buf);
     virtual void loadMachineConfiguration(File::Buffer& buf);
@@ -642,26 +708,61 @@ namespace Ep128Emu {
    protected:
     inline void sendAudioOutput(uint32_t audioData)
     {
-      if (this->writingAudioOutput)
-        this->audioConverter->sendInputSignal(audioData);
+      if (this->writingAudioOutput) {
+        this->audioInputBuf[this->audioInputBufPos] = audioData;
+        if (++(this->audioInputBufPos) >= 1024)
+          this->flushAudioOutput();
+      }
     }
     inline void sendAudioOutput(uint16_t left, uint16_t right)
     {
-      if (this->writingAudioOutput)
-        this->audioConverter->sendInputSignal(uint32_t(left)
-                                              | (uint32_t(right) << 16));
+      sendAudioOutput(uint32_t(left) | (uint32_t(right) << 16));
     }
     inline void sendMonoAudioOutput(int32_t audioData)
     {
-      if (this->writingAudioOutput)
+      if (this->writingAudioOutput) {
+        this->flushAudioOutput();
         this->audioConverter->sendMonoInputSignal(audioData);
+      }
     }
+    /*!
+     * Send any audio input samples buffered by sendAudioOutput() to the
+     * audio converter. Should be called by derived classes at the end of
+     * run().
+     */
+    void flushAudioOutput();
+    /*!
+     * Append the contents of 'checkpointBuf' to 'buf' as the next block of
+     * checkpoint data, and clear 'checkpointBuf'.
+     */
+    void writeCheckpointData(File::Buffer& buf);
+    /*!
+     * Read the next block of checkpoint data from 'buf' to 'checkpointBuf'.
+     */
+    void readCheckpointData(File::Buffer& buf);
+    /*!
+     * Write the tape button and motor state, and the playback state of the
+     * tape (if any) to 'checkpointBuf'.
+     */
+    void saveTapeCheckpoint();
+    /*!
+     * Restore the tape state saved by saveTapeCheckpoint() from
+     * 'checkpointBuf'. The tape position is left unchanged if the tape has
+     * been removed or inserted since the checkpoint was saved.
+     */
+    void restoreTapeCheckpoint();
     /*!
      * This function is similar to the public setTapeFileName(), but allows
      * derived classes to use a different sample size than the default of
      * 1 bit.
      */
     void setTapeFileName(const std::string& fileName, int bitsPerSample);
+    /*!
+     * Read the next data block from the tape to 'buf', for use by ROM loader
+     * traps. Returns false if loader traps are disabled, the tape is not
+     * playing, or no data block is found.
+     */
+    bool readTapeDataBlock(std::vector< uint8_t >& buf);
    private:
     void setTapeMotorState_(bool newState);
    protected:
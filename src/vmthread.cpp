@@ -41,6 +41,10 @@ namespace Ep128Emu {
       lockCnt(0UL),
       threadLock1(true),
       threadLock2(true),
+#ifdef EP128EMU_LIBRETRO_CORE
+      runAllowedLock(false),
+      runDoneLock(false),
+#endif // EP128EMU_LIBRETRO_CORE
       messageQueue((Message *) 0),
       lastMessage((Message *) 0),
       freeMessageStack((Message *) 0),
@@ -181,6 +185,11 @@ namespace Ep128Emu {
       else {
 #ifndef EP128EMU_LIBRETRO_CORE
         Timer::wait(0.01);
+#else
+        // sleep until the next frame is requested instead of polling;
+        // the timeout only limits the latency of processing messages
+        if (!runAllowed)
+          runAllowedLock.wait(10);
 #endif // EP128EMU_LIBRETRO_CORE
         curTime = speedTimer.getRealTime();
         nxtTime = curTime;
@@ -202,7 +211,12 @@ namespace Ep128Emu {
     // update status information
     mutex_.lock();
 #ifdef EP128EMU_LIBRETRO_CORE
-    if (runAllowed) allowedRuntime -= 2000;
+    if (runAllowed) {
+      allowedRuntime -= 2000;
+      // wake up the main thread as soon as the frame is complete
+      if (allowedRuntime < 2000)
+        runDoneLock.notify();
+    }
 #endif // EP128EMU_LIBRETRO_CORE
     float   deltaTime = float(curTime - prvTime);
     prvTime = curTime;
@@ -250,6 +264,7 @@ namespace Ep128Emu {
     isRecordingDemo = vmThread_.vmStatus.isRecordingDemo;
     isPlayingDemo = vmThread_.vmStatus.isPlayingDemo;
     tapeReadOnly = vmThread_.vmStatus.tapeReadOnly;
+    tapeMotorOn = vmThread_.vmStatus.tapeMotorOn;
     tapePosition = vmThread_.vmStatus.tapePosition;
     tapeLength = vmThread_.vmStatus.tapeLength;
     tapeSampleRate = vmThread_.vmStatus.tapeSampleRate;
@@ -276,6 +291,9 @@ namespace Ep128Emu {
     }
     threadLock1.wait(0);
     threadLock2.wait(0);
+#ifdef EP128EMU_LIBRETRO_CORE
+    runAllowedLock.notify();
+#endif // EP128EMU_LIBRETRO_CORE
     mutex_.unlock();
     bool  tmp = threadLock2.wait(t);
     mutex_.lock();
@@ -317,6 +335,10 @@ namespace Ep128Emu {
     pauseFlag = true;
     lockCnt = 0UL;
     threadLock1.notify();
+#ifdef EP128EMU_LIBRETRO_CORE
+    runAllowedLock.notify();
+    runDoneLock.notify();
+#endif // EP128EMU_LIBRETRO_CORE
     if (joinFlag || !waitFlag_) {
       mutex_.unlock();
       return;
@@ -420,14 +442,26 @@ namespace Ep128Emu {
     mutex_.lock();
     allowedRuntime = allowedRuntime > microseconds * 10 ? allowedRuntime : allowedRuntime + microseconds;
     //allowedRuntime = allowedRuntime + microseconds;
+    if (allowedRuntime >= 2000)
+      runAllowedLock.notify();
     mutex_.unlock();
   }
 
   bool VMThread::isReady(void)
   {
-    if (allowedRuntime > 2000)
-      return false;
-    else return true;
+    mutex_.lock();
+    bool  retval = (allowedRuntime < 2000 || exitFlag);
+    mutex_.unlock();
+    return retval;
+  }
+
+  void VMThread::waitUntilReady(void)
+  {
+    while (!isReady()) {
+      // runDoneLock may still be signaled from a previous frame,
+      // in which case the state is simply checked again
+      runDoneLock.wait(100);
+    }
   }
 
 
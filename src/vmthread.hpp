@@ -45,6 +45,12 @@ namespace Ep128Emu {
     unsigned long   lockCnt;
     ThreadLock      threadLock1;
     ThreadLock      threadLock2;
+#ifdef EP128EMU_LIBRETRO_CORE
+    // signaled by allowRunFor() when there is new runtime to be consumed
+    ThreadLock      runAllowedLock;
+    // signaled by the emulation thread when the allowed runtime is used up
+    ThreadLock      runDoneLock;
+#endif // EP128EMU_LIBRETRO_CORE
     Timer           speedTimer;
     Message         *messageQueue;
     Message         *lastMessage;
@@ -58,7 +64,7 @@ namespace Ep128Emu {
     float           avgTimesliceLength;
     double          prvTime;
     double          nxtTime;
-    volatile size_t allowedRuntime;
+    size_t          allowedRuntime;
     VirtualMachine::VMStatus  vmStatus;
     void            *userData;
     void            (*errorCallback)(void *userData_, const char *msg);
@@ -95,6 +101,13 @@ namespace Ep128Emu {
      * True if VM has already consumed the execution time set up in allowRunFor.
      */
     bool isReady(void);
+#ifdef EP128EMU_LIBRETRO_CORE
+    /*!
+     * Block the calling thread until the VM has consumed the execution time
+     * set up in allowRunFor(), or the emulation thread has terminated.
+     */
+    void waitUntilReady(void);
+#endif // EP128EMU_LIBRETRO_CORE
     /*!
      * Pause emulation if 'n' is true, or continue if 'n' is false.
      * NOTE: the initial state is pause=true.
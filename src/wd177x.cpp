@@ -641,6 +641,38 @@ namespace Ep128Emu {
     writeTrackState = 0xFF;
   }
 
+  void WD177x::saveState(File::Buffer& buf)
+  {
+    buf.writeByte(commandRegister);
+    buf.writeByte(statusRegister);
+    buf.writeByte(trackRegister);
+    buf.writeByte(sectorRegister);
+    buf.writeByte(dataRegister);
+    buf.writeBoolean(interruptRequestFlag);
+    buf.writeBoolean(dataRequestFlag);
+    buf.writeBoolean(steppingIn);
+    buf.writeBoolean(busyFlagHack);
+    buf.writeByte(writeTrackSectorsRemaining);
+    buf.writeByte(writeTrackState);
+  }
+
+  void WD177x::loadState(File::Buffer& buf, FloppyDrive *d)
+  {
+    // select the drive without aborting the command in progress
+    floppyDrive = (d ? d : &dummyFloppyDrive);
+    commandRegister = buf.readByte();
+    statusRegister = buf.readByte();
+    trackRegister = buf.readByte();
+    sectorRegister = buf.readByte();
+    dataRegister = buf.readByte();
+    interruptRequestFlag = buf.readBoolean();
+    dataRequestFlag = buf.readBoolean();
+    steppingIn = buf.readBoolean();
+    busyFlagHack = buf.readBoolean();
+    writeTrackSectorsRemaining = buf.readByte();
+    writeTrackState = buf.readByte();
+  }
+
   void WD177x::interruptRequest()
   {
   }
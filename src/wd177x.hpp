@@ -101,6 +101,10 @@ namespace Ep128Emu {
     }
     void setEnableBusyFlagHack(bool isEnabled);
     virtual void reset(bool isColdReset);
+    // save and restore the controller registers for virtual machine
+    // checkpoints, 'd' is the drive selected when the state was saved
+    void saveState(File::Buffer& buf);
+    void loadState(File::Buffer& buf, FloppyDrive *d);
    protected:
     virtual void interruptRequest();
     virtual void clearInterruptRequest();
@@ -29,6 +29,7 @@
 #include "zx128vm.hpp"
 #include "debuglib.hpp"
 #include "videorec.hpp"
+#include "profiler.hpp"
 #include "roms/roms.hpp"
 #include <vector>
 
@@ -129,12 +130,9 @@ namespace ZX128 {
 
   EP128EMU_REGPARM1 void ZX128VM::runOneCycle()
   {
-    ZX128VMCallback *p = firstCallback;
-    while (p) {
-      ZX128VMCallback *nxt = p->nxt;
-      p->func(p->userData);
-      p = nxt;
-    }
+    if (EP128EMU_UNLIKELY(callbackTime >= nextCallbackTime))
+      runCallbacks();
+    callbackTime++;
     if (--ayCycleCnt == 0) {
       ayCycleCnt = 4;
       uint32_t  tmp = soundOutputAccumulator;
@@ -215,6 +213,10 @@ namespace ZX128 {
       readTapeFile();
       addr = uint16_t(R.PC.W.l);
     }
+    else if (addr == 0x056B) {
+      loadTapeBlock();
+      addr = uint16_t(R.PC.W.l);
+    }
     if (!vm.singleStepMode) {
       uint8_t   retval = vm.memory.readOpcode(addr);
       vm.updateCPUHalfCycles(4);
@@ -354,6 +356,51 @@ namespace ZX128 {
     }
   }
 
+  void ZX128VM::Z80_::loadTapeBlock()
+  {
+    // LD-BREAK in the LD-BYTES routine of the 48K ROM: if loader traps are
+    // enabled, load the whole block from the tape, and continue at the end
+    // of the routine (LD A,H; CP 01H; RET)
+    if (vm.spectrum128Mode && (vm.spectrum128PageRegister & 0x10) == 0)
+      return;
+    if (vm.isRecordingDemo | vm.isPlayingDemo | (!(R.AF.B.l & 0x40)))
+      return;                           // or BREAK is pressed (RET NZ)
+    if (vm.memory.readNoDebug(0x056B) != 0xC0 ||
+        vm.memory.readNoDebug(0x05DF) != 0x7C ||
+        vm.memory.readNoDebug(0x05E0) != 0xFE ||
+        vm.memory.readNoDebug(0x05E1) != 0x01 ||
+        vm.memory.readNoDebug(0x05E2) != 0xC9) {
+      return;                           // not the original ROM
+    }
+    std::vector< uint8_t >  buf;
+    if (!vm.readTapeDataBlock(buf))
+      return;
+    uint8_t   parity = 0xFF;            // error
+    if (buf.size() > 0 && buf[0] == R.altAF.B.h) {
+      bool      verifyMode = !(R.altAF.B.l & 0x01);
+      parity = buf[0];
+      size_t    i = 0;
+      while (R.DE.W != 0 && (i + 2) < buf.size()) {
+        uint8_t   c = buf[i + 1];
+        if (!verifyMode)
+          vm.memory.write(R.IX.W, c);
+        else if (vm.memory.readNoDebug(R.IX.W) != c)
+          break;
+        parity = parity ^ c;
+        R.HL.B.l = c;
+        R.IX.W = (R.IX.W + 1) & 0xFFFF;
+        R.DE.W = (R.DE.W - 1) & 0xFFFF;
+        i++;
+      }
+      if (R.DE.W == 0 && (i + 1) < buf.size())
+        parity = parity ^ buf[i + 1];   // parity byte
+      else
+        parity = 0xFF;
+    }
+    R.HL.B.h = parity;
+    R.PC.W.l = 0x05DF;
+  }
+
   void ZX128VM::Z80_::readTapeFile()
   {
     if (vm.spectrum128Mode && (vm.spectrum128PageRegister & 0x10) == 0)
@@ -642,7 +689,7 @@ namespace ZX128 {
     return retval;
   }
 
-  void ZX128VM::tapeCallback(void *userData)
+  uint32_t ZX128VM::tapeCallback(void *userData)
   {
     ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
     vm.tapeSamplesRemaining += vm.tapeSamplesPerULACycle;
@@ -651,9 +698,17 @@ namespace ZX128 {
       vm.tapeSamplesRemaining -= (int64_t(1) << 32);
       vm.ula.setTapeInput(vm.runTape(vm.ula.getTapeOutput()));
     }
+    // skip the cycles until the next tape sample is due
+    if (vm.tapeSamplesPerULACycle < 1)
+      return 1U;
+    int64_t n = (-vm.tapeSamplesRemaining) / vm.tapeSamplesPerULACycle;
+    if (n < 1)
+      return 1U;
+    vm.tapeSamplesRemaining += (n * vm.tapeSamplesPerULACycle);
+    return uint32_t(n + 1);
   }
 
-  void ZX128VM::demoPlayCallback(void *userData)
+  uint32_t ZX128VM::demoPlayCallback(void *userData)
   {
     ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
     while (!vm.demoTimeCnt) {
@@ -695,18 +750,21 @@ namespace ZX128 {
     }
     if (vm.demoTimeCnt)
       vm.demoTimeCnt--;
+    return 1U;
   }
 
-  void ZX128VM::demoRecordCallback(void *userData)
+  uint32_t ZX128VM::demoRecordCallback(void *userData)
   {
     ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
     vm.demoTimeCnt++;
+    return 1U;
   }
 
-  void ZX128VM::videoCaptureCallback(void *userData)
+  uint32_t ZX128VM::videoCaptureCallback(void *userData)
   {
     ZX128VM&  vm = *(reinterpret_cast<ZX128VM *>(userData));
     vm.videoCapture->runOneCycle(vm.soundOutputSignal);
+    return 1U;
   }
 
   uint8_t ZX128VM::checkSingleStepModeBreak()
@@ -824,7 +882,7 @@ namespace ZX128 {
     }
   }
 
-  void ZX128VM::setCallback(void (*func)(void *userData), void *userData_,
+  void ZX128VM::setCallback(uint32_t (*func)(void *userData), void *userData_,
                             bool isEnabled)
   {
     if (!func)
@@ -852,7 +910,7 @@ namespace ZX128 {
         p = p->nxt;
       }
       if (!isEnabled) {
-        callbacks[ndx].func = (void (*)(void *)) 0;
+        callbacks[ndx].func = (uint32_t (*)(void *)) 0;
         callbacks[ndx].userData = (void *) 0;
         callbacks[ndx].nxt = (ZX128VMCallback *) 0;
       }
@@ -861,7 +919,7 @@ namespace ZX128 {
       return;
     if (ndx < 0) {
       for (size_t i = 0; i < maxCallbacks; i++) {
-        if (callbacks[i].func == (void (*)(void *)) 0) {
+        if (callbacks[i].func == (uint32_t (*)(void *)) 0) {
           ndx = int(i);
           break;
         }
@@ -872,6 +930,9 @@ namespace ZX128 {
     callbacks[ndx].func = func;
     callbacks[ndx].userData = userData_;
     callbacks[ndx].nxt = (ZX128VMCallback *) 0;
+    callbacks[ndx].nextTime = callbackTime;
+    if (callbackTime < nextCallbackTime)
+      nextCallbackTime = callbackTime;
     if (isEnabled) {
       ZX128VMCallback   *prv = (ZX128VMCallback *) 0;
       ZX128VMCallback   *p = firstCallback;
@@ -887,6 +948,25 @@ namespace ZX128 {
     }
   }
 
+  EP128EMU_REGPARM1 void ZX128VM::runCallbacks()
+  {
+    uint64_t  t = callbackTime;
+    uint64_t  nextTime = ~(uint64_t(0));
+    nextCallbackTime = nextTime;
+    ZX128VMCallback *p = firstCallback;
+    while (p) {
+      ZX128VMCallback *nxt = p->nxt;
+      if (p->nextTime <= t)
+        p->nextTime = t + p->func(p->userData);
+      if (p->nextTime < nextTime)
+        nextTime = p->nextTime;
+      p = nxt;
+    }
+    // setCallback() may have also changed nextCallbackTime
+    if (nextTime < nextCallbackTime)
+      nextCallbackTime = nextTime;
+  }
+
   // --------------------------------------------------------------------------
 
   ZX128VM::ZX128VM(Ep128Emu::VideoDisplay& display_,
@@ -918,13 +998,15 @@ namespace ZX128 {
       demoTimeCnt(0UL),
       breakPointPriorityThreshold(0),
       firstCallback((ZX128VMCallback *) 0),
+      callbackTime(0U),
+      nextCallbackTime(~(uint64_t(0))),
       videoCapture((Ep128Emu::VideoCapture *) 0),
       tapeSamplesPerULACycle(0L),
       tapeSamplesRemaining(0L),
       ulaFrequency(886724)
   {
     for (size_t i = 0; i < (sizeof(callbacks) / sizeof(ZX128VMCallback)); i++) {
-      callbacks[i].func = (void (*)(void *)) 0;
+      callbacks[i].func = (uint32_t (*)(void *)) 0;
       callbacks[i].userData = (void *) 0;
       callbacks[i].nxt = (ZX128VMCallback *) 0;
     }
@@ -962,6 +1044,7 @@ namespace ZX128 {
 
   void ZX128VM::run(size_t microseconds)
   {
+    EP128EMU_PROFILE_SCOPE(PROFILER_VM_RUN);
     Ep128Emu::VirtualMachine::run(microseconds);
     if (snapshotLoadFlag) {
       snapshotLoadFlag = false;
@@ -992,6 +1075,7 @@ namespace ZX128 {
         } while (z80OpcodeHalfCycles >= 8);
       }
     }
+    flushAudioOutput();
   }
 
   void ZX128VM::reset(bool isColdReset)
@@ -1123,6 +1207,7 @@ namespace ZX128 {
   void ZX128VM::getVMStatus(VMStatus& vmStatus_)
   {
     vmStatus_.tapeReadOnly = getIsTapeReadOnly();
+    vmStatus_.tapeMotorOn = (getIsTapeMotorOn() && getTapeButtonState() != 0);
     vmStatus_.tapePosition = getTapePosition();
     vmStatus_.tapeLength = getTapeLength();
     vmStatus_.tapeSampleRate = getTapeSampleRate();
@@ -1481,3 +1566,10 @@ namespace ZX128 {
 
 }       // namespace ZX128
 
+
+// The Z80 instruction decoder is instantiated here, so that it can call the
+// memory and I/O functions of ZX128VM::Z80_ directly.
+
+#include "z80core.hpp"
+
+template class Ep128::Z80Core<ZX128::ZX128VM::Z80_>;
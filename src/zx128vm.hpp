@@ -71,6 +71,7 @@ namespace ZX128 {
       virtual EP128EMU_REGPARM2 void updateCycles(int cycles);
      private:
       void readTapeFile();
+      void loadTapeBlock();
      public:
       void rewindTapeFile();
       void closeTapeFile();
@@ -107,7 +108,7 @@ namespace ZX128 {
       virtual void irqPollEnableCallback(bool isEnabled);
     };
     // ----------------
-    Z80_      z80;
+    Ep128::Z80Core<Z80_>  z80;
     Memory_   memory;
     IOPorts_  ioPorts;
     AY3_8912  ay3;
@@ -152,12 +153,16 @@ namespace ZX128 {
     uint64_t  demoTimeCnt;
     uint8_t   breakPointPriorityThreshold;
     struct ZX128VMCallback {
-      void      (*func)(void *);
+      uint32_t  (*func)(void *);
       void      *userData;
       ZX128VMCallback *nxt;
+      uint64_t  nextTime;
     };
     ZX128VMCallback   callbacks[16];
     ZX128VMCallback   *firstCallback;
+    // current ULA cycle, and the earliest time a callback is due
+    uint64_t  callbackTime;
+    uint64_t  nextCallbackTime;
     Ep128Emu::VideoCapture  *videoCapture;
     int64_t   tapeSamplesPerULACycle;
     int64_t   tapeSamplesRemaining;
@@ -176,20 +181,33 @@ namespace ZX128 {
     static void ioPortWriteCallback(void *userData,
                                     uint16_t addr, uint8_t value);
     static uint8_t ioPortDebugReadCallback(void *userData, uint16_t addr);
-    static void tapeCallback(void *userData);
-    static void demoPlayCallback(void *userData);
-    static void demoRecordCallback(void *userData);
-    static void videoCaptureCallback(void *userData);
+    static uint32_t tapeCallback(void *userData);
+    static uint32_t demoPlayCallback(void *userData);
+    static uint32_t demoRecordCallback(void *userData);
+    static uint32_t videoCaptureCallback(void *userData);
     void stopDemoPlayback();
     void stopDemoRecording(bool writeFile_);
+    // write the state of the machine that is not stored by the components
+    void saveVMState(Ep128Emu::File::Buffer& buf);
+    // if 'isDelta' is true, only the changed memory blocks are stored
+    void saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    void restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta);
+    // state that is only stored in checkpoints: the time remaining from
+    // the last run() call, and the tape and disk drive emulation
+    void saveDeviceCheckpoint_();
+    void restoreDeviceCheckpoint_();
     uint8_t checkSingleStepModeBreak();
     void convertKeyboardState();
     void resetKeyboard();
     void initializeMemoryPaging();
     // Set function to be called at every ULA cycle. The functions are called
     // in the order of being registered; up to 16 callbacks can be set.
-    void setCallback(void (*func)(void *userData), void *userData_,
+    // Each function returns the number of ULA cycles after which it is to
+    // be called again (1 = next cycle).
+    void setCallback(uint32_t (*func)(void *userData), void *userData_,
                      bool isEnabled);
+    // call the functions that are due at the current ULA cycle
+    EP128EMU_REGPARM1 void runCallbacks();
    public:
     ZX128VM(Ep128Emu::VideoDisplay&, Ep128Emu::AudioOutput&);
     virtual ~ZX128VM();
@@ -447,6 +465,15 @@ namespace ZX128 {
      * playing a demo.
      */
     virtual bool getIsPlayingDemo() const;
+    /*!
+     * Save or restore a checkpoint of the virtual machine state for
+     * run-ahead (see Ep128Emu::VirtualMachine::saveCheckpoint()).
+     */
+    virtual void saveCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void clearMemoryDirtyBlocks();
+    virtual void saveDeltaCheckpoint(Ep128Emu::File::Buffer&);
+    virtual void restoreDeltaCheckpoint(Ep128Emu::File::Buffer&);
     // ----------------
     virtual void loadState(Ep128Emu::File::Buffer&);
     virtual void loadMachineConfiguration(Ep128Emu::File::Buffer&);
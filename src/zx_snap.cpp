@@ -35,19 +35,148 @@ namespace ZX128 {
     z80.saveState(f);
     {
       Ep128Emu::File::Buffer  buf;
-      buf.setPosition(0);
-      buf.writeUInt32(0x01000000);      // version number
-      buf.writeByte(spectrum128PageRegister);
-      buf.writeByte(ayRegisterSelected);
-      buf.writeByte(ayCycleCnt - 1);
-      buf.writeByte(z80OpcodeHalfCycles);
-      buf.writeUInt32(uint32_t(ulaFrequency));
-      for (int i = 0; i < 16; i++)
-        buf.writeByte(keyboardState[i]);
+      saveVMState(buf);
       f.addChunk(Ep128Emu::File::EP128EMU_CHUNKTYPE_ZXVM_STATE, buf);
     }
   }
 
+  void ZX128VM::saveVMState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    buf.writeUInt32(0x01000000);        // version number
+    buf.writeByte(spectrum128PageRegister);
+    buf.writeByte(ayRegisterSelected);
+    buf.writeByte(ayCycleCnt - 1);
+    buf.writeByte(z80OpcodeHalfCycles);
+    buf.writeUInt32(uint32_t(ulaFrequency));
+    for (int i = 0; i < 16; i++)
+      buf.writeByte(keyboardState[i]);
+  }
+
+  void ZX128VM::saveDeviceCheckpoint_()
+  {
+    checkpointBuf.writeUInt32(0x01000000);      // version number
+    checkpointBuf.writeUInt32(ulaCyclesRemainingL);
+    checkpointBuf.writeInt32(ulaCyclesRemainingH);
+    // time until the next tape sample
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(ZX128VMCallback);
+    uint32_t  tapeCallbackDelay = 0U;
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback &&
+          callbacks[i].nextTime > callbackTime) {
+        tapeCallbackDelay = uint32_t(callbacks[i].nextTime - callbackTime);
+      }
+    }
+    checkpointBuf.writeBoolean(tapeCallbackFlag);
+    checkpointBuf.writeUInt32(tapeCallbackDelay);
+    checkpointBuf.writeInt64(tapeSamplesRemaining);
+    // stored last, as it is not read if the tape has been removed
+    saveTapeCheckpoint();
+  }
+
+  void ZX128VM::restoreDeviceCheckpoint_()
+  {
+    // check version number
+    unsigned int  version = checkpointBuf.readUInt32();
+    if (version != 0x01000000) {
+      checkpointBuf.setPosition(checkpointBuf.getDataSize());
+      throw Ep128Emu::Exception("incompatible zx128 checkpoint version");
+    }
+    ulaCyclesRemainingL = checkpointBuf.readUInt32();
+    ulaCyclesRemainingH = checkpointBuf.readInt32();
+    bool      tapeCallbackFlag_ = checkpointBuf.readBoolean();
+    uint32_t  tapeCallbackDelay = checkpointBuf.readUInt32();
+    tapeSamplesRemaining = checkpointBuf.readInt64();
+    restoreTapeCheckpoint();
+    if (tapeCallbackFlag_ != tapeCallbackFlag) {
+      tapeCallbackFlag = tapeCallbackFlag_;
+      if (!tapeCallbackFlag)
+        ula.setTapeInput(0);
+      setCallback(&tapeCallback, this, tapeCallbackFlag);
+    }
+    const size_t  maxCallbacks = sizeof(callbacks) / sizeof(ZX128VMCallback);
+    for (size_t i = 0; i < maxCallbacks; i++) {
+      if (callbacks[i].func == &tapeCallback) {
+        callbacks[i].nextTime = callbackTime + tapeCallbackDelay;
+        if (callbacks[i].nextTime < nextCallbackTime)
+          nextCallbackTime = callbacks[i].nextTime;
+      }
+    }
+  }
+
+  void ZX128VM::saveCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.truncate();
+    if (isDelta)
+      memory.saveDeltaState(checkpointBuf);
+    else
+      memory.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    ula.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    ay3.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    z80.saveState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveVMState(checkpointBuf);
+    writeCheckpointData(buf);
+    saveDeviceCheckpoint_();
+    writeCheckpointData(buf);
+  }
+
+  void ZX128VM::restoreCheckpoint_(Ep128Emu::File::Buffer& buf, bool isDelta)
+  {
+    buf.setPosition(0);
+    restoringCheckpoint = true;
+    try {
+      readCheckpointData(buf);
+      if (isDelta)
+        memory.loadDeltaState(checkpointBuf);
+      else
+        memory.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      ula.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      ay3.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      z80.loadState(checkpointBuf);
+      readCheckpointData(buf);
+      this->loadState(checkpointBuf);
+      readCheckpointData(buf);
+      restoreDeviceCheckpoint_();
+    }
+    catch (...) {
+      restoringCheckpoint = false;
+      throw;
+    }
+    restoringCheckpoint = false;
+  }
+
+  void ZX128VM::saveCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, false);
+  }
+
+  void ZX128VM::restoreCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, false);
+  }
+
+  void ZX128VM::clearMemoryDirtyBlocks()
+  {
+    memory.clearDirtyBlocks();
+  }
+
+  void ZX128VM::saveDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    saveCheckpoint_(buf, true);
+  }
+
+  void ZX128VM::restoreDeltaCheckpoint(Ep128Emu::File::Buffer& buf)
+  {
+    restoreCheckpoint_(buf, true);
+  }
+
   void ZX128VM::saveMachineConfiguration(Ep128Emu::File& f)
   {
     Ep128Emu::File::Buffer  buf;
@@ -105,9 +234,11 @@ namespace ZX128 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible zx128 snapshot version");
     }
-    stopDemo();
-    snapshotLoadFlag = true;
-    z80.closeTapeFile();
+    if (!restoringCheckpoint) {
+      stopDemo();
+      snapshotLoadFlag = true;
+      z80.closeTapeFile();
+    }
     try {
       spectrum128PageRegister = buf.readByte();
       for (uint8_t i = 0x08; i < 0x80; i++)
@@ -120,9 +251,18 @@ namespace ZX128 {
       ayCycleCnt = (buf.readByte() & 3) + 1;
       z80OpcodeHalfCycles = buf.readByte();
       (void) buf.readUInt32();          // ulaFrequency (ignored)
-      for (int i = 0; i < 16; i++)
-        keyboardState[i] = buf.readByte();
-      convertKeyboardState();
+      if (!restoringCheckpoint) {
+        for (int i = 0; i < 16; i++)
+          keyboardState[i] = buf.readByte();
+        convertKeyboardState();
+      }
+      else {
+        // keep the current keyboard state when restoring a checkpoint,
+        // but copy it to the ULA, which has been restored from the checkpoint
+        for (int i = 0; i < 16; i++)
+          (void) buf.readByte();
+        convertKeyboardState();
+      }
       if (buf.getPosition() != buf.getDataSize())
         throw Ep128Emu::Exception("trailing garbage at end of "
                                   "zx128 snapshot data");
@@ -27,6 +27,7 @@ namespace ZX128 {
     if (segmentTable[n] == (uint8_t *) 0)
       segmentTable[n] = new uint8_t[16384];
     segmentROMTable[n] = isROM;
+    dirtyMap.setSegmentDirty(n);
     for (uint8_t i = 0; i < 4; i++)
       setPage(i, getPage(i));
   }
@@ -302,6 +303,7 @@ namespace ZX128 {
       delete[] segmentTable[segment];
     segmentTable[segment] = (uint8_t *) 0;
     segmentROMTable[segment] = true;
+    dirtyMap.setSegmentDirty(segment);
     for (uint8_t i = 0; i < 4; i++)
       setPage(i, getPage(i));
   }
@@ -409,8 +411,7 @@ namespace ZX128 {
         if (segmentTable[i] != (uint8_t *) 0) {
           buf.writeByte(uint8_t(i));
           buf.writeBoolean(segmentROMTable[i]);
-          for (size_t j = 0; j < 16384; j++)
-            buf.writeByte(segmentTable[i][j]);
+          buf.writeData(segmentTable[i], 16384);
         }
       }
     }
@@ -432,26 +433,60 @@ namespace ZX128 {
       buf.setPosition(buf.getDataSize());
       throw Ep128Emu::Exception("incompatible memory snapshot format");
     }
-    // reset memory
-    deleteAllSegments();
-    setPage(0, 0x00);
-    setPage(1, 0x00);
-    setPage(2, 0x00);
-    setPage(3, 0x00);
-    // now load saved state
-    setPage(0, buf.readByte());
-    setPage(1, buf.readByte());
-    setPage(2, buf.readByte());
-    setPage(3, buf.readByte());
+    uint8_t savedPageTable[4];
+    for (int i = 0; i < 4; i++)
+      savedPageTable[i] = buf.readByte();
+    // load saved segments in place, reusing already allocated memory
+    bool    segmentLoaded[256];
+    for (int i = 0; i < 256; i++)
+      segmentLoaded[i] = false;
     while (buf.getPosition() < buf.getDataSize()) {
       uint8_t segment = buf.readByte();
-      // allocate space
-      loadSegment(segment, false, (uint8_t *) 0, 0);
       // set ROM flag and load data
       allocateSegment(segment, buf.readBoolean());
-      for (size_t i = 0; i < 16384; i++)
-        segmentTable[segment][i] = buf.readByte();
+      buf.readData(segmentTable[segment], 16384);
+      segmentLoaded[segment] = true;
     }
+    // delete any segments that are not present in the snapshot
+    for (int i = 0; i < 256; i++) {
+      if (!segmentLoaded[i] && segmentTable[i] != (uint8_t *) 0)
+        deleteSegment(uint8_t(i));
+    }
+    for (uint8_t i = 0; i < 4; i++)
+      setPage(i, savedPageTable[i]);
+  }
+
+  void Memory::clearDirtyBlocks()
+  {
+    dirtyMap.clear();
+  }
+
+  void Memory::saveDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    buf.writeUInt32(0x02000000U);       // delta state version number
+    buf.writeByte(pageTable[0]);
+    buf.writeByte(pageTable[1]);
+    buf.writeByte(pageTable[2]);
+    buf.writeByte(pageTable[3]);
+    dirtyMap.saveDelta(buf, segmentTable, segmentROMTable);
+  }
+
+  void Memory::loadDeltaState(Ep128Emu::File::Buffer& buf)
+  {
+    buf.setPosition(0);
+    // check version number
+    unsigned int  version = buf.readUInt32();
+    if (version != 0x02000000U) {
+      buf.setPosition(buf.getDataSize());
+      throw Ep128Emu::Exception("incompatible memory delta state format");
+    }
+    uint8_t savedPageTable[4];
+    for (int i = 0; i < 4; i++)
+      savedPageTable[i] = buf.readByte();
+    dirtyMap.loadDelta(buf, segmentTable, segmentROMTable);
+    for (uint8_t i = 0; i < 4; i++)
+      setPage(i, savedPageTable[i]);
   }
 
   void Memory::registerChunkType(Ep128Emu::File& f)
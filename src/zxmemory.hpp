@@ -22,6 +22,7 @@
 
 #include "ep128emu.hpp"
 #include "bplist.hpp"
+#include "memdirty.hpp"
 
 namespace ZX128 {
 
@@ -39,6 +40,7 @@ namespace ZX128 {
     uint8_t *dummyMemory;   // 2*16K dummy memory for invalid reads and writes
     uint8_t *pageAddressTableR[4];
     uint8_t *pageAddressTableW[4];
+    Ep128Emu::MemoryDirtyMap  dirtyMap;
     void allocateSegment(uint8_t n, bool isROM);
     void checkExecuteBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
     void checkReadBreakPoint(uint16_t addr, uint8_t page, uint8_t value);
@@ -78,6 +80,26 @@ namespace ZX128 {
     void saveState(Ep128Emu::File&);
     void loadState(Ep128Emu::File::Buffer&);
     void registerChunkType(Ep128Emu::File&);
+    /*!
+     * Returns the 1K blocks of 'segment' written since the last call of
+     * clearDirtyBlocks(), bit N is set if block N has changed.
+     * NOTE: writes through getSegmentPtr() are not tracked.
+     */
+    inline uint16_t getDirtyBlocks(uint8_t segment) const;
+    /*!
+     * Use the current memory contents as the base of the next delta state.
+     */
+    void clearDirtyBlocks();
+    /*!
+     * Save the paging and the RAM blocks changed since the last call of
+     * clearDirtyBlocks() to 'buf'.
+     */
+    void saveDeltaState(Ep128Emu::File::Buffer&);
+    /*!
+     * Load a delta state saved by saveDeltaState(). The memory should
+     * already contain the base state the delta was saved relative to.
+     */
+    void loadDeltaState(Ep128Emu::File::Buffer&);
    protected:
     virtual void breakPointCallback(bool isWrite, uint16_t addr, uint8_t value);
   };
@@ -125,20 +147,25 @@ namespace ZX128 {
     if (haveBreakPoints)
       checkWriteBreakPoint(addr, page, value);
     pageAddressTableW[page][addr] = value;
+    dirtyMap.setDirty(pageTable[page], addr);
   }
 
   inline void Memory::writeRaw(uint32_t addr, uint8_t value)
   {
     uint8_t segment = uint8_t(addr >> 14);
-    if (!segmentROMTable[segment])
+    if (!segmentROMTable[segment]) {
       segmentTable[segment][addr & 0x3FFF] = value;
+      dirtyMap.setDirty(segment, uint16_t(addr));
+    }
   }
 
   inline void Memory::writeROM(uint32_t addr, uint8_t value)
   {
     uint8_t segment = uint8_t(addr >> 14);
-    if (segmentTable[segment])
+    if (segmentTable[segment]) {
       segmentTable[segment][addr & 0x3FFF] = value;
+      dirtyMap.setDirty(segment, uint16_t(addr));
+    }
   }
 
   inline uint8_t Memory::getPage(uint8_t page) const
@@ -169,6 +196,11 @@ namespace ZX128 {
     return (segmentTable[segment]);
   }
 
+  inline uint16_t Memory::getDirtyBlocks(uint8_t segment) const
+  {
+    return dirtyMap.getDirtyBlocks(segment);
+  }
+
 }       // namespace ZX128
 
 #endif  // EP128EMU_ZXMEMORY_HPP
@@ -190,47 +190,6 @@ namespace Ep128 {
     static Z80Tables  t;
     Z80_REGISTERS   R;
     int32_t newPCAddress;
-   private:
-    EP128EMU_INLINE void Index_CB_ExecuteInstruction();
-    EP128EMU_INLINE void FD_ExecuteInstruction();
-    EP128EMU_INLINE void DD_ExecuteInstruction();
-    EP128EMU_INLINE void ED_ExecuteInstruction();
-    EP128EMU_INLINE void CB_ExecuteInstruction();
-    EP128EMU_INLINE Z80_BYTE RD_BYTE_INDEX_(Z80_WORD Index);
-    EP128EMU_INLINE void WR_BYTE_INDEX_(Z80_WORD Index, Z80_BYTE Data);
-    EP128EMU_INLINE void LD_HL_n();
-    EP128EMU_INLINE Z80_WORD POP();
-    EP128EMU_INLINE void ADD_A_HL();
-    EP128EMU_INLINE void ADD_A_n();
-    EP128EMU_INLINE void ADC_A_HL();
-    EP128EMU_INLINE void ADC_A_n();
-    EP128EMU_INLINE void SUB_A_HL();
-    EP128EMU_INLINE void SUB_A_n();
-    EP128EMU_INLINE void SBC_A_HL();
-    EP128EMU_INLINE void SBC_A_n();
-    EP128EMU_INLINE void CP_A_HL();
-    EP128EMU_INLINE void CP_A_n();
-    EP128EMU_INLINE void AND_A_n();
-    EP128EMU_INLINE void AND_A_HL();
-    EP128EMU_INLINE void XOR_A_n();
-    EP128EMU_INLINE void XOR_A_HL();
-    EP128EMU_INLINE void OR_A_HL();
-    EP128EMU_INLINE void OR_A_n();
-    EP128EMU_INLINE void OUT_n_A();
-    EP128EMU_INLINE void IN_A_n();
-    EP128EMU_INLINE void RRA();
-    EP128EMU_INLINE void RRD();
-    EP128EMU_INLINE void RLD();
-    EP128EMU_INLINE void JP();
-    EP128EMU_INLINE void JR();
-    EP128EMU_INLINE void CALL();
-    EP128EMU_INLINE void DJNZ_dd();
-    EP128EMU_REGPARM1 void CPI();
-    EP128EMU_REGPARM1 void CPD();
-    EP128EMU_REGPARM1 void OUTI();
-    EP128EMU_REGPARM1 void OUTD();
-    EP128EMU_REGPARM1 void INI();
-    EP128EMU_REGPARM1 void IND();
     EP128EMU_REGPARM1 void DAA();
     // called after LD A,I and LD A,R to emulate the buggy behavior of P/V flag
     EP128EMU_REGPARM1 void checkNMOSBug();
@@ -265,7 +224,6 @@ namespace Ep128 {
     void triggerInterrupt();
     void clearInterrupt();
     void setVectorBase(int);
-    void executeInstruction();
     /*!
      * Save snapshot.
      */
@@ -335,7 +293,6 @@ namespace Ep128 {
     virtual EP128EMU_REGPARM1 void updateCycle();
     virtual EP128EMU_REGPARM2 void updateCycles(int cycles);
     virtual EP128EMU_REGPARM1 void tapePatch();
-   private:
     EP128EMU_INLINE void checkInterrupts()
     {
       if (EP128EMU_UNLIKELY(R.Flags & (Z80_EXECUTE_INTERRUPT_HANDLER_FLAG
@@ -356,6 +313,89 @@ namespace Ep128 {
     }
   };
 
+  /*!
+   * Z80 instruction decoder for a machine specific subclass 'T' of Z80.
+   * As this class is final, the memory, I/O and cycle counting functions
+   * implemented by 'T' are called directly instead of through the vtable,
+   * and can be inlined. The member functions are defined in z80core.hpp,
+   * which should be included by the source file that implements 'T'.
+   */
+  template <typename T>
+  class Z80Core final : public T {
+   private:
+    using T::t;
+    using T::R;
+    using T::newPCAddress;
+    using T::DAA;
+    using T::checkNMOSBug;
+    using T::checkInterrupts;
+    using T::checkNMI;
+    using T::readMemory;
+    using T::writeMemory;
+    using T::readMemoryWord;
+    using T::writeMemoryWord;
+    using T::pushWord;
+    using T::doOut;
+    using T::doIn;
+    using T::readOpcodeFirstByte;
+    using T::readOpcodeSecondByte;
+    using T::readOpcodeByte;
+    using T::readOpcodeWord;
+    using T::updateCycle;
+    using T::updateCycles;
+    using T::tapePatch;
+    EP128EMU_INLINE void Index_CB_ExecuteInstruction();
+    EP128EMU_INLINE void FD_ExecuteInstruction();
+    EP128EMU_INLINE void DD_ExecuteInstruction();
+    EP128EMU_INLINE void ED_ExecuteInstruction();
+    EP128EMU_INLINE void CB_ExecuteInstruction();
+    EP128EMU_INLINE Z80_BYTE RD_BYTE_INDEX_(Z80_WORD Index);
+    EP128EMU_INLINE void WR_BYTE_INDEX_(Z80_WORD Index, Z80_BYTE Data);
+    EP128EMU_INLINE void LD_HL_n();
+    EP128EMU_INLINE Z80_WORD POP();
+    EP128EMU_INLINE void ADD_A_HL();
+    EP128EMU_INLINE void ADD_A_n();
+    EP128EMU_INLINE void ADC_A_HL();
+    EP128EMU_INLINE void ADC_A_n();
+    EP128EMU_INLINE void SUB_A_HL();
+    EP128EMU_INLINE void SUB_A_n();
+    EP128EMU_INLINE void SBC_A_HL();
+    EP128EMU_INLINE void SBC_A_n();
+    EP128EMU_INLINE void CP_A_HL();
+    EP128EMU_INLINE void CP_A_n();
+    EP128EMU_INLINE void AND_A_n();
+    EP128EMU_INLINE void AND_A_HL();
+    EP128EMU_INLINE void XOR_A_n();
+    EP128EMU_INLINE void XOR_A_HL();
+    EP128EMU_INLINE void OR_A_HL();
+    EP128EMU_INLINE void OR_A_n();
+    EP128EMU_INLINE void OUT_n_A();
+    EP128EMU_INLINE void IN_A_n();
+    EP128EMU_INLINE void RRA();
+    EP128EMU_INLINE void RRD();
+    EP128EMU_INLINE void RLD();
+    EP128EMU_INLINE void JP();
+    EP128EMU_INLINE void JR();
+    EP128EMU_INLINE void CALL();
+    EP128EMU_INLINE void DJNZ_dd();
+    EP128EMU_REGPARM1 void CPI();
+    EP128EMU_REGPARM1 void CPD();
+    EP128EMU_REGPARM1 void OUTI();
+    EP128EMU_REGPARM1 void OUTD();
+    EP128EMU_REGPARM1 void INI();
+    EP128EMU_REGPARM1 void IND();
+   public:
+    template <typename U>
+    Z80Core(U& vm_)
+      : T(vm_)
+    {
+    }
+    virtual ~Z80Core()
+    {
+    }
+    void executeInstruction();
+  };
+
 }       // namespace Ep128
 
 #endif  // __Z80_HEADER_INCLUDED__
@@ -20,6 +20,9 @@
 
 /* Istvan Varga, 2004, 2007, 2009: fixed opcode cycle counts */
 
+#ifndef __Z80CORE_HEADER_INCLUDED__
+#define __Z80CORE_HEADER_INCLUDED__
+
 #include "z80.hpp"
 
 #include "z80macros.hpp"
@@ -58,7 +61,8 @@ static const bool invalidIndexOpcodeTable[256] = {
 
 namespace Ep128 {
 
-  EP128EMU_INLINE void Z80::Index_CB_ExecuteInstruction()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::Index_CB_ExecuteInstruction()
   {
     uint8_t Opcode = readOpcodeByte(3);
     updateCycles(2);
@@ -1359,7 +1363,8 @@ namespace Ep128 {
   }
 
   /***************************************************************************/
-  EP128EMU_INLINE void Z80::FD_ExecuteInstruction()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::FD_ExecuteInstruction()
   {
     uint8_t Opcode;
     Opcode = readOpcodeSecondByte(invalidIndexOpcodeTable);
@@ -2153,7 +2158,8 @@ namespace Ep128 {
   }
 
   /***************************************************************************/
-  EP128EMU_INLINE void Z80::DD_ExecuteInstruction()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::DD_ExecuteInstruction()
   {
     uint8_t Opcode;
     Opcode = readOpcodeSecondByte(invalidIndexOpcodeTable);
@@ -2947,7 +2953,8 @@ namespace Ep128 {
   }
 
   /***************************************************************************/
-  EP128EMU_INLINE void Z80::ED_ExecuteInstruction()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::ED_ExecuteInstruction()
   {
     INC_REFRESH(2);
     uint8_t Opcode;
@@ -3697,7 +3704,8 @@ namespace Ep128 {
   }
 
   /***************************************************************************/
-  EP128EMU_INLINE void Z80::CB_ExecuteInstruction()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::CB_ExecuteInstruction()
   {
     uint8_t Opcode;
     Opcode = readOpcodeSecondByte();
@@ -4998,7 +5006,103 @@ namespace Ep128 {
   }
 
   /***************************************************************************/
-  void Z80::executeInstruction()
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::CPI()
+  {
+    Z80_FLAGS_REG = Z80_FLAGS_REG | Z80_SUBTRACT_FLAG;
+    Z80_BYTE  tmp = readMemory(R.HL.W);
+    R.HL.W++;
+    R.BC.W--;
+    Z80_BYTE  tmp2 = R.AF.B.h - tmp;
+    Z80_FLAGS_REG = (Z80_FLAGS_REG & (Z80_SUBTRACT_FLAG | Z80_CARRY_FLAG))
+                    | (R.BC.W == 0 ? 0x00 : Z80_PARITY_FLAG)
+                    | t.zeroSignTable[tmp2];
+    SET_HALFCARRY(tmp, tmp2);
+    tmp = tmp2 - ((Z80_FLAGS_REG & Z80_HALFCARRY_FLAG)
+                  >> Z80_HALFCARRY_FLAG_BIT);
+    Z80_FLAGS_REG =
+        Z80_FLAGS_REG | (tmp & Z80_UNUSED_FLAG2) | ((tmp & 0x02) << 4);
+  }
+
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::CPD()
+  {
+    Z80_FLAGS_REG = Z80_FLAGS_REG | Z80_SUBTRACT_FLAG;
+    Z80_BYTE  tmp = readMemory(R.HL.W);
+    R.HL.W--;
+    R.BC.W--;
+    Z80_BYTE  tmp2 = R.AF.B.h - tmp;
+    Z80_FLAGS_REG = (Z80_FLAGS_REG & (Z80_SUBTRACT_FLAG | Z80_CARRY_FLAG))
+                    | (R.BC.W == 0 ? 0x00 : Z80_PARITY_FLAG)
+                    | t.zeroSignTable[tmp2];
+    SET_HALFCARRY(tmp, tmp2);
+    tmp = tmp2 - ((Z80_FLAGS_REG & Z80_HALFCARRY_FLAG)
+                  >> Z80_HALFCARRY_FLAG_BIT);
+    Z80_FLAGS_REG =
+        Z80_FLAGS_REG | (tmp & Z80_UNUSED_FLAG2) | ((tmp & 0x02) << 4);
+  }
+
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::OUTI()
+  {
+    updateCycle();
+    Z80_BYTE  tmp = readMemory(R.HL.W);
+    R.HL.W++;
+    R.BC.B.h--;
+    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
+                    | ((Z80_WORD(tmp) + Z80_WORD(R.HL.B.l)) < 0x0100 ?
+                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
+                    | t.parityTable[((tmp + R.HL.B.l) & 0x07) ^ R.BC.B.h];
+    doOut(R.BC.W, tmp);
+  }
+
+  /* B is pre-decremented before execution */
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::OUTD()
+  {
+    updateCycle();
+    Z80_BYTE  tmp = readMemory(R.HL.W);
+    R.HL.W--;
+    R.BC.B.h--;
+    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
+                    | ((Z80_WORD(tmp) + Z80_WORD(R.HL.B.l)) < 0x0100 ?
+                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
+                    | t.parityTable[((tmp + R.HL.B.l) & 0x07) ^ R.BC.B.h];
+    doOut(R.BC.W, tmp);
+  }
+
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::INI()
+  {
+    updateCycle();
+    Z80_BYTE  tmp = doIn(R.BC.W);
+    writeMemory(R.HL.W, tmp);
+    R.HL.W++;
+    R.BC.B.h--;
+    Z80_WORD  tmp2 = Z80_WORD(tmp) + Z80_WORD((R.BC.B.l + 1) & 0xFF);
+    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
+                    | (tmp2 < 0x0100 ?
+                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
+                    | t.parityTable[(tmp2 & 0x07) ^ R.BC.B.h];
+  }
+
+  template <typename T>
+  EP128EMU_REGPARM1 void Z80Core<T>::IND()
+  {
+    updateCycle();
+    Z80_BYTE  tmp = doIn(R.BC.W);
+    writeMemory(R.HL.W, tmp);
+    R.HL.W--;
+    R.BC.B.h--;
+    Z80_WORD  tmp2 = Z80_WORD(tmp) + Z80_WORD((R.BC.B.l - 1) & 0xFF);
+    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
+                    | (tmp2 < 0x0100 ?
+                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
+                    | t.parityTable[(tmp2 & 0x07) ^ R.BC.B.h];
+  }
+
+  template <typename T>
+  void Z80Core<T>::executeInstruction()
   {
     uint8_t Opcode;
     Opcode = readOpcodeFirstByte();
@@ -6944,3 +7048,4 @@ namespace Ep128 {
 
 }       // namespace Ep128
 
+#endif  // __Z80CORE_HEADER_INCLUDED__
@@ -21,7 +21,8 @@
 
 namespace Ep128 {
 
-  EP128EMU_INLINE Z80_BYTE Z80::RD_BYTE_INDEX_(Z80_WORD Index)
+  template <typename T>
+  EP128EMU_INLINE Z80_BYTE Z80Core<T>::RD_BYTE_INDEX_(Z80_WORD Index)
   {
     SETUP_INDEXED_ADDRESS(Index);
     updateCycles(5);
@@ -31,14 +32,16 @@ namespace Ep128 {
   /*----------------------------------*/
   /* write a byte of data using index */
 
-  EP128EMU_INLINE void Z80::WR_BYTE_INDEX_(Z80_WORD Index, Z80_BYTE Data)
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::WR_BYTE_INDEX_(Z80_WORD Index, Z80_BYTE Data)
   {
     SETUP_INDEXED_ADDRESS(Index);
     updateCycles(5);
     writeMemory(R.IndexPlusOffset, Data);
   }
 
-  EP128EMU_INLINE void Z80::LD_HL_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::LD_HL_n()
   {
     writeMemory(R.HL.W, readOpcodeByte(1));
   }
@@ -46,7 +49,8 @@ namespace Ep128 {
   /*---------------------------*/
   /* pop a word from the stack */
 
-  EP128EMU_INLINE Z80_WORD Z80::POP()
+  template <typename T>
+  EP128EMU_INLINE Z80_WORD Z80Core<T>::POP()
   {
     Z80_WORD Data;
 
@@ -55,101 +59,120 @@ namespace Ep128 {
     return Data;
   }
 
-  EP128EMU_INLINE void Z80::ADD_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::ADD_A_HL()
   {
     ADD_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::ADD_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::ADD_A_n()
   {
     ADD_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::ADC_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::ADC_A_HL()
   {
     ADC_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::ADC_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::ADC_A_n()
   {
     ADC_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::SUB_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::SUB_A_HL()
   {
     SUB_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::SUB_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::SUB_A_n()
   {
     SUB_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::SBC_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::SBC_A_HL()
   {
     SBC_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::SBC_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::SBC_A_n()
   {
     SBC_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::CP_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::CP_A_HL()
   {
     CP_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::CP_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::CP_A_n()
   {
     CP_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::AND_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::AND_A_n()
   {
     AND_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::AND_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::AND_A_HL()
   {
     AND_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::XOR_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::XOR_A_n()
   {
     XOR_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::XOR_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::XOR_A_HL()
   {
     XOR_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::OR_A_HL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::OR_A_HL()
   {
     OR_A_X(readMemory(R.HL.W));
   }
 
-  EP128EMU_INLINE void Z80::OR_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::OR_A_n()
   {
     OR_A_X(readOpcodeByte(1));
   }
 
-  EP128EMU_INLINE void Z80::OUT_n_A()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::OUT_n_A()
   {
     /* A in upper byte of port, Data in lower byte of port */
     doOut((Z80_WORD) readOpcodeByte(1) | ((Z80_WORD) (R.AF.B.h) << 8),
           R.AF.B.h);
   }
 
-  EP128EMU_INLINE void Z80::IN_A_n()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::IN_A_n()
   {
     /* A in upper byte of port, data in lower byte of port */
     R.AF.B.h =
         doIn((Z80_WORD) readOpcodeByte(1) | ((Z80_WORD) (R.AF.B.h) << 8));
   }
 
-  EP128EMU_INLINE void Z80::RRA()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::RRA()
   {
     RR(R.AF.B.h);
     R.AF.B.l = (R.AF.B.l & (Z80_SIGN_FLAG | Z80_ZERO_FLAG | Z80_PARITY_FLAG
@@ -157,7 +180,8 @@ namespace Ep128 {
                | (R.AF.B.h & (Z80_UNUSED_FLAG1 | Z80_UNUSED_FLAG2));
   }
 
-  EP128EMU_INLINE void Z80::RRD()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::RRD()
   {
     Z80_BYTE  tempByte = readMemory(R.HL.W);
     updateCycles(4);
@@ -168,7 +192,8 @@ namespace Ep128 {
                     | t.zeroSignParityTable[R.AF.B.h];
   }
 
-  EP128EMU_INLINE void Z80::RLD()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::RLD()
   {
     Z80_BYTE  tempByte = readMemory(R.HL.W);
     updateCycles(4);
@@ -182,7 +207,8 @@ namespace Ep128 {
   /*---------------------------*/
   /* jump to a memory location */
 
-  EP128EMU_INLINE void Z80::JP()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::JP()
   {
     /* set program counter to sub-routine address */
     R.PC.W.l = readOpcodeWord(1);
@@ -191,7 +217,8 @@ namespace Ep128 {
   /*------------------------------------*/
   /* jump relative to a memory location */
 
-  EP128EMU_INLINE void Z80::JR()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::JR()
   {
     R.PC.W.l =
         Z80_WORD((R.PC.W.l + 2 + int(Z80_BYTE_OFFSET(readOpcodeByte(1))))
@@ -202,7 +229,8 @@ namespace Ep128 {
   /*--------------------*/
   /* call a sub-routine */
 
-  EP128EMU_INLINE void Z80::CALL()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::CALL()
   {
     Z80_WORD  tempWord = readOpcodeWord(1);
     /* store return address on stack */
@@ -211,7 +239,8 @@ namespace Ep128 {
     R.PC.W.l = tempWord;
   }
 
-  EP128EMU_INLINE void Z80::DJNZ_dd()
+  template <typename T>
+  EP128EMU_INLINE void Z80Core<T>::DJNZ_dd()
   {
     /* decrement B */
     updateCycle();
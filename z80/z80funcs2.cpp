@@ -250,95 +250,6 @@ namespace Ep128 {
     R.Flags &= ~Z80_EXECUTE_INTERRUPT_HANDLER_FLAG;
   }
 
-  EP128EMU_REGPARM1 void Z80::CPI()
-  {
-    Z80_FLAGS_REG = Z80_FLAGS_REG | Z80_SUBTRACT_FLAG;
-    Z80_BYTE  tmp = readMemory(R.HL.W);
-    R.HL.W++;
-    R.BC.W--;
-    Z80_BYTE  tmp2 = R.AF.B.h - tmp;
-    Z80_FLAGS_REG = (Z80_FLAGS_REG & (Z80_SUBTRACT_FLAG | Z80_CARRY_FLAG))
-                    | (R.BC.W == 0 ? 0x00 : Z80_PARITY_FLAG)
-                    | t.zeroSignTable[tmp2];
-    SET_HALFCARRY(tmp, tmp2);
-    tmp = tmp2 - ((Z80_FLAGS_REG & Z80_HALFCARRY_FLAG)
-                  >> Z80_HALFCARRY_FLAG_BIT);
-    Z80_FLAGS_REG =
-        Z80_FLAGS_REG | (tmp & Z80_UNUSED_FLAG2) | ((tmp & 0x02) << 4);
-  }
-
-  EP128EMU_REGPARM1 void Z80::CPD()
-  {
-    Z80_FLAGS_REG = Z80_FLAGS_REG | Z80_SUBTRACT_FLAG;
-    Z80_BYTE  tmp = readMemory(R.HL.W);
-    R.HL.W--;
-    R.BC.W--;
-    Z80_BYTE  tmp2 = R.AF.B.h - tmp;
-    Z80_FLAGS_REG = (Z80_FLAGS_REG & (Z80_SUBTRACT_FLAG | Z80_CARRY_FLAG))
-                    | (R.BC.W == 0 ? 0x00 : Z80_PARITY_FLAG)
-                    | t.zeroSignTable[tmp2];
-    SET_HALFCARRY(tmp, tmp2);
-    tmp = tmp2 - ((Z80_FLAGS_REG & Z80_HALFCARRY_FLAG)
-                  >> Z80_HALFCARRY_FLAG_BIT);
-    Z80_FLAGS_REG =
-        Z80_FLAGS_REG | (tmp & Z80_UNUSED_FLAG2) | ((tmp & 0x02) << 4);
-  }
-
-  EP128EMU_REGPARM1 void Z80::OUTI()
-  {
-    updateCycle();
-    Z80_BYTE  tmp = readMemory(R.HL.W);
-    R.HL.W++;
-    R.BC.B.h--;
-    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
-                    | ((Z80_WORD(tmp) + Z80_WORD(R.HL.B.l)) < 0x0100 ?
-                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
-                    | t.parityTable[((tmp + R.HL.B.l) & 0x07) ^ R.BC.B.h];
-    doOut(R.BC.W, tmp);
-  }
-
-  /* B is pre-decremented before execution */
-  EP128EMU_REGPARM1 void Z80::OUTD()
-  {
-    updateCycle();
-    Z80_BYTE  tmp = readMemory(R.HL.W);
-    R.HL.W--;
-    R.BC.B.h--;
-    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
-                    | ((Z80_WORD(tmp) + Z80_WORD(R.HL.B.l)) < 0x0100 ?
-                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
-                    | t.parityTable[((tmp + R.HL.B.l) & 0x07) ^ R.BC.B.h];
-    doOut(R.BC.W, tmp);
-  }
-
-  EP128EMU_REGPARM1 void Z80::INI()
-  {
-    updateCycle();
-    Z80_BYTE  tmp = doIn(R.BC.W);
-    writeMemory(R.HL.W, tmp);
-    R.HL.W++;
-    R.BC.B.h--;
-    Z80_WORD  tmp2 = Z80_WORD(tmp) + Z80_WORD((R.BC.B.l + 1) & 0xFF);
-    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
-                    | (tmp2 < 0x0100 ?
-                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
-                    | t.parityTable[(tmp2 & 0x07) ^ R.BC.B.h];
-  }
-
-  EP128EMU_REGPARM1 void Z80::IND()
-  {
-    updateCycle();
-    Z80_BYTE  tmp = doIn(R.BC.W);
-    writeMemory(R.HL.W, tmp);
-    R.HL.W--;
-    R.BC.B.h--;
-    Z80_WORD  tmp2 = Z80_WORD(tmp) + Z80_WORD((R.BC.B.l - 1) & 0xFF);
-    Z80_FLAGS_REG = t.zeroSignTable2[R.BC.B.h] | ((tmp & 0x80) >> 6)
-                    | (tmp2 < 0x0100 ?
-                       0x00 : (Z80_HALFCARRY_FLAG | Z80_CARRY_FLAG))
-                    | t.parityTable[(tmp2 & 0x07) ^ R.BC.B.h];
-  }
-
   /* half carry not set */
   EP128EMU_REGPARM1 void Z80::DAA()
   {